@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""
+End-to-end benchmark of atomizer on synthetic input of a fixed set of sizes.
+
+For every size, src/genPsl generates the psl input with a fixed seed and atomizer runs on it with
+--metrics. Wall time, CPU time and the peak RSS reached by the end of each phase are appended as
+tab separated rows to the results file, labelled with the given release name, so the scaling
+curves of releases can be compared:
+
+    label  size  genomes  genome_length  blocks  phase  wall_ms  cpu_ms  peak_rss_kb
+
+Usage: benchmark.py [--label <name>] [--sizes small,medium,...] [--numThreads <n>]
+                    [--workdir <dir>] [--results <file>] [--keep]
+Build src first (make in src), the binaries are taken from there.
+"""
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+SRC = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+
+## name: (genomes, genome length, chromosomes per genome)
+SIZES = [
+	("tiny", (3, 1000000, 1)),
+	("small", (4, 10000000, 2)),
+	("medium", (6, 50000000, 4)),
+	("large", (8, 200000000, 8)),
+	("huge", (10, 1000000000, 10)),
+]
+SEED = 1
+
+def git_label():
+	try:
+		return subprocess.check_output(["git", "describe", "--always", "--dirty"], cwd=SRC,
+			stderr=subprocess.DEVNULL).decode().strip()
+	except (OSError, subprocess.CalledProcessError):
+		return "unknown"
+
+def run_size(name, genomes, length, chromosomes, args, results):
+	psl = os.path.join(args.workdir, "bench.%s.psl" % name)
+	metrics = os.path.join(args.workdir, "bench.%s.json" % name)
+	start = time.time()
+	gen = subprocess.run([os.path.join(SRC, "genPsl"), "-o", psl, "--genomes", str(genomes),
+		"--genomeLength", str(length), "--chromosomes", str(chromosomes), "--seed", str(SEED),
+		"--numThreads", str(args.numThreads)], stderr=subprocess.PIPE, check=True)
+	gen_ms = (time.time() - start) * 1000
+	match = re.search(r"with (\d+) blocks", gen.stderr.decode())
+	blocks = int(match.group(1)) if match else -1
+	print("%s: generated %d blocks in %.0f ms" % (name, blocks, gen_ms), file=sys.stderr)
+	try:
+		subprocess.run([os.path.join(SRC, "atomizer"), psl, "--numThreads", str(args.numThreads),
+			"--metrics", metrics, "-o", os.devnull], stderr=subprocess.DEVNULL, check=True)
+		with open(metrics) as f:
+			report = json.load(f)
+	finally:
+		if not args.keep:
+			for path in (psl, metrics):
+				if os.path.exists(path):
+					os.remove(path)
+	prefix = [args.label, name, genomes, length, blocks]
+	results.write("\t".join(map(str, prefix + ["generate", "%.1f" % gen_ms, "", ""])) + "\n")
+	total_wall = total_cpu = 0.0
+	for phase in report["phases"]:
+		total_wall += phase["wall_ms"]
+		total_cpu += phase["cpu_ms"]
+		results.write("\t".join(map(str, prefix + [phase["name"], "%.1f" % phase["wall_ms"],
+			"%.1f" % phase["cpu_ms"], phase["peak_rss_kb"]])) + "\n")
+	results.write("\t".join(map(str, prefix + ["total", "%.1f" % total_wall, "%.1f" % total_cpu,
+		report["peak_rss_kb"]])) + "\n")
+	results.flush()
+	print("%s: atomizer took %.0f ms, peak RSS %d KB" % (name, total_wall, report["peak_rss_kb"]), file=sys.stderr)
+
+def main():
+	parser = argparse.ArgumentParser(description="End-to-end benchmark of atomizer on synthetic input.")
+	parser.add_argument("--label", default=git_label(), help="release name of the rows (default: git describe)")
+	parser.add_argument("--sizes", default="tiny,small,medium",
+		help="comma separated sizes out of " + ",".join(n for n, _ in SIZES) + " (default: tiny,small,medium)")
+	parser.add_argument("--numThreads", type=int, default=1)
+	parser.add_argument("--workdir", default=".", help="directory for the generated input (default: .)")
+	parser.add_argument("--results", default="benchmark.tsv", help="file the rows are appended to")
+	parser.add_argument("--keep", action="store_true", help="keep the generated psl and metrics files")
+	args = parser.parse_args()
+	sizes = dict(SIZES)
+	chosen = args.sizes.split(",")
+	for name in chosen:
+		if name not in sizes:
+			parser.error("unknown size " + name)
+	new_file = not os.path.exists(args.results)
+	with open(args.results, "a") as results:
+		if new_file:
+			results.write("label\tsize\tgenomes\tgenome_length\tblocks\tphase\twall_ms\tcpu_ms\tpeak_rss_kb\n")
+		for name in chosen:
+			run_size(name, *sizes[name], args=args, results=results)
+
+if __name__ == "__main__":
+	main()
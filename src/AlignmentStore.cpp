@@ -0,0 +1,364 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <queue>
+#include <limits>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "AlignmentStore.h"
+#include "Breakpoints.h"
+#include "IMP.h"
+#include "Classify.h"
+#include "Util.h"
+
+/* An entry of a run or the store file: the records of one pair serialized for one window. prevWindow is
+the previous window (plus one, 0 for none) the pair is stored in, so a batch of windows loads it only once. */
+struct StoreEntry {
+	unsigned long window;
+	unsigned long prevWindow;
+	unsigned long cost;
+	std::string payload;
+};
+
+static const size_t ENTRY_HEADER = 3 * sizeof(unsigned long) + sizeof(unsigned int);
+
+template <typename T>
+static inline void put(std::string &out, const T &value) {
+	out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static inline T get(const char *&p) {
+	T value;
+	std::memcpy(&value, p, sizeof(T));
+	p += sizeof(T);
+	return value;
+}
+
+/* Reads the next entry of in into entry, returns false at the end */
+static bool readEntry(std::istream &in, StoreEntry &entry) {
+	char header[ENTRY_HEADER];
+	if (!in.read(header, ENTRY_HEADER)) return false;
+	const char *p = header;
+	entry.window = get<unsigned long>(p);
+	entry.prevWindow = get<unsigned long>(p);
+	entry.cost = get<unsigned long>(p);
+	entry.payload.resize(get<unsigned int>(p));
+	if (!in.read(&entry.payload[0], entry.payload.size()))
+		throw std::runtime_error("Alignment store is truncated.");
+	return true;
+}
+
+/* Serializes rec (not its reverse, which is recomputed on load) */
+static void serializeRecord(const AlignmentRecord &rec, std::string &out) {
+	put(out, rec.strand);
+	put(out, rec.identity);
+	put(out, rec.qStart);
+	put(out, rec.qEnd);
+	put(out, rec.tStart);
+	put(out, rec.tEnd);
+	put(out, static_cast<unsigned int>(rec.blockCount));
+	for (unsigned int i = 0; i < rec.blockCount; i++) put(out, rec.blockSizes[i]);
+	for (unsigned int i = 0; i < rec.blockCount; i++) put(out, static_cast<block_local_t>(rec.get_qStarts(i) - rec.qStart));
+	for (unsigned int i = 0; i < rec.blockCount; i++) put(out, rec.local_tStarts()[i]);
+}
+
+/* Recreates a record serialized by serializeRecord and its reverse, and appends both to records */
+static void deserializeRecord(const std::string &payload, std::deque<AlignmentRecord *> &records) {
+	const char *p = payload.data();
+	char strand = get<char>(p);
+	float identity = get<float>(p);
+	unsigned long qStart = get<unsigned long>(p), qEnd = get<unsigned long>(p);
+	unsigned long tStart = get<unsigned long>(p), tEnd = get<unsigned long>(p);
+	unsigned int blockCount = get<unsigned int>(p);
+	std::vector<unsigned int> blockSizes(blockCount);
+	std::vector<unsigned long> qStarts(blockCount), tStarts(blockCount);
+	for (auto &x : blockSizes) x = get<block_local_t>(p);
+	for (auto &x : qStarts) x = qStart + get<block_local_t>(p);
+	for (auto &x : tStarts) x = tStart + get<block_local_t>(p);
+	AlignmentRecord *rec = new AlignmentRecord(strand, qStart, qEnd, tStart, tEnd, blockCount, blockSizes, qStarts, tStarts);
+	rec->identity = identity;
+	AlignmentRecord *rev = rec->revert();
+	rec->sym = rev;
+	rev->sym = rec;
+	records.push_back(rec);
+	records.push_back(rev);
+}
+
+AlignmentStore::AlignmentStore(const std::string &dir, unsigned long maxMemory, unsigned int bucketSize)
+	: maxMemory(maxMemory), bucketSize(bucketSize), windowLength(static_cast<unsigned long>(bucketSize) * BUCKETS_PER_WINDOW),
+	  totalLength(0), recordCount(0), runs(0), warnedLargeWindow(false) {
+	if (!isEnabled()) return;
+	this->dir = dir + "/atomizer-store." + std::to_string(getpid());
+	if (mkdir(this->dir.c_str(), 0755) != 0 && errno != EEXIST)
+		throw std::runtime_error("Alignment store directory could not be created: " + this->dir);
+}
+
+AlignmentStore::~AlignmentStore() {
+	if (!isEnabled()) return;
+	for (unsigned int run = 0; run < runs; run++)
+		std::remove(runPath(run).c_str());
+	std::remove(storePath().c_str());
+	rmdir(dir.c_str());
+}
+
+void AlignmentStore::add(std::deque<AlignmentRecord *> &records) {
+	const unsigned long runBytes = std::max(maxMemory / 4, 1UL << 20); // the rest is left to the parser and the runs
+	std::string payload;
+	std::vector<unsigned long> covered;
+	for (size_t i = 0; i < records.size(); i += 2) {
+		AlignmentRecord *rec = records[i];
+		AlignmentRecord *rev = (i + 1 < records.size()) ? records[i + 1] : nullptr;
+		if (rev == nullptr || rec->sym != rev || rev->sym != rec)
+			throw std::runtime_error("AlignmentStore::add expects each record to be followed by its reverse");
+		payload.clear();
+		serializeRecord(*rec, payload);
+		const unsigned long recordBytes = 2 * (mallocBytes(sizeof(AlignmentRecord))
+			+ 3 * mallocBytes(rec->blockCount * sizeof(block_local_t)) + sizeof(AlignmentRecord *));
+		covered.clear(); // windows covered by either record as target
+		for (auto r : {rec, rev})
+			for (unsigned long w = r->tStart / windowLength; w <= r->tEnd / windowLength; w++)
+				covered.push_back(w);
+		std::sort(covered.begin(), covered.end());
+		covered.erase(std::unique(covered.begin(), covered.end()), covered.end());
+		unsigned long prevWindow = 0;
+		for (auto w : covered) {
+			unsigned long bucketEntries = 0;
+			for (auto r : {rec, rev}) {
+				unsigned long first = std::max(r->tStart / bucketSize, w * BUCKETS_PER_WINDOW);
+				unsigned long last = std::min(r->tEnd / bucketSize, (w + 1) * BUCKETS_PER_WINDOW - 1);
+				if (first <= last) bucketEntries += last - first + 1;
+			}
+			entries.push_back(std::make_pair(w, buffer.size()));
+			put(buffer, w);
+			put(buffer, prevWindow);
+			put(buffer, recordBytes + 2 * bucketEntries * sizeof(AlignmentRecord *)); // vectors grow by doubling
+			put(buffer, static_cast<unsigned int>(payload.size()));
+			buffer += payload;
+			prevWindow = w + 1;
+		}
+		recordCount += 2;
+		delete rec;
+		delete rev;
+		if (buffer.size() >= runBytes) spill();
+	}
+	records.clear();
+}
+
+void AlignmentStore::spill() {
+	std::stable_sort(entries.begin(), entries.end(),
+		[](const std::pair<unsigned long, size_t> &a, const std::pair<unsigned long, size_t> &b) { return a.first < b.first; });
+	std::ofstream out(runPath(runs), std::ios::binary);
+	for (auto &entry : entries) {
+		const char *p = buffer.data() + entry.second + 3 * sizeof(unsigned long);
+		out.write(buffer.data() + entry.second, ENTRY_HEADER + get<unsigned int>(p));
+	}
+	if (!out)
+		throw std::runtime_error("Alignment store run could not be written to " + runPath(runs));
+	runs++;
+	buffer.clear();
+	buffer.shrink_to_fit();
+	entries.clear();
+	entries.shrink_to_fit();
+}
+
+void AlignmentStore::finish(unsigned long totalLength) {
+	this->totalLength = totalLength;
+	if (!entries.empty() || runs == 0) spill();
+	windows.assign(totalLength / windowLength + 1, Window());
+
+	// k-way merge of the runs by window
+	std::vector<std::ifstream> in(runs);
+	std::vector<StoreEntry> heads(runs);
+	auto later = [&](unsigned int a, unsigned int b) { return heads[a].window > heads[b].window
+		|| (heads[a].window == heads[b].window && a > b); };
+	std::priority_queue<unsigned int, std::vector<unsigned int>, decltype(later)> queue(later);
+	for (unsigned int run = 0; run < runs; run++) {
+		in[run].open(runPath(run), std::ios::binary);
+		if (readEntry(in[run], heads[run])) queue.push(run);
+	}
+	std::ofstream out(storePath(), std::ios::binary);
+	unsigned long offset = 0;
+	std::string header;
+	while (!queue.empty()) {
+		unsigned int run = queue.top();
+		queue.pop();
+		StoreEntry &entry = heads[run];
+		if (entry.window >= windows.size())
+			throw std::runtime_error("AlignmentStore: record beyond the end of the concatenated sequence");
+		Window &window = windows[entry.window];
+		if (window.bytes == 0) window.offset = offset;
+		header.clear();
+		put(header, entry.window);
+		put(header, entry.prevWindow);
+		put(header, entry.cost);
+		put(header, static_cast<unsigned int>(entry.payload.size()));
+		out.write(header.data(), header.size());
+		out.write(entry.payload.data(), entry.payload.size());
+		window.bytes += header.size() + entry.payload.size();
+		window.cost += entry.cost;
+		offset += header.size() + entry.payload.size();
+		if (readEntry(in[run], heads[run])) queue.push(run);
+	}
+	if (!out)
+		throw std::runtime_error("Alignment store could not be written to " + storePath());
+	for (unsigned int run = 0; run < runs; run++) {
+		in[run].close();
+		std::remove(runPath(run).c_str());
+	}
+	std::cerr << "INFO: Stored " << recordCount << " alignments in " << windows.size() << " windows of "
+		<< windowLength << " bases (" << offset / (1 << 20) << " MB on disk, " << runs << " runs)." << std::endl;
+	runs = 0;
+}
+
+void AlignmentStore::planBatches(unsigned long residentBytes, std::vector<std::pair<size_t, size_t>> &batches) const {
+	const unsigned long budget = (maxMemory > residentBytes) ? maxMemory - residentBytes : 0;
+	const unsigned long bucketBytes = BUCKETS_PER_WINDOW * sizeof(std::vector<AlignmentRecord *>);
+	size_t first = 0;
+	unsigned long batchCost = 0;
+	for (size_t w = 0; w < windows.size(); w++) {
+		unsigned long cost = windows[w].cost + bucketBytes;
+		if (cost > budget && !warnedLargeWindow) {
+			std::cerr << "WARNING: The alignments of a window of " << windowLength << " bases need about "
+				<< cost / (1 << 20) << " MB, more than --maxMemory leaves for them." << std::endl;
+			warnedLargeWindow = true;
+		}
+		if (w > first && batchCost + cost > budget) {
+			batches.push_back(std::make_pair(first, w));
+			first = w;
+			batchCost = 0;
+		}
+		batchCost += cost;
+	}
+	batches.push_back(std::make_pair(first, windows.size()));
+}
+
+void AlignmentStore::load(size_t first, size_t last, std::deque<AlignmentRecord *> &records) const {
+	unsigned long bytes = 0, offset = 0;
+	bool found = false;
+	for (size_t w = first; w < last; w++) {
+		if (windows[w].bytes && !found) {
+			offset = windows[w].offset;
+			found = true;
+		}
+		bytes += windows[w].bytes;
+	}
+	if (!bytes) return;
+	std::ifstream in(storePath(), std::ios::binary);
+	in.seekg(offset);
+	StoreEntry entry;
+	try {
+		for (unsigned long read = 0; read < bytes; read += ENTRY_HEADER + entry.payload.size()) {
+			if (!readEntry(in, entry))
+				throw std::runtime_error("Alignment store is truncated.");
+			if (entry.prevWindow == 0 || entry.prevWindow - 1 < first) // not loaded from an earlier window of the batch
+				deserializeRecord(entry.payload, records);
+		}
+	} catch (...) { // the records of the batch are incomplete
+		for (auto rec : records)
+			delete rec;
+		records.clear();
+		throw;
+	}
+}
+
+void AlignmentStore::fillWindowBuckets(const std::deque<AlignmentRecord *> &records, size_t first, size_t last,
+	std::vector<std::vector<AlignmentRecord *>> &buckets) const {
+	const unsigned long firstBucket = first * BUCKETS_PER_WINDOW;
+	const unsigned long lastBucket = last * BUCKETS_PER_WINDOW - 1;
+	buckets.assign(lastBucket - firstBucket + 1, std::vector<AlignmentRecord *>());
+	for (auto rec : records) {
+		unsigned long begin = std::max(rec->tStart / bucketSize, firstBucket);
+		unsigned long end = std::min(rec->tEnd / bucketSize, lastBucket);
+		for (unsigned long b = begin; b <= end; b++)
+			buckets[b - firstBucket].push_back(rec);
+	}
+}
+
+void AlignmentStore::createWaste(const std::vector<unsigned long> &speciesBoundaries, unsigned int minLength,
+	std::vector<WasteRegion> &wasteRegions) const {
+	std::vector<std::pair<size_t, size_t>> batches;
+	planBatches(0, batches);
+	std::deque<AlignmentRecord *> records;
+	for (auto &batch : batches) { // the breakpoints of each batch are sorted, the batches follow each other
+		const unsigned long start = batch.first * windowLength;
+		const unsigned long end = (batch.second == windows.size()) ? std::numeric_limits<unsigned long>::max()
+			: batch.second * windowLength;
+		load(batch.first, batch.second, records);
+		std::vector<Breakpoint> breakpoints;
+		for (auto bp : speciesBoundaries)
+			if (bp >= start && bp < end) breakpoints.push_back(Breakpoint(bp));
+		for (auto rec : records) {
+			if (rec->tStart >= start && rec->tStart < end) breakpoints.push_back(Breakpoint(rec->tStart));
+			if (rec->tEnd >= start && rec->tEnd < end) breakpoints.push_back(Breakpoint(rec->tEnd));
+		}
+		for (auto rec : records)
+			delete rec;
+		records.clear();
+		std::sort(breakpoints.begin(), breakpoints.end());
+		breakpoints.erase(std::unique(breakpoints.begin(), breakpoints.end()), breakpoints.end());
+		appendWaste(breakpoints, minLength, wasteRegions);
+	}
+	if (wasteRegions.empty())
+		throw std::runtime_error("Got empty breakpoint list when trying to create regions.");
+}
+
+void AlignmentStore::newWasteRegions(const std::vector<Region> &protoAtoms, const std::vector<WasteRegion> &wasteRegions,
+	unsigned int minLength, double epsilon, unsigned int numThreads,
+	std::vector<Region> &newRegions, IMPCounters &counters) const {
+	// the atoms and waste regions stay resident, the new ones of this iteration and of the next atoms about as much
+	std::vector<std::pair<size_t, size_t>> batches;
+	planBatches(2 * (protoAtoms.capacity() * sizeof(Region) + wasteRegions.capacity() * sizeof(WasteRegion)), batches);
+	std::deque<AlignmentRecord *> records;
+	std::vector<std::vector<AlignmentRecord *>> buckets;
+	auto middleBefore = [](unsigned long pos) { return [pos](const Region &atom) { return atom.getMiddlePos() < pos; }; };
+	for (auto &batch : batches) { // atoms with their middle in the batch, their buckets are all in it
+		auto begin = std::partition_point(protoAtoms.begin(), protoAtoms.end(), middleBefore(batch.first * windowLength));
+		auto end = (batch.second == windows.size()) ? protoAtoms.end()
+			: std::partition_point(begin, protoAtoms.end(), middleBefore(batch.second * windowLength));
+		if (begin == end) continue;
+		load(batch.first, batch.second, records);
+		fillWindowBuckets(records, batch.first, batch.second, buckets);
+		newWasteRegionsForAtoms(protoAtoms, begin - protoAtoms.begin(), end - protoAtoms.begin(), wasteRegions,
+			buckets, bucketSize, minLength, epsilon, numThreads, newRegions, counters, nullptr,
+			batch.first * BUCKETS_PER_WINDOW);
+		for (auto rec : records)
+			delete rec;
+		records.clear();
+	}
+}
+
+size_t AlignmentStore::connectAtoms(const std::vector<WasteRegion> &wasteRegions, float minAlnCoverage,
+	unsigned int numThreads, ParityUnionFind &components) const {
+	const size_t nrAtoms = wasteRegions.size() - 1;
+	std::vector<std::pair<size_t, size_t>> batches;
+	planBatches(wasteRegions.capacity() * sizeof(WasteRegion) + nrAtoms * (sizeof(unsigned int) + 2), batches);
+	std::deque<AlignmentRecord *> records;
+	std::vector<std::vector<AlignmentRecord *>> buckets;
+	AtomVotes votes(nrAtoms); // the pairs of all batches, one atom of a pair may lie in another batch
+	do {
+		size_t begin = 0;
+		for (auto &batch : batches) {
+			const unsigned long end = (batch.second == windows.size()) ? std::numeric_limits<unsigned long>::max()
+				: batch.second * windowLength;
+			size_t last = begin;
+			while (last < nrAtoms && Region(wasteRegions[last].last, wasteRegions[last + 1].first).getMiddlePos() < end)
+				last++;
+			if (begin == last) continue;
+			load(batch.first, batch.second, records);
+			fillWindowBuckets(records, batch.first, batch.second, buckets);
+			connectAtomRange(wasteRegions, begin, last, buckets, batch.first * BUCKETS_PER_WINDOW, bucketSize,
+				minAlnCoverage, numThreads, nullptr, votes);
+			for (auto rec : records)
+				delete rec;
+			records.clear();
+			begin = last;
+		}
+	} while (uniteAtomPairs(votes, components));
+	return votes.getPeakBytes();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include "AlignmentRecord.h"
+
+struct IMPCounters;
+class ParityUnionFind;
+
+/* Disk-backed store of the alignment records for alignment sets larger than RAM (out-of-core mode, --maxMemory).
+While parsing, each record and its reverse are serialized once for every window of the concatenated
+sequence they cover as target, sorted runs are spilled to files in a directory and finally merged into one
+store file grouped by window. IMP and classify then walk the windows in batches: a batch loads its records
+and builds their buckets, its atoms are processed and everything is freed again, so only the working set of
+one batch plus the waste regions stay resident. Batches are sized to keep the estimated memory below maxMemory.
+The results equal those of an in-memory run. */
+class AlignmentStore {
+
+public:
+    /* Constructor. maxMemory == 0 disables the store, otherwise its files are kept in a new
+     * directory below dir, which is removed again by the destructor. */
+    AlignmentStore(const std::string &dir, unsigned long maxMemory, unsigned int bucketSize);
+
+    /* Destructor, removes the files of the store */
+    ~AlignmentStore();
+
+    /* Returns true if the store is used */
+    bool isEnabled() const { return maxMemory > 0; };
+
+    /* Takes the records, pairs of a record followed by its reverse as the parser creates them,
+     * serializes and deletes them, and clears records */
+    void add(std::deque<AlignmentRecord *> &records);
+
+    /* Merges the spilled runs into the store, totalLength is the length of the concatenated sequence */
+    void finish(unsigned long totalLength);
+
+    /* Returns the number of records added, including the reverse ones */
+    unsigned long getRecordCount() const { return recordCount; };
+
+    /* Creates the initial waste regions like initBreakpoints and createWaste from the breakpoints
+     * of the stored records and the sequence boundaries */
+    void createWaste(const std::vector<unsigned long> &speciesBoundaries, unsigned int minLength,
+            std::vector<WasteRegion> &wasteRegions) const;
+
+    /* Computes the new waste regions of one IMP iteration like newWasteRegionsForAtoms on all atoms */
+    void newWasteRegions(const std::vector<Region> &protoAtoms, const std::vector<WasteRegion> &wasteRegions,
+            unsigned int minLength, double epsilon, unsigned int numThreads,
+            std::vector<Region> &newRegions, IMPCounters &counters) const;
+
+    /* Connects all atoms between wasteRegions in components like constructAtomGraph, loading the windows
+     * once per pass over the atoms. Returns the peak memory of the votes. */
+    size_t connectAtoms(const std::vector<WasteRegion> &wasteRegions, float minAlnCoverage, unsigned int numThreads,
+            ParityUnionFind &components) const;
+
+private:
+    /* Location and estimated in-memory size of the records of one window in the store file */
+    struct Window {
+        unsigned long offset = 0;
+        unsigned long bytes = 0;
+        unsigned long cost = 0; // bytes of the records and bucket entries once loaded
+    };
+
+    std::string dir;
+    unsigned long maxMemory;
+    unsigned int bucketSize;
+    unsigned long windowLength;
+    unsigned long totalLength;
+    unsigned long recordCount;
+    std::vector<Window> windows; // index of the store file, filled by finish
+    std::string buffer; // serialized records of the current run, sorted by window when spilled
+    std::vector<std::pair<unsigned long, size_t>> entries; // window and offset in buffer of each entry
+    unsigned int runs; // spilled run files
+    mutable bool warnedLargeWindow;
+
+    // windows hold this many buckets, so the atoms of a window find all their buckets in it
+    static const unsigned int BUCKETS_PER_WINDOW = 1024;
+
+    std::string runPath(unsigned int run) const { return dir + "/run." + std::to_string(run); };
+    std::string storePath() const { return dir + "/store"; };
+
+    /* Writes the buffered entries, sorted by window, to the next run file */
+    void spill();
+
+    /* Splits the windows into batches [first, last) whose records fit the memory left besides residentBytes */
+    void planBatches(unsigned long residentBytes, std::vector<std::pair<size_t, size_t>> &batches) const;
+
+    /* Loads the records of windows [first, last), each pair once, into records (pairs with sym set).
+     * Throws if the store is truncated, records is then emptied. */
+    void load(size_t first, size_t last, std::deque<AlignmentRecord *> &records) const;
+
+    /* Fills buckets with the records covering the buckets of windows [first, last),
+     * buckets[0] being the bucket of the first position of window first */
+    void fillWindowBuckets(const std::deque<AlignmentRecord *> &records, size_t first, size_t last,
+            std::vector<std::vector<AlignmentRecord *>> &buckets) const;
+};
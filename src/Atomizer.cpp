@@ -1,74 +1,237 @@
-#include <iostream>
-#include <fstream>
-#include <string>
-#include <chrono>
-#include <vector>
-#include <deque>
-#include <algorithm>
-
-#include "AlignmentRecord.h"
-#include "InputParser.h"
-#include "Breakpoints.h"
-#include "IMP.h"
-#include "Classify.h"
-#include "Util.h"
-
-int main(int argc, char** argv) {
-	// only reason the following vars are not const is for cmd arg parsing
-	unsigned int maxGapLength, minAlnLength, minLength, bucketSize, numThreads;
-	float minAlnIdentity;
-        
-        InputParser parser;
-        parser.parseCmdArgs(argc, argv);
-        parser.getCmdLineArgs(minLength, maxGapLength, minAlnLength, minAlnIdentity, bucketSize, numThreads);
-
-	// init maps and vectors
-	std::map<std::string, unsigned long> speciesStarts; // maps species name to their starting position in concatenated string
-	std::vector<unsigned long> speciesBoundaries; // contains starting positions in concatenated sequence
-	std::deque<AlignmentRecord *> alignments;
-	std::vector<Breakpoint> breakPoints;
-	std::vector<WasteRegion> wasteRegions;
-	std::vector<Region> protoAtoms;
-
-	std::cerr << "Starting with parameters:\n"
-		<< "minLength: " << minLength << ", minIdent: " << minAlnIdentity * 100 << ", maxGap: "
-		<< maxGapLength << ", minAlnLength: " << minAlnLength
-		<<  ", bucketSize: " << bucketSize
-                <<  ", numThreads: " << numThreads << std::endl;
-	auto start = std::chrono::high_resolution_clock::now();
-	speciesStarts = { {"$", 0} };
-        
-        try{
-            parser.parsePsl(speciesStarts, alignments);
-        }catch(const std::exception &e){
-            std::cerr << e.what() << std::endl;
-            throw;
-        }
-	
-	for (auto i : speciesStarts) speciesBoundaries.push_back(i.second);
-	std::cerr << "INFO: PSL parsing done, considering " << alignments.size() << " alignments between "
-		<< speciesStarts.size() - 1 << " sequences.";
-	shoutTime(start);
-	std::vector<std::vector<AlignmentRecord *>>
-		buckets((speciesStarts.find("$")->second / bucketSize) + 1); // reserve with appropiate size
-	fillBuckets(alignments, bucketSize, buckets);
-	std::cerr << "INFO: Filled " << buckets.size() << " buckets.";
-	shoutTime(start);
-	const double epsilon = 1 / (static_cast<double>(bucketSize)*buckets.size());
-	initBreakpoints(alignments, speciesBoundaries, breakPoints);
-	createWaste(breakPoints, minLength, wasteRegions);
-	atomsFromWaste(wasteRegions, protoAtoms);
-	std::cerr << "INFO: Created " << wasteRegions.size() << " initial waste regions from initial breakpoints.";
-	shoutTime(start);
-	IMP(protoAtoms, wasteRegions, buckets, bucketSize, minLength, epsilon, start, numThreads);
-	std::vector<int> classes;
-	int nrClasses = 0;
-	classify(wasteRegions, buckets, bucketSize, minAlnIdentity, classes, nrClasses);
-	std::cerr << "Put " << wasteRegions.size() - 1 << " atoms in " << nrClasses << " classes. "
-		<< "Printing result." << std::endl;
-	shoutTime(start);
-	printResult(wasteRegions, classes, speciesStarts);
-        for (auto aln : alignments)
-            delete aln;
-	return EXIT_SUCCESS;
-}
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include "AlignmentRecord.h"
+#include "InputParser.h"
+#include "LibAtomizer.h"
+#include "Checkpoint.h"
+#include "Shard.h"
+#include "Scratch.h"
+#include "Kernels.h"
+#include "Metrics.h"
+#include "MemReport.h"
+#include "Server.h"
+#include "Numa.h"
+#include "ResultCache.h"
+#include "IMP.h"
+#include "Util.h"
+
+/* Writes result to out in outputFormat, returns false if writing fails */
+static bool formatResult(const AtomizerResult &result, const std::vector<std::string> &comments,
+	FILE *out, const std::string &outputFormat, unsigned int numThreads) {
+	return (outputFormat == "tsv")
+		? printResult(result.wasteRegions, result.classes, result.speciesStarts, comments, out, numThreads)
+		: writeBinaryResult(result.wasteRegions, result.classes, result.speciesStarts, comments, out, outputFormat == "compressed");
+}
+
+/* Writes result to out in outputFormat, exits if writing fails */
+static void writeResult(const AtomizerResult &result, const std::vector<std::string> &comments,
+	FILE *out, const std::string &outputFormat, unsigned int numThreads) {
+	if (!formatResult(result, comments, out, outputFormat, numThreads)) {
+		std::cerr << "ERROR: Writing the result failed." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* Runs atomizer with the command line arguments, the library reports errors as exceptions */
+static int run(int argc, char** argv) {
+	// only reason the following vars are not const is for cmd arg parsing
+	unsigned int maxGapLength, minAlnLength, minLength, bucketSize, numThreads;
+	unsigned int checkpointEvery, checkpointMinutes, numShards, shardIdx, maxIterations;
+	float minAlnIdentity, convergenceFraction;
+	std::string checkpointDir, shardDir, metricsPath, outputPath, outputFormat, servePath, kernelVariant, storeDir, cacheDir;
+	unsigned long maxMemory;
+	unsigned int serveWorkers;
+	unsigned int shardTimeout;
+	bool resume, shardWorker, spawnShards, reuseMappings, sweep, memReportEnabled, compactCoordinates, numaEnabled, hugePages;
+	std::vector<unsigned int> sweepMinLengths, sweepMinIdents;
+        
+        InputParser parser;
+        parser.parseCmdArgs(argc, argv);
+        parser.getCmdLineArgs(minLength, maxGapLength, minAlnLength, minAlnIdentity, bucketSize, numThreads);
+        parser.getCheckpointArgs(checkpointDir, checkpointEvery, checkpointMinutes, resume);
+        parser.getShardArgs(shardDir, numShards, shardWorker, shardIdx);
+        parser.getShardSpawnArgs(spawnShards, shardTimeout);
+        parser.getScratchArgs(ScratchArena::enabled);
+        parser.getCoordinateArgs(compactCoordinates);
+        parser.getKernelArgs(kernelVariant);
+        if (!selectKernels(kernelVariant)) {
+                std::cerr << "ERROR: This CPU does not support the " << kernelVariant << " kernels." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        parser.getMetricsArgs(metricsPath);
+        parser.getMemReportArgs(memReportEnabled);
+        parser.getStoreArgs(maxMemory, storeDir);
+        parser.getStopArgs(maxIterations, convergenceFraction);
+        parser.getNumaArgs(numaEnabled, hugePages);
+        parser.getClassifyArgs(reuseMappings);
+        parser.getOutputArgs(outputPath, outputFormat);
+        parser.getCacheArgs(cacheDir);
+        parser.getServeArgs(servePath, serveWorkers);
+        parser.getSweepArgs(sweep, sweepMinLengths, sweepMinIdents);
+        Checkpoint checkpoint(checkpointDir, checkpointEvery, checkpointMinutes, parser.inputFingerprint());
+        Shard shard(shardDir, numShards, parser.inputFingerprint(), shardTimeout);
+        if (shardWorker) shard.startWorker(shardIdx); // the heartbeats cover parsing as well
+        else if (shard.isEnabled()) shard.startCoordinator();
+        for (unsigned int k = 0; spawnShards && k < numShards; k++)
+                shard.spawnWorker(k, parser.shardWorkerArgs(k));
+        AlignmentStore store(storeDir, maxMemory, bucketSize);
+        Metrics metrics(metricsPath);
+        metrics.setParameter("minLength", minLength);
+        metrics.setParameter("minIdent", minAlnIdentity * 100);
+        metrics.setParameter("maxGap", maxGapLength);
+        metrics.setParameter("minAlnLength", minAlnLength);
+        metrics.setParameter("bucketSize", bucketSize);
+        metrics.setParameter("numThreads", numThreads);
+        metrics.setParameter("maxIterations", maxIterations);
+        metrics.setParameter("convergenceFraction", convergenceFraction);
+        MemReport memReport(memReportEnabled);
+        Numa numa(numaEnabled, hugePages);
+        FILE *out = stdout; // opened before the computation to fail early
+        if (!shardWorker && servePath.empty() && !sweep && !outputPath.empty() && (out = fopen(outputPath.c_str(), "w")) == nullptr) {
+                std::cerr << "ERROR: Output file could not be opened: " << outputPath << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        ResultCache cache(cacheDir, cacheDir.empty() ? 0 : parser.resultFingerprint());
+        if (cache.fetch(out)) {
+                std::cerr << "INFO: Result taken from the cache in " << cacheDir << "." << std::endl;
+                if (out != stdout) fclose(out);
+                metrics.write();
+                return EXIT_SUCCESS;
+        }
+
+	AtomizerOptions options;
+	options.minLength = minLength;
+	options.minAlnIdentity = minAlnIdentity;
+	options.maxGapLength = maxGapLength;
+	options.minAlnLength = minAlnLength;
+	options.bucketSize = bucketSize;
+	options.numThreads = numThreads;
+	options.maxIterations = maxIterations;
+	options.convergenceFraction = convergenceFraction;
+	options.compactCoordinates = compactCoordinates;
+	options.reuseMappings = reuseMappings;
+	AtomizerContext context;
+	context.checkpoint = &checkpoint;
+	context.shard = &shard;
+	context.store = &store;
+	context.metrics = &metrics;
+	context.memReport = &memReport;
+	context.numa = &numa;
+	context.resume = resume;
+	context.shardWorker = shardWorker;
+	context.shardIdx = shardIdx;
+
+	// init maps and vectors
+	std::map<std::string, unsigned long> speciesStarts; // maps species name to their starting position in concatenated string
+	std::deque<AlignmentRecord *> alignments;
+
+	std::cerr << "Starting with parameters:\n"
+		<< "minLength: " << minLength << ", minIdent: " << minAlnIdentity * 100 << ", maxGap: "
+		<< maxGapLength << ", minAlnLength: " << minAlnLength
+		<<  ", bucketSize: " << bucketSize
+                <<  ", numThreads: " << numThreads << ", kernels: " << kernels.name << std::endl;
+	if (numa.isEnabled() || hugePages) std::cerr << "INFO: " << numa.summary() << std::endl;
+	numa.interleave(); // the records, which all threads read, are spread over the nodes
+	auto start = std::chrono::high_resolution_clock::now();
+	speciesStarts = { {"$", 0} };
+        
+        metrics.startPhase("parse");
+        parser.parsePsl(speciesStarts, alignments, store.isEnabled() ? &store : nullptr);
+	
+	if (store.isEnabled()) store.finish(speciesStarts.find("$")->second);
+	std::cerr << "INFO: PSL parsing done, considering " << (store.isEnabled() ? store.getRecordCount() : alignments.size())
+		<< " alignments between "
+		<< speciesStarts.size() - 1 << " sequences.";
+	shoutTime(start);
+	memReport.setRecords(alignments);
+	memReport.print("parse");
+	if (!servePath.empty()) { // the alignments and buckets are kept for all requests
+		std::vector<std::vector<AlignmentRecord *>> buckets;
+		numa.fillBuckets(alignments, speciesStarts.find("$")->second, bucketSize, numThreads, buckets);
+		Server server(servePath, serveWorkers, alignments, buckets, speciesStarts, options);
+		server.run();
+		for (auto aln : alignments)
+			delete aln;
+		return EXIT_SUCCESS;
+	}
+	if (sweep) { // the records of each minIdent and their buckets are shared by all minLengths
+		metrics.startPhase("sweep");
+		for (auto minIdent : sweepMinIdents) {
+			std::deque<AlignmentRecord *> records;
+			selectRecords(alignments, minIdent / 100.0f, records);
+			numa.pinThreads(numThreads);
+			std::vector<std::vector<AlignmentRecord *>> buckets;
+			numa.fillBuckets(records, speciesStarts.find("$")->second, bucketSize, numThreads, buckets);
+			memReport.setBuckets(buckets);
+			AtomizerContext sweepContext;
+			sweepContext.memReport = &memReport;
+			sweepContext.numa = &numa;
+			for (auto sweepMinLength : sweepMinLengths) {
+				AtomizerOptions sweepOptions = options;
+				sweepOptions.minLength = sweepMinLength;
+				sweepOptions.minAlnIdentity = minIdent / 100.0f;
+				std::cerr << "INFO: Sweep with minLength " << sweepMinLength << ", minIdent " << minIdent
+					<< " on " << records.size() << " alignments." << std::endl;
+				AtomizerResult result;
+				atomizeBuckets(records, buckets, speciesStarts, sweepOptions, sweepContext, start, result);
+				std::string path = outputPath + ".minLength" + std::to_string(sweepMinLength) + ".minIdent"
+					+ std::to_string(minIdent) + ((outputFormat == "tsv") ? ".tsv" : ".seg");
+				FILE *sweepOut = fopen(path.c_str(), "w");
+				if (sweepOut == nullptr) {
+					std::cerr << "ERROR: Output file could not be opened: " << path << std::endl;
+					exit(EXIT_FAILURE);
+				}
+				std::vector<std::string> comments = { std::string("stop: ") + stopReasonName(result.stopReason)
+					+ " after " + std::to_string(result.iterations) + " IMP iterations",
+					"sweep: minLength " + std::to_string(sweepMinLength) + ", minIdent " + std::to_string(minIdent) };
+				writeResult(result, comments, sweepOut, outputFormat, numThreads);
+				fclose(sweepOut);
+			}
+		}
+		for (auto aln : alignments)
+			delete aln;
+		metrics.endPhase();
+		metrics.write();
+		return EXIT_SUCCESS;
+	}
+	AtomizerResult result;
+	bool done = runAtomizer(alignments, speciesStarts, options, context, start, result);
+	for (auto aln : alignments)
+		delete aln;
+	if (!done) { // shard worker
+		metrics.write();
+		return EXIT_SUCCESS;
+	}
+	metrics.startPhase("output");
+	std::vector<std::string> comments = { std::string("stop: ") + stopReasonName(result.stopReason)
+		+ " after " + std::to_string(result.iterations) + " IMP iterations" };
+	bool cached = false; // written once into the cache entry and copied from there, as out may be STDOUT
+	if (cache.isEnabled()) {
+		FILE *entry = cache.create();
+		bool stored = entry != nullptr && formatResult(result, comments, entry, outputFormat, numThreads);
+		if (entry != nullptr && !stored) cache.discard(entry);
+		cached = stored && cache.commit(entry) && cache.fetch(out);
+		if (!cached)
+			std::cerr << "WARNING: The result could not be stored in the cache in " << cacheDir << "." << std::endl;
+	}
+	if (!cached) writeResult(result, comments, out, outputFormat, numThreads);
+	if (out != stdout) fclose(out);
+	metrics.endPhase();
+	metrics.write();
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+	try {
+		return run(argc, argv);
+	} catch (const std::exception &e) { // the destructors have stopped spawned shard workers and removed the store
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
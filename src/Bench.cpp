@@ -0,0 +1,287 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "AlignmentRecord.h"
+#include "InputParser.h"
+#include "LibAtomizer.h"
+#include "IMP.h"
+#include "Classify.h"
+#include "Scratch.h"
+#include "Kernels.h"
+
+/* Microbenchmarks of the atomizer kernels on deterministic synthetic data (make bench).
+Every kernel is repeated for at least the given number of seconds, the time per operation and the
+throughput are printed as a table. Runs are single threaded, so results of versions are comparable.
+The kernels with vector variants (see Kernels.h) are run with each variant the CPU supports. */
+
+static double minSeconds = 0.5;
+static unsigned long sink = 0; // results of the kernels, so the compiler cannot drop them
+
+/* Repeats op, which performs itemsPerCall operations, until minSeconds passed and prints the time per operation.
+Returns the seconds per call. */
+template <typename Op>
+static double bench(const std::string &name, unsigned long itemsPerCall, const char *unit, Op op) {
+	op(); // warm up
+	unsigned long calls = 0;
+	double seconds = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	do {
+		op();
+		calls++;
+		seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	} while (seconds < minSeconds);
+	double items = static_cast<double>(calls) * itemsPerCall;
+	printf("%-40s %14.1f ns/op %14.0f %s/s\n", name.c_str(), seconds * 1e9 / items, items / seconds, unit);
+	fflush(stdout);
+	return seconds / calls;
+}
+
+/* Synthetic genomes with alignments between random positions, blocks separated by gaps below maxGap */
+struct SyntheticInput {
+	std::vector<std::string> names;
+	std::vector<unsigned long> sizes;
+	std::vector<std::string> lines; // the alignments as psl lines
+};
+
+static std::string join(const std::vector<unsigned long> &values) {
+	std::string result;
+	for (auto v : values)
+		result += std::to_string(v) + ",";
+	return result;
+}
+
+static void makeInput(unsigned int sequences, unsigned long sequenceSize, unsigned int count,
+	unsigned int maxBlocks, std::mt19937 &rng, SyntheticInput &input) {
+	for (unsigned int s = 0; s < sequences; s++) {
+		input.names.push_back("chr" + std::to_string(s));
+		input.sizes.push_back(sequenceSize);
+	}
+	std::uniform_int_distribution<unsigned int> sequence(0, sequences - 1), blocks(1, maxBlocks),
+		blockSize(20, 300), gap(0, 10), strand(0, 1);
+	for (unsigned int a = 0; a < count; a++) {
+		PslAlignment aln;
+		unsigned int q = sequence(rng), t = sequence(rng), n = blocks(rng);
+		aln.strand = strand(rng) ? '+' : '-';
+		aln.qName = input.names[q];
+		aln.tName = input.names[t];
+		aln.qSize = input.sizes[q];
+		aln.tSize = input.sizes[t];
+		unsigned long length = 0, qPos = 0, tPos = 0;
+		std::vector<unsigned long> qOffsets, tOffsets;
+		for (unsigned int b = 0; b < n; b++) {
+			if (b) {
+				qPos += gap(rng);
+				tPos += gap(rng);
+			}
+			unsigned int size = blockSize(rng);
+			aln.blockSizes.push_back(size);
+			qOffsets.push_back(qPos);
+			tOffsets.push_back(tPos);
+			qPos += size;
+			tPos += size;
+			length += size;
+		}
+		unsigned long qStart = std::uniform_int_distribution<unsigned long>(0, aln.qSize - qPos)(rng);
+		unsigned long tStart = std::uniform_int_distribution<unsigned long>(0, aln.tSize - tPos)(rng);
+		aln.qStart = qStart;
+		aln.qEnd = qStart + qPos;
+		aln.tStart = tStart;
+		aln.tEnd = tStart + tPos;
+		for (unsigned int b = 0; b < n; b++) { // query starts of - strand alignments count from the end
+			aln.qStarts.push_back((aln.strand == '+') ? qStart + qOffsets[b] : aln.qSize - aln.qEnd + qOffsets[b]);
+			aln.tStarts.push_back(tStart + tOffsets[b]);
+		}
+		aln.matches = length * 9 / 10;
+		aln.mismatches = length - aln.matches;
+		aln.repMatches = 0;
+		std::vector<unsigned long> sizes(aln.blockSizes.begin(), aln.blockSizes.end());
+		input.lines.push_back(std::to_string(aln.matches) + "\t" + std::to_string(aln.mismatches) + "\t0\t0\t0\t0\t0\t0\t"
+			+ aln.strand + "\t" + aln.qName + "\t" + std::to_string(aln.qSize) + "\t" + std::to_string(aln.qStart) + "\t"
+			+ std::to_string(aln.qEnd) + "\t" + aln.tName + "\t" + std::to_string(aln.tSize) + "\t"
+			+ std::to_string(aln.tStart) + "\t" + std::to_string(aln.tEnd) + "\t" + std::to_string(n) + "\t"
+			+ join(sizes) + "\t" + join(aln.qStarts) + "\t" + join(aln.tStarts));
+	}
+}
+
+/* Record with n blocks of 3 positions separated by gaps of 2, so 10k blocks still fit the local block type */
+static AlignmentRecord *makeRecord(unsigned int n) {
+	std::vector<unsigned int> sizes(n, 3);
+	std::vector<unsigned long> qStarts, tStarts;
+	for (unsigned int b = 0; b < n; b++) {
+		qStarts.push_back(1000000 + 5 * b);
+		tStarts.push_back(2000000 + 5 * b);
+	}
+	return new AlignmentRecord('+', 1000000, 1000000 + 5 * n, 2000000, 2000000 + 5 * n, n, sizes, qStarts, tStarts);
+}
+
+/* Sorted, unique waste regions mapped into an atom [atomStart, atomStart + atomLength], as IMP builds them */
+static void makeIntervals(unsigned long atomStart, unsigned long atomLength, unsigned int count,
+	std::mt19937 &rng, std::vector<Region> &intervals) {
+	std::uniform_int_distribution<unsigned long> position(atomStart, atomStart + atomLength), length(0, 20);
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned long first = position(rng);
+		intervals.push_back(Region(first, std::min(first + length(rng), atomStart + atomLength)));
+	}
+	intervals.push_back(Region(atomStart, atomStart));
+	intervals.push_back(Region(atomStart + atomLength, atomStart + atomLength));
+	std::sort(intervals.begin(), intervals.end());
+	intervals.erase(std::unique(intervals.begin(), intervals.end()), intervals.end());
+}
+
+int main(int argc, char **argv) {
+	if (argc > 2 || (argc == 2 && (minSeconds = atof(argv[1])) <= 0)) {
+		std::cerr << "Usage: atomizerBench [seconds per kernel (default: 0.5)]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::mt19937 rng(42);
+	SyntheticInput input;
+	makeInput(8, 1000000, 5000, 50, rng, input);
+	const unsigned int bucketSize = 1000;
+	printf("%-40s %20s %20s\n", "kernel", "time", "throughput");
+
+	// parsing, the records are kept for the following kernels
+	InputParser parser;
+	std::map<std::string, unsigned long> speciesStarts = { {"$", 0} };
+	std::deque<AlignmentRecord *> records;
+	{
+		unsigned long bytes = 0;
+		for (auto &line : input.lines)
+			bytes += line.size() + 1;
+		for (auto &variant : supportedKernels()) {
+			selectKernels(variant);
+			double seconds = bench("recordsFromPsl [" + variant + "]", input.lines.size(), "lines", [&]() {
+				for (auto rec : records)
+					delete rec;
+				records.clear();
+				speciesStarts = { {"$", 0} };
+				for (auto &line : input.lines)
+					sink += parser.parsePslLine(line, records, speciesStarts);
+			});
+			printf("%-40s %20s %14.1f MB/s\n", "", "", bytes / seconds / 1e6);
+		}
+		selectKernels("auto");
+	}
+	std::vector<AlignmentRecord *> forward;
+	for (auto rec : records)
+		if (rec->sym && rec < rec->sym) forward.push_back(rec);
+	unsigned long blocks = 0;
+	for (auto rec : forward)
+		blocks += rec->blockCount;
+	bench("AlignmentRecord::revert", forward.size(), "records", [&]() {
+		for (auto rec : forward) {
+			AlignmentRecord *reverse = rec->revert();
+			sink += reverse->tStart;
+			delete reverse;
+		}
+	});
+	printf("%-40s %20s %14.0f blocks/record\n", "", "", static_cast<double>(blocks) / forward.size());
+
+	const unsigned long totalLength = speciesStarts["$"];
+	std::vector<std::vector<AlignmentRecord *>> buckets;
+	bench("fillBuckets", records.size(), "records", [&]() {
+		buckets.assign(totalLength / bucketSize + 1, std::vector<AlignmentRecord *>());
+		fillBuckets(records, bucketSize, buckets);
+	});
+
+	// lookups in alignments of growing block counts
+	for (unsigned int n : {10, 100, 1000, 10000}) {
+		AlignmentRecord *rec = makeRecord(n);
+		std::vector<unsigned long> positions(4096);
+		std::uniform_int_distribution<unsigned long> position(rec->tStart, rec->tEnd);
+		for (auto &p : positions)
+			p = position(rng);
+		for (auto &variant : supportedKernels()) {
+			selectKernels(variant);
+			bench("binSearch_tStarts (" + std::to_string(n) + " blocks) [" + variant + "]", positions.size(), "lookups", [&]() {
+				for (auto p : positions)
+					sink += binSearch_tStarts(p, *rec);
+			});
+		}
+		selectKernels("auto");
+		bench("mapBreakpoint (" + std::to_string(n) + " blocks)", positions.size(), "lookups", [&]() {
+			for (auto p : positions)
+				sink += mapBreakpoint(p, *rec);
+		});
+		delete rec;
+	}
+
+	// waste regions of a converged run, for the region lookups and the atom graph
+	AtomizerOptions options;
+	options.bucketSize = bucketSize;
+	AtomizerResult result;
+	std::cerr << "Computing the waste regions of the synthetic input..." << std::endl;
+	std::streambuf *log = std::cerr.rdbuf(nullptr); // silence the progress of the run
+	runAtomizer(records, speciesStarts, options, AtomizerContext(), std::chrono::high_resolution_clock::now(), result);
+	std::cerr.rdbuf(log);
+	const std::vector<WasteRegion> &regions = result.wasteRegions;
+	{
+		std::vector<unsigned long> positions(4096);
+		std::uniform_int_distribution<unsigned long> position(0, totalLength);
+		for (auto &p : positions)
+			p = position(rng);
+		for (auto &variant : supportedKernels()) {
+			selectKernels(variant);
+			bench("binSearchRegion (" + std::to_string(regions.size()) + " regions) [" + variant + "]", positions.size(), "lookups", [&]() {
+				for (auto p : positions)
+					sink += binSearchRegion(p, regions);
+			});
+		}
+		selectKernels("auto");
+	}
+
+	// the per atom kernels of an IMP iteration
+	for (unsigned int count : {10, 100, 1000}) {
+		std::vector<Region> intervals;
+		makeIntervals(5000000, 20000, count, rng, intervals);
+		bench("partitionCoveringRegion (" + std::to_string(count) + " regions)", 1, "atoms", [&]() {
+			ScratchScope scratch;
+			scratch_vector<Region> input(intervals.begin(), intervals.end()), covering, notCovering;
+			partitionCoveringRegion(input, options.minLength, covering, notCovering);
+			sink += covering.size() + notCovering.size();
+		});
+		bench("createNewWasteRegions (" + std::to_string(count) + " regions)", 1, "atoms", [&]() {
+			ScratchScope scratch;
+			scratch_vector<Region> input(intervals.begin(), intervals.end()), covering, notCovering, newRegions;
+			partitionCoveringRegion(input, options.minLength, covering, notCovering);
+			sink += createNewWasteRegions(notCovering, covering, 1.0 / totalLength, options.minLength, 5000000, newRegions);
+		});
+	}
+	{
+		// the regions of the run plus new ones of an iteration, 10% as many, in random order
+		std::vector<WasteRegion> unconsolidated(regions);
+		std::uniform_int_distribution<unsigned long> position(0, totalLength - 100);
+		for (size_t i = 0; i < regions.size() / 10; i++) {
+			unsigned long first = position(rng);
+			unconsolidated.push_back(WasteRegion(Region(first, first + 50)));
+		}
+		std::shuffle(unconsolidated.begin(), unconsolidated.end(), rng);
+		std::vector<WasteRegion> work;
+		bench("consolidateRegions (" + std::to_string(unconsolidated.size()) + " regions)", unconsolidated.size(), "regions", [&]() {
+			work = unconsolidated;
+			consolidateRegions(work, options.minLength);
+			sink += work.size();
+		});
+	}
+	{
+		buckets.assign(totalLength / bucketSize + 1, std::vector<AlignmentRecord *>());
+		fillBuckets(records, bucketSize, buckets);
+		bench("constructAtomGraph (" + std::to_string(regions.size() - 1) + " atoms)", regions.size() - 1, "atoms", [&]() {
+			ParityUnionFind components(regions.size() - 1);
+			constructAtomGraph(regions, buckets, bucketSize, options.minAlnIdentity, 1, nullptr, components);
+			sink += components.getConflicts();
+		});
+	}
+
+	for (auto rec : records)
+		delete rec;
+	std::cerr << "checksum " << sink << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -1,39 +1,63 @@
-#include <iostream>
-#include <algorithm>
-#include "Breakpoints.h"
-
-void initBreakpoints(const std::deque<AlignmentRecord *>& alns,
-	const std::vector<unsigned long>& speciesBounds,
-	std::vector<Breakpoint>& result) {
-	for (auto bp : speciesBounds)
-		result.push_back(Breakpoint(bp));
-	for (auto aln : alns) {
-		result.push_back(Breakpoint(aln->tStart));
-		result.push_back(Breakpoint(aln->tEnd));
-	}
-	std::sort(result.begin(), result.end()); // sort breakpoints by position
-	auto last = std::unique(result.begin(), result.end()); // remove duplicate breakpoints
-	result.erase(last, result.end());
-}
-
-void createWaste(const std::vector<Breakpoint>& breakpoints, unsigned int minLength,
-	std::vector<WasteRegion>& result) {
-	if (breakpoints.empty()) {
-		std::cerr << "ERROR: Got empty breakpoint list when trying to create regions.";
-		exit(EXIT_FAILURE);
-	}
-	result.push_back(WasteRegion(breakpoints[0].position));
-	for (size_t i = 1; i < breakpoints.size(); i++) {
-		auto prev = &(result.back());
-		unsigned long distance = breakpoints[i].position - prev->last;
-		if (distance <= minLength) // too close for atom to be in between
-			prev->last = breakpoints[i].position;
-		else// distance > minLength, create new region
-			result.push_back(WasteRegion(breakpoints[i].position));
-	}
-}
-
-void atomsFromWaste(std::vector<WasteRegion>& wasteRegions, std::vector<Region>& result) {
-	for (size_t i = 0; i < wasteRegions.size() - 1; i++)
-		result.push_back(Region(wasteRegions[i].last,wasteRegions[i+1].first));
-}
\ No newline at end of file
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "Breakpoints.h"
+
+template <typename coord_t>
+void initBreakpoints(const std::deque<AlignmentRecord *>& alns,
+	const std::vector<unsigned long>& speciesBounds,
+	std::vector<BasicBreakpoint<coord_t>>& result) {
+	result.reserve(speciesBounds.size() + 2 * alns.size());
+	for (auto bp : speciesBounds)
+		result.push_back(BasicBreakpoint<coord_t>(bp));
+	for (auto aln : alns) {
+		result.push_back(BasicBreakpoint<coord_t>(aln->tStart));
+		result.push_back(BasicBreakpoint<coord_t>(aln->tEnd));
+	}
+	std::sort(result.begin(), result.end()); // sort breakpoints by position
+	auto last = std::unique(result.begin(), result.end()); // remove duplicate breakpoints
+	result.erase(last, result.end());
+}
+
+template <typename coord_t>
+void createWaste(const std::vector<BasicBreakpoint<coord_t>>& breakpoints, unsigned int minLength,
+	std::vector<BasicWasteRegion<coord_t>>& result) {
+	if (breakpoints.empty())
+		throw std::runtime_error("Got empty breakpoint list when trying to create regions.");
+	appendWaste(breakpoints, minLength, result);
+}
+
+template <typename coord_t>
+void appendWaste(const std::vector<BasicBreakpoint<coord_t>>& breakpoints, unsigned int minLength,
+	std::vector<BasicWasteRegion<coord_t>>& result) {
+	for (size_t i = 0; i < breakpoints.size(); i++) {
+		if (result.empty()) {
+			result.push_back(BasicWasteRegion<coord_t>(breakpoints[i].position));
+			continue;
+		}
+		auto prev = &(result.back());
+		unsigned long distance = breakpoints[i].position - prev->last;
+		if (distance <= minLength) // too close for atom to be in between
+			prev->last = breakpoints[i].position;
+		else// distance > minLength, create new region
+			result.push_back(BasicWasteRegion<coord_t>(breakpoints[i].position));
+	}
+}
+
+template <typename coord_t>
+void atomsFromWaste(std::vector<BasicWasteRegion<coord_t>>& wasteRegions, std::vector<BasicRegion<coord_t>>& result) {
+	for (size_t i = 0; i < wasteRegions.size() - 1; i++)
+		result.push_back(BasicRegion<coord_t>(wasteRegions[i].last,wasteRegions[i+1].first));
+}
+
+// the instantiations for both position types
+#define INSTANTIATE_BREAKPOINTS(coord_t) \
+	template void initBreakpoints(const std::deque<AlignmentRecord *>&, const std::vector<unsigned long>&, \
+		std::vector<BasicBreakpoint<coord_t>>&); \
+	template void createWaste(const std::vector<BasicBreakpoint<coord_t>>&, unsigned int, \
+		std::vector<BasicWasteRegion<coord_t>>&); \
+	template void appendWaste(const std::vector<BasicBreakpoint<coord_t>>&, unsigned int, \
+		std::vector<BasicWasteRegion<coord_t>>&); \
+	template void atomsFromWaste(std::vector<BasicWasteRegion<coord_t>>&, std::vector<BasicRegion<coord_t>>&);
+INSTANTIATE_BREAKPOINTS(unsigned long)
+INSTANTIATE_BREAKPOINTS(unsigned int)
\ No newline at end of file
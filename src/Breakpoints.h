@@ -1,19 +1,31 @@
-#pragma once
-#include <vector>
-#include <memory>
-#include <deque>
-#include "AlignmentRecord.h"
-
-/* Creates initial breakpoints from alignment and species boundaries and stores them in result. */
-void initBreakpoints(const std::deque<AlignmentRecord *>& alns,
-	const std::vector<unsigned long>& speciesBounds,
-	std::vector<Breakpoint>& result);
-
-/* Stores a list of Regions in result, created from input breakpoints.
-The result will be sorted by position. Expects input breakpoints to be sorted by position as well. */
-void createWaste(const std::vector<Breakpoint>& breakpoints, unsigned int minLength,
-	std::vector<WasteRegion>& result);
-
-/* Creates atoms as regions in between waste regions and stores them in result.
-The result will be sorted by length, ascending. */
-void atomsFromWaste(std::vector<WasteRegion>& wasteRegions, std::vector<Region>& result);
\ No newline at end of file
+#pragma once
+#include <vector>
+#include <memory>
+#include <deque>
+#include "AlignmentRecord.h"
+
+/* The functions are instantiated for unsigned long and unsigned int (compact) positions. */
+
+/* Creates initial breakpoints from alignment and species boundaries and stores them in result. */
+template <typename coord_t>
+void initBreakpoints(const std::deque<AlignmentRecord *>& alns,
+	const std::vector<unsigned long>& speciesBounds,
+	std::vector<BasicBreakpoint<coord_t>>& result);
+
+/* Stores a list of Regions in result, created from input breakpoints.
+The result will be sorted by position. Expects input breakpoints to be sorted by position as well.
+Throws std::runtime_error if there are no breakpoints. */
+template <typename coord_t>
+void createWaste(const std::vector<BasicBreakpoint<coord_t>>& breakpoints, unsigned int minLength,
+	std::vector<BasicWasteRegion<coord_t>>& result);
+
+/* Continues the regions in result, as created by createWaste, with further breakpoints.
+Expects the breakpoints to be sorted and to follow those result was created from. */
+template <typename coord_t>
+void appendWaste(const std::vector<BasicBreakpoint<coord_t>>& breakpoints, unsigned int minLength,
+	std::vector<BasicWasteRegion<coord_t>>& result);
+
+/* Creates atoms as regions in between waste regions and stores them in result.
+The result will be sorted by length, ascending. */
+template <typename coord_t>
+void atomsFromWaste(std::vector<BasicWasteRegion<coord_t>>& wasteRegions, std::vector<BasicRegion<coord_t>>& result);
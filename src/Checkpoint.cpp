@@ -0,0 +1,186 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "Checkpoint.h"
+#include "Util.h"
+
+static const char MAGIC[8] = {'G', 'S', 'P', 'R', 'E', 'G', 'S', '\0'};
+static const unsigned int VERSION = 1;
+
+/* Appends x to buf as LEB128 varint */
+static void putVarint(std::string &buf, unsigned long x) {
+	while (x >= 0x80) {
+		buf.push_back(static_cast<char>((x & 0x7f) | 0x80));
+		x >>= 7;
+	}
+	buf.push_back(static_cast<char>(x));
+}
+
+/* Reads a LEB128 varint from buf at pos, returns false if buf ends before the varint does */
+static bool getVarint(const std::string &buf, size_t &pos, unsigned long &x) {
+	x = 0;
+	for (unsigned int shift = 0; pos < buf.size() && shift < 64; shift += 7) {
+		unsigned char byte = buf[pos++];
+		x |= static_cast<unsigned long>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+bool replaceFile(const std::string &path, const std::string &data) {
+	std::string pattern = path + ".XXXXXX";
+	std::vector<char> name(pattern.c_str(), pattern.c_str() + pattern.size() + 1);
+	int fd = mkstemp(name.data()); // unique even between runs sharing the directory
+	if (fd < 0) return false;
+	std::string tmpPath = name.data();
+	FILE *out = fdopen(fd, "wb");
+	if (out == nullptr) {
+		close(fd);
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	bool ok = fwrite(data.data(), 1, data.size(), out) == data.size();
+	ok = ok && fflush(out) == 0 && fsync(fileno(out)) == 0; // the data is on disk before the file appears
+	ok = fclose(out) == 0 && ok;
+	if (ok) chmod(tmpPath.c_str(), 0644); // mkstemp creates the file readable by the owner only
+	ok = ok && std::rename(tmpPath.c_str(), path.c_str()) == 0;
+	if (!ok) std::remove(tmpPath.c_str());
+	return ok;
+}
+
+template <typename coord_t>
+bool writeRegionFile(const std::string &path, unsigned long fingerprint, unsigned long totalLength,
+	unsigned int iteration, const std::vector<BasicWasteRegion<coord_t>> &regions) {
+	unsigned int version = VERSION;
+	unsigned long count = regions.size();
+	std::string data;
+	data.append(MAGIC, sizeof(MAGIC));
+	data.append(reinterpret_cast<const char *>(&version), sizeof(version));
+	data.append(reinterpret_cast<const char *>(&fingerprint), sizeof(fingerprint));
+	data.append(reinterpret_cast<const char *>(&totalLength), sizeof(totalLength));
+	data.append(reinterpret_cast<const char *>(&iteration), sizeof(iteration));
+	data.append(reinterpret_cast<const char *>(&count), sizeof(count));
+	size_t checksumPos = data.size();
+	data.append(sizeof(unsigned long), '\0'); // the checksum of the body, set below
+	size_t bodyPos = data.size();
+	data.reserve(bodyPos + regions.size() * 4);
+	// regions are sorted by first position, so they are stored as varint deltas:
+	// distance from the start of the previous region, then length
+	unsigned long prevFirst = 0;
+	for (auto &region : regions) {
+		putVarint(data, region.first - prevFirst);
+		putVarint(data, region.last - region.first);
+		prevFirst = region.first;
+	}
+	unsigned long checksum = fnv1a(data.data() + bodyPos, data.size() - bodyPos);
+	memcpy(&data[checksumPos], &checksum, sizeof(checksum));
+	return replaceFile(path, data);
+}
+
+RegionFileStatus readRegionFile(const std::string &path, unsigned long fingerprint, unsigned long totalLength,
+	unsigned int &iteration, std::vector<WasteRegion> &regions) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in.is_open()) return REGIONS_MISSING;
+	char magic[sizeof(MAGIC)];
+	unsigned int version, storedIteration;
+	unsigned long storedFingerprint, storedLength, count, checksum;
+	in.read(magic, sizeof(magic));
+	in.read(reinterpret_cast<char *>(&version), sizeof(version));
+	in.read(reinterpret_cast<char *>(&storedFingerprint), sizeof(storedFingerprint));
+	in.read(reinterpret_cast<char *>(&storedLength), sizeof(storedLength));
+	in.read(reinterpret_cast<char *>(&storedIteration), sizeof(storedIteration));
+	in.read(reinterpret_cast<char *>(&count), sizeof(count));
+	in.read(reinterpret_cast<char *>(&checksum), sizeof(checksum));
+	if (!in || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION)
+		return REGIONS_UNREADABLE;
+	if (storedFingerprint != fingerprint || storedLength != totalLength)
+		return REGIONS_MISMATCH;
+	std::string body((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (fnv1a(body.data(), body.size()) != checksum)
+		return REGIONS_CORRUPT;
+
+	std::vector<WasteRegion> result;
+	result.reserve(count);
+	size_t pos = 0;
+	unsigned long prevFirst = 0;
+	for (unsigned long i = 0; i < count; i++) {
+		unsigned long delta, length;
+		if (!getVarint(body, pos, delta) || !getVarint(body, pos, length))
+			return REGIONS_CORRUPT;
+		WasteRegion region(prevFirst + delta);
+		region.last = region.first + length;
+		result.push_back(region);
+		prevFirst = region.first;
+	}
+	regions.swap(result);
+	iteration = storedIteration;
+	return REGIONS_OK;
+}
+
+Checkpoint::Checkpoint(const std::string &dir, unsigned int everyIterations, unsigned int everyMinutes,
+	unsigned long fingerprint)
+	: dir(dir), everyIterations(everyIterations), everyMinutes(everyMinutes),
+	  fingerprint(fingerprint), totalLength(0), lastIteration(0),
+	  lastWrite(std::chrono::steady_clock::now()) {
+	if (dir.empty()) return;
+	if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+		throw std::runtime_error("checkpoint directory could not be created: " + dir);
+}
+
+template <typename coord_t>
+void Checkpoint::update(const std::vector<BasicWasteRegion<coord_t>> &wasteRegions, unsigned int iteration) {
+	if (!isEnabled()) return;
+	auto minutes = std::chrono::duration_cast<std::chrono::minutes>(
+		std::chrono::steady_clock::now() - lastWrite).count();
+	if ((everyIterations && iteration - lastIteration >= everyIterations)
+		|| (everyMinutes && minutes >= everyMinutes))
+		write(wasteRegions, iteration);
+}
+
+template <typename coord_t>
+void Checkpoint::write(const std::vector<BasicWasteRegion<coord_t>> &wasteRegions, unsigned int iteration) {
+	if (!isEnabled()) return;
+	if (!writeRegionFile(path(), fingerprint, totalLength, iteration, wasteRegions)) {
+		std::cerr << "WARNING: checkpoint could not be written to " << path() << std::endl;
+		return;
+	}
+	lastIteration = iteration;
+	lastWrite = std::chrono::steady_clock::now();
+	std::cerr << "INFO: Wrote checkpoint of IMP iteration " << iteration << " ("
+		<< wasteRegions.size() << " waste regions)." << std::endl;
+}
+
+bool Checkpoint::load(unsigned long expectedLength, std::vector<WasteRegion> &wasteRegions,
+	unsigned int &iteration) {
+	if (!isEnabled()) return false;
+	switch (readRegionFile(path(), fingerprint, expectedLength, iteration, wasteRegions)) {
+	case REGIONS_OK:
+		lastIteration = iteration;
+		return true;
+	case REGIONS_MISSING:
+		std::cerr << "INFO: No checkpoint found in " << dir << ", starting from scratch." << std::endl;
+		break;
+	case REGIONS_MISMATCH:
+		std::cerr << "WARNING: Ignoring checkpoint " << path()
+			<< ", it was created from different input files or parameters." << std::endl;
+		break;
+	default:
+		std::cerr << "WARNING: Ignoring unreadable or corrupt checkpoint " << path() << std::endl;
+	}
+	return false;
+}
+
+// the instantiations for both position types
+#define INSTANTIATE_CHECKPOINT(coord_t) \
+	template bool writeRegionFile(const std::string&, unsigned long, unsigned long, unsigned int, \
+		const std::vector<BasicWasteRegion<coord_t>>&); \
+	template void Checkpoint::update(const std::vector<BasicWasteRegion<coord_t>>&, unsigned int); \
+	template void Checkpoint::write(const std::vector<BasicWasteRegion<coord_t>>&, unsigned int);
+INSTANTIATE_CHECKPOINT(unsigned long)
+INSTANTIATE_CHECKPOINT(unsigned int)
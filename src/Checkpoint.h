@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include "AlignmentRecord.h"
+
+/* Result of reading a region file, see readRegionFile */
+enum RegionFileStatus { REGIONS_OK, REGIONS_MISSING, REGIONS_UNREADABLE, REGIONS_MISMATCH, REGIONS_CORRUPT };
+
+/* Replaces the file at path by one holding data. The data is written to a unique temporary file in the same
+directory and synced before it is renamed, so readers and concurrent writers never see a partial file.
+Returns false on I/O errors. */
+bool replaceFile(const std::string &path, const std::string &data);
+
+/* Writes regions to path in a compact binary form (sorted regions stored as varint deltas plus checksum).
+The file is replaced with replaceFile, so readers never see a partial file.
+Regions must be sorted according to operator < in WasteRegion. Returns false on I/O errors.
+The file is the same for unsigned long and compact positions. */
+template <typename coord_t>
+bool writeRegionFile(const std::string &path, unsigned long fingerprint, unsigned long totalLength,
+	unsigned int iteration, const std::vector<BasicWasteRegion<coord_t>> &regions);
+
+/* Reads a file written by writeRegionFile into regions and iteration.
+Fails with REGIONS_MISMATCH if fingerprint or totalLength differ from the stored ones. */
+RegionFileStatus readRegionFile(const std::string &path, unsigned long fingerprint, unsigned long totalLength,
+	unsigned int &iteration, std::vector<WasteRegion> &regions);
+
+/* Persists the state of the IMP iterations (waste regions and iteration counter)
+to a directory, so a long run can be resumed after a crash or preemption.
+A checkpoint is only accepted on resume if its input fingerprint matches the current run. */
+class Checkpoint {
+
+public:
+    /* Constructor. An empty dir disables checkpointing.
+     * A checkpoint is written whenever everyIterations iterations
+     * or everyMinutes minutes have passed since the last one (0 disables either criterion). */
+    Checkpoint(const std::string &dir, unsigned int everyIterations, unsigned int everyMinutes,
+            unsigned long fingerprint);
+
+    /* Returns true if a checkpoint directory was given */
+    bool isEnabled() const { return !dir.empty(); };
+
+    /* Writes a checkpoint if enough iterations or time have passed since the last one */
+    template <typename coord_t>
+    void update(const std::vector<BasicWasteRegion<coord_t>> &wasteRegions, unsigned int iteration);
+
+    /* Writes a checkpoint unconditionally. The file is replaced atomically,
+     * so the previous checkpoint stays valid until the new one is complete. */
+    template <typename coord_t>
+    void write(const std::vector<BasicWasteRegion<coord_t>> &wasteRegions, unsigned int iteration);
+
+    /* Loads the last checkpoint into wasteRegions and iteration.
+     * Returns false if there is no checkpoint, it is corrupt, or it belongs to a different input
+     * (fingerprint or total sequence length don't match). */
+    bool load(unsigned long expectedLength, std::vector<WasteRegion> &wasteRegions,
+            unsigned int &iteration);
+
+    /* Sets the total length of the concatenated sequence, stored for validation on resume */
+    void setTotalLength(unsigned long length) { totalLength = length; };
+
+private:
+    std::string dir;
+    unsigned int everyIterations;
+    unsigned int everyMinutes;
+    unsigned long fingerprint;
+    unsigned long totalLength;
+    unsigned int lastIteration; // iteration of the last written checkpoint
+    std::chrono::time_point<std::chrono::steady_clock> lastWrite;
+
+    /* Path of the checkpoint file inside dir */
+    std::string path() const { return dir + "/imp.ckpt"; };
+};
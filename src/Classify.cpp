@@ -1,127 +1,252 @@
-#include <iostream>
-#include <algorithm>
-#include "Classify.h"
-#include "IMP.h"
-
-void chooseAtom(const std::vector<WasteRegion>& regions,
-	const Region mappedAtom, unsigned int regionFirst, unsigned int regionLast,
-	Region &atomResult, unsigned int &jResult) {
-	unsigned int maxJ = 0;
-	int maxLength = 0;
-	for (auto j = regionFirst; j < regionLast; j++) {
-		int newLength;
-		if (j == regionFirst)
-			newLength = regions[j+1].first - mappedAtom.first;
-		else if (j + 1 != regionLast)
-			newLength = regions[j + 1].first - regions[j].last + 1;
-		else { // j == regionLast - 1
-			if (regions[j + 1].last < mappedAtom.last)
-				newLength = mappedAtom.last - regions[j + 1].last;
-			else newLength = 0;
-		}
-		if (newLength > maxLength) {
-			maxLength = newLength;
-			maxJ = j;
-		}
-	}
-	if (!maxLength) {
-		std::cerr << "ERROR: Graph construction failed! maxLength is still 0 at the end of chooseAtom.";
-		exit(EXIT_FAILURE);
-	}
-	jResult = maxJ;
-	atomResult = Region(regions[maxJ].last, regions[maxJ+1].first);
-}
-
-/* Returns the portion of the atom that is covered by the interval [sndStart,sndEnd]. */
-float coverage(const Region atom, unsigned long sndStart, unsigned long sndEnd) {
-	unsigned long length = atom.getLength() - 1;
-	if (length == 0) length = 1;
-	long lastStart = std::max(atom.first, sndStart);
-	long firstEnd = std::min(atom.last, sndEnd);
-	float result = static_cast<float>(firstEnd - lastStart) / static_cast<float>(length);
-	return result;
-}
-
-/* Connects atoms only if they are aligned to each other and exceed minAlnCoverage. */
-void constructAtomGraph(const std::vector<WasteRegion>& regions,
-	const std::vector<std::vector<AlignmentRecord *>>& buckets,
-	unsigned int bucketSize, float minAlnCoverage,
-	std::vector<std::map<unsigned int, int>> &graph) {
-	for (size_t i = 0; i < regions.size() - 1; i++) {
-		Region atom(regions[i].last, regions[i+1].first);
-		unsigned long bucketIdx = atom.getMiddlePos() / bucketSize;
-		for (auto aln : buckets[bucketIdx]) { // iterate over alignments that could cover atom
-			if (aln->tStart > atom.first || aln->tEnd < atom.last) continue; // alignment doesn't cover atom
-			Region mappedAtom = mapAtomThroughAln(atom, *aln);
-			auto regionFirst = binSearchRegion(mappedAtom.first, regions);
-			auto regionLast = binSearchRegion(mappedAtom.last, regions);
-			unsigned int jfinal;
-			Region newAtom(0,0);
-			if (regionFirst == regionLast) {
-				newAtom = Region(regions[regionFirst].last, regions[regionFirst+1].first);
-				jfinal = regionFirst;
-			} else if (regionFirst == regionLast - 1) {
-				if (mappedAtom.last <= regions[regionLast].last) {
-					newAtom = Region(regions[regionFirst].last, regions[regionFirst + 1].first);
-					jfinal = regionFirst;
-				} else
-					chooseAtom(regions, mappedAtom, regionFirst, regionLast, newAtom, jfinal);
-			} else
-				chooseAtom(regions, mappedAtom, regionFirst, regionLast, newAtom, jfinal);
-			if (coverage(newAtom, aln->qStart, aln->qEnd) < minAlnCoverage) continue; // coverage too low
-			if (coverage(newAtom, mappedAtom.first, mappedAtom.last) <= 0.0f) continue;
-			if (coverage(mappedAtom, newAtom.first, newAtom.last) <= 0.0f) continue;
-			if (coverage(newAtom, aln->tStart, aln->tEnd) >= minAlnCoverage
-				&& coverage(atom, aln->qStart, aln->qEnd) >= minAlnCoverage) continue; // text and query cover both atoms
-			signed char strand = (aln->strand == '+') ? 1 : -1;
-			if (graph[i].count(jfinal))
-				graph[i].find(jfinal)->second += strand;
-			else graph[i].insert(std::make_pair(jfinal, strand));
-			if (graph[jfinal].count(i))
-				graph[jfinal].find(i)->second += strand;
-			else graph[jfinal].insert(std::make_pair(i, strand));
-		}
-	}
-	// remove unnecessary (i.e. empty) maps at back
-	while (!graph.empty() && graph.back().empty())
-		graph.pop_back();
-}
-
-/* Sets class of each atom in the connected component to classNr. */
-void fillComponent(const std::vector<std::map<unsigned int, int>> &graph,
-	std::vector<int> &classes, unsigned int i, int classNr) {
-	if (classes[i]) {
-		if (classes[i] != classNr && classes[i] != -classNr) {
-			std::cerr << "ERROR: Bad class when filling component. Class is "
-				<< classes[i] << ", but should be " << classNr;
-			exit(EXIT_FAILURE);
-		}
-		return;
-	}
-	classes[i] = classNr;
-	for (auto m : graph[i]) {
-		auto other = classNr;
-		if (m.second < 0) other = -classNr;
-		fillComponent(graph, classes, m.first, other);
-	}
-}
-
-void classify(const std::vector<WasteRegion>& regions,
-	const std::vector<std::vector<AlignmentRecord *>>& buckets,
-	unsigned int bucketSize, float minAlnCoverage,
-	std::vector<int> &classes, int &classNr) {
-	if (regions.size() < 2) {
-		std::cerr << "ERROR: Too few atoms for classification.";
-		return;
-	}
-	std::vector<std::map<unsigned int, int>> graph(regions.size() - 1);
-	constructAtomGraph(regions, buckets, bucketSize, minAlnCoverage, graph);
-	classes.resize(regions.size() - 1, 0);
-	classNr = 0;
-	for (size_t i = 0; i < regions.size()-1; i++) {
-		if (!classes[i]) {
-			classNr++;
-			fillComponent(graph, classes, i, classNr);
-		}
-	}
-}
\ No newline at end of file
+#include <iostream>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include "Classify.h"
+#include "IMP.h"
+
+void chooseAtom(const std::vector<WasteRegion>& regions,
+	const Region mappedAtom, unsigned int regionFirst, unsigned int regionLast,
+	Region &atomResult, unsigned int &jResult) {
+	unsigned int maxJ = 0;
+	long maxLength = 0;
+	for (auto j = regionFirst; j < regionLast; j++) {
+		long newLength;
+		if (j == regionFirst)
+			newLength = regions[j+1].first - mappedAtom.first;
+		else if (j + 1 != regionLast)
+			newLength = regions[j + 1].first - regions[j].last + 1;
+		else { // j == regionLast - 1
+			if (regions[j + 1].last < mappedAtom.last)
+				newLength = mappedAtom.last - regions[j + 1].last;
+			else newLength = 0;
+		}
+		if (newLength > maxLength) {
+			maxLength = newLength;
+			maxJ = j;
+		}
+	}
+	if (!maxLength)
+		throw std::runtime_error("Graph construction failed! maxLength is still 0 at the end of chooseAtom.");
+	jResult = maxJ;
+	atomResult = Region(regions[maxJ].last, regions[maxJ+1].first);
+}
+
+/* Returns the portion of the atom that is covered by the interval [sndStart,sndEnd]. */
+float coverage(const Region atom, unsigned long sndStart, unsigned long sndEnd) {
+	unsigned long length = atom.getLength() - 1;
+	if (length == 0) length = 1;
+	long lastStart = std::max(atom.first, sndStart);
+	long firstEnd = std::min(atom.last, sndEnd);
+	float result = static_cast<float>(firstEnd - lastStart) / static_cast<float>(length);
+	return result;
+}
+
+ParityUnionFind::ParityUnionFind(size_t n)
+	: parent(n), parity(n, 0), rank(n, 0), conflicts(0) {
+	for (size_t i = 0; i < n; i++)
+		parent[i] = i;
+}
+
+unsigned int ParityUnionFind::find(unsigned int x, bool &relParity) {
+	unsigned int root = x;
+	bool p = false;
+	while (parent[root] != root) {
+		p ^= parity[root];
+		root = parent[root];
+	}
+	// path compression, every node on the path gets its parity relative to root
+	bool px = p;
+	while (parent[x] != root && x != root) {
+		unsigned int next = parent[x];
+		bool pnext = px ^ parity[x];
+		parent[x] = root;
+		parity[x] = px;
+		x = next;
+		px = pnext;
+	}
+	relParity = p;
+	return root;
+}
+
+void ParityUnionFind::unite(unsigned int a, unsigned int b, bool opposite) {
+	if (a == b) return; // an atom aligned to itself doesn't connect anything
+	bool pa, pb;
+	unsigned int ra = find(a, pa), rb = find(b, pb);
+	if (ra == rb) {
+		if ((pa ^ pb) != opposite) conflicts++; // keep the strand found first
+		return;
+	}
+	if (rank[ra] < rank[rb]) std::swap(ra, rb);
+	parent[rb] = ra;
+	parity[rb] = pa ^ pb ^ opposite;
+	if (rank[ra] == rank[rb]) rank[ra]++;
+}
+
+/* Decides whether atom i and the atom its mapping through aln falls into are connected in the atom graph.
+mappedAtom is atom i mapped through aln, it lies in the waste regions regionFirst to regionLast. */
+static bool atomEdge(const std::vector<WasteRegion>& regions, unsigned int i, const AlignmentRecord &aln,
+	const Region mappedAtom, unsigned int regionFirst, unsigned int regionLast,
+	float minAlnCoverage, AtomEdge &edge) {
+	Region atom(regions[i].last, regions[i+1].first);
+	unsigned int jfinal;
+	Region newAtom(0,0);
+	if (regionFirst == regionLast) {
+		newAtom = Region(regions[regionFirst].last, regions[regionFirst+1].first);
+		jfinal = regionFirst;
+	} else if (regionFirst == regionLast - 1) {
+		if (mappedAtom.last <= regions[regionLast].last) {
+			newAtom = Region(regions[regionFirst].last, regions[regionFirst + 1].first);
+			jfinal = regionFirst;
+		} else
+			chooseAtom(regions, mappedAtom, regionFirst, regionLast, newAtom, jfinal);
+	} else
+		chooseAtom(regions, mappedAtom, regionFirst, regionLast, newAtom, jfinal);
+	if (coverage(newAtom, aln.qStart, aln.qEnd) < minAlnCoverage) return false; // coverage too low
+	if (coverage(newAtom, mappedAtom.first, mappedAtom.last) <= 0.0f) return false;
+	if (coverage(mappedAtom, newAtom.first, newAtom.last) <= 0.0f) return false;
+	if (coverage(newAtom, aln.tStart, aln.tEnd) >= minAlnCoverage
+		&& coverage(atom, aln.qStart, aln.qEnd) >= minAlnCoverage) return false; // text and query cover both atoms
+	edge = {std::min(i, jfinal), std::max(i, jfinal), (aln.strand == '+') ? 1 : -1};
+	return true;
+}
+
+/* Sorts edges by atom pair and replaces the edges of each pair by one with the sum of their votes */
+static void sumVotes(std::vector<AtomEdge> &edges) {
+	std::sort(edges.begin(), edges.end(), [](const AtomEdge &x, const AtomEdge &y) {
+		return x.i < y.i || (x.i == y.i && x.j < y.j); });
+	size_t sums = 0;
+	for (size_t e = 0; e < edges.size(); ) {
+		AtomEdge sum = edges[e];
+		size_t f = e + 1;
+		for ( ; f < edges.size() && edges[f].i == sum.i && edges[f].j == sum.j; f++)
+			sum.strand += edges[f].strand;
+		edges[sums++] = sum;
+		e = f;
+	}
+	edges.resize(sums);
+}
+
+AtomVotes::AtomVotes(size_t nrAtoms, size_t maxPairs)
+	: nrAtoms(nrAtoms), maxPairs(maxPairs ? maxPairs : std::max<size_t>(VOTE_PAIRS_PER_ATOM * nrAtoms, 1 << 16)),
+	lowFirst(0), lowEnd(nrAtoms), peakBytes(0) {}
+
+void AtomVotes::add(const std::vector<AtomEdge> &chunk) {
+	pairs.insert(pairs.end(), chunk.begin(), chunk.end());
+	peakBytes = std::max(peakBytes, pairs.capacity() * sizeof(AtomEdge));
+	if (pairs.size() <= maxPairs) return;
+	sumVotes(pairs); // a pair found in several chunks counts once
+	if (pairs.size() <= maxPairs / 2) return; // the next cut only after another maxPairs / 2 pairs
+	// keep the pairs of the lowest atoms, at least those of lowFirst so every pass makes progress
+	lowEnd = std::max<size_t>(pairs[maxPairs / 2].i, lowFirst + 1);
+	pairs.erase(std::lower_bound(pairs.begin(), pairs.end(), lowEnd,
+		[](const AtomEdge &pair, size_t i) { return pair.i < i; }), pairs.end());
+}
+
+bool uniteAtomPairs(AtomVotes &votes, ParityUnionFind &components) {
+	sumVotes(votes.pairs);
+	for (auto &pair : votes.pairs)
+		components.unite(pair.i, pair.j, pair.strand < 0);
+	std::vector<AtomEdge>().swap(votes.pairs);
+	votes.lowFirst = votes.lowEnd;
+	votes.lowEnd = votes.nrAtoms;
+	return votes.lowFirst < votes.nrAtoms;
+}
+
+/* Connects atoms only if they are aligned to each other and exceed minAlnCoverage.
+Atoms are processed in chunks: the edges of a chunk are collected in parallel and their strand votes are
+summed per atom pair. The votes of a pair found from both of its atoms may come from different chunks, so
+the pairs are only merged into components, in pair order, when all chunks are done, in several passes if
+there are too many pairs to keep (see AtomVotes). The result does not depend on numThreads.
+If mappings is given, the covering alignments of each atom are taken from it instead of searching the buckets. */
+size_t constructAtomGraph(const std::vector<WasteRegion>& regions,
+	const std::vector<std::vector<AlignmentRecord *>>& buckets,
+	unsigned int bucketSize, float minAlnCoverage, unsigned int numThreads,
+	const AtomMappings *mappings, ParityUnionFind &components, size_t maxPairs) {
+	AtomVotes votes(regions.size() - 1, maxPairs);
+	do
+		connectAtomRange(regions, 0, regions.size() - 1, buckets, 0, bucketSize, minAlnCoverage, numThreads,
+			mappings, votes);
+	while (uniteAtomPairs(votes, components));
+	return votes.getPeakBytes();
+}
+
+void connectAtomRange(const std::vector<WasteRegion>& regions, size_t begin, size_t end,
+	const std::vector<std::vector<AlignmentRecord *>>& buckets, unsigned long firstBucket,
+	unsigned int bucketSize, float minAlnCoverage, unsigned int numThreads,
+	const AtomMappings *mappings, AtomVotes &votes) {
+	const size_t CHUNK_ATOMS = 1 << 16; // bounds the buffer of the single votes of a chunk
+	std::vector<AtomEdge> edges;
+	std::exception_ptr error; // first exception of the threads, which cannot leave the parallel loop
+	#pragma omp declare reduction (merge : std::vector<AtomEdge> : omp_out.insert(omp_out.end(), omp_in.begin(), omp_in.end()))
+	for (size_t chunkStart = begin; chunkStart < end; chunkStart += CHUNK_ATOMS) {
+		size_t chunkEnd = std::min(end, chunkStart + CHUNK_ATOMS);
+		edges.clear();
+		#pragma omp parallel for num_threads(numThreads) schedule(dynamic, 1024) reduction(merge: edges)
+		for (size_t i = chunkStart; i < chunkEnd; i++) try {
+			AtomEdge edge;
+			if (mappings != nullptr) { // reuse the mappings of the last IMP iteration
+				for (size_t m = mappings->offsets[i]; m < mappings->offsets[i+1]; m++) {
+					const AtomMapping &mapping = mappings->mappings[m];
+					if (atomEdge(regions, i, *mapping.aln, Region(mapping.mappedFirst, mapping.mappedLast),
+						mapping.regionFirst, mapping.regionLast, minAlnCoverage, edge) && votes.keeps(edge.i))
+						edges.push_back(edge);
+				}
+				continue;
+			}
+			Region atom(regions[i].last, regions[i+1].first);
+			unsigned long bucketIdx = atom.getMiddlePos() / bucketSize;
+			for (auto aln : buckets[bucketIdx - firstBucket]) { // iterate over alignments that could cover atom
+				if (aln->tStart > atom.first || aln->tEnd < atom.last) continue; // alignment doesn't cover atom
+				Region mappedAtom = mapAtomThroughAln(atom, *aln);
+				auto regionFirst = binSearchRegion(mappedAtom.first, regions);
+				auto regionLast = binSearchRegion(mappedAtom.last, regions);
+				if (atomEdge(regions, i, *aln, mappedAtom, regionFirst, regionLast, minAlnCoverage, edge)
+					&& votes.keeps(edge.i))
+					edges.push_back(edge);
+			}
+		} catch (...) {
+			#pragma omp critical(connectAtomRangeError)
+			if (!error) error = std::current_exception();
+		}
+		if (error) std::rethrow_exception(error);
+
+		sumVotes(edges); // only one entry per pair and chunk is kept
+		votes.add(edges);
+	}
+}
+
+void classify(const std::vector<WasteRegion>& regions,
+	const std::vector<std::vector<AlignmentRecord *>>& buckets,
+	unsigned int bucketSize, float minAlnCoverage, unsigned int numThreads,
+	const AtomMappings *mappings, const AlignmentStore &store, std::vector<int> &classes, int &classNr,
+	size_t &voteBytes) {
+	voteBytes = 0;
+	if (regions.size() < 2) {
+		std::cerr << "ERROR: Too few atoms for classification.";
+		return;
+	}
+	ParityUnionFind components(regions.size() - 1);
+	if (mappings != nullptr && (!mappings->valid || mappings->offsets.size() != regions.size()))
+		mappings = nullptr; // IMP stopped before converging, its last mappings belong to other waste regions
+	if (store.isEnabled()) // load the alignments window by window
+		voteBytes = store.connectAtoms(regions, minAlnCoverage, numThreads, components);
+	else
+		voteBytes = constructAtomGraph(regions, buckets, bucketSize, minAlnCoverage, numThreads, mappings, components);
+	if (components.getConflicts())
+		std::cerr << "WARNING: " << components.getConflicts() << " atom pairs aligned with a strand "
+			<< "contradicting their component, kept the strand found first." << std::endl;
+	// number classes in order of their first atom, which gets the + strand
+	classes.assign(regions.size() - 1, 0);
+	std::vector<int> rootClass(regions.size() - 1, 0); // class of each root, negative if first atom has parity 1
+	classNr = 0;
+	for (size_t i = 0; i < regions.size() - 1; i++) {
+		bool parity;
+		unsigned int root = components.find(i, parity);
+		if (!rootClass[root]) {
+			classNr++;
+			rootClass[root] = parity ? -classNr : classNr;
+		}
+		classes[i] = parity ? -rootClass[root] : rootClass[root];
+	}
+}
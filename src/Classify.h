@@ -1,10 +1,104 @@
-#pragma once
-
-#include <map>
-#include "AlignmentRecord.h"
-
-/* Finds connected components. */
-void classify(const std::vector<WasteRegion> &regions,
-	const std::vector<std::vector<AlignmentRecord *>> &buckets,
-	unsigned int bucketSize, float minAlnCoverage,
-	std::vector<int> &classes, int &nrClasses);
\ No newline at end of file
+#pragma once
+
+#include <vector>
+#include "AlignmentRecord.h"
+#include "IMP.h"
+
+/* Union-find over atoms that also stores the relative strand (parity) of each atom to its root,
+so aligned atoms can be merged into classes while the alignments are processed. */
+class ParityUnionFind {
+
+public:
+    /* Constructor, each of the n atoms starts in its own component */
+    ParityUnionFind(size_t n);
+
+    /* Returns the root of x's component, relParity is true if x has the opposite strand of the root */
+    unsigned int find(unsigned int x, bool &relParity);
+
+    /* Merges the components of a and b, opposite is true if they are aligned on opposite strands.
+     * If both are already in the same component with a different relative strand, the existing strand is
+     * kept and the conflict is counted. */
+    void unite(unsigned int a, unsigned int b, bool opposite);
+
+    /* Returns the number of strand conflicts found by unite */
+    unsigned long getConflicts() const { return conflicts; };
+
+private:
+    std::vector<unsigned int> parent;
+    std::vector<unsigned char> parity; // strand of the atom relative to its parent
+    std::vector<unsigned char> rank;
+    unsigned long conflicts;
+};
+
+/* Edge of the atom graph between atoms i < j, strand is the strand vote of an alignment connecting them
+(+1 or -1) or the sum of the votes of several */
+struct AtomEdge {
+	unsigned int i;
+	unsigned int j;
+	int strand;
+};
+
+/* The strand votes of the atom pairs whose lower atom lies in [lowFirst, lowEnd), summed per pair.
+A pair is found from both of its atoms, so its votes are only complete once all atoms are processed.
+To bound the memory, at most about maxPairs pairs are kept: when there are more, lowEnd is lowered and the
+pairs of the higher atoms are dropped, a further pass over all atoms collects them (see uniteAtomPairs). */
+class AtomVotes {
+
+public:
+    /* Constructor for a pass over nrAtoms atoms, maxPairs 0 keeps VOTE_PAIRS_PER_ATOM pairs per atom */
+    AtomVotes(size_t nrAtoms, size_t maxPairs = 0);
+
+    /* Returns true if the pairs with lower atom i are collected in this pass */
+    bool keeps(unsigned int i) const { return i >= lowFirst && i < lowEnd; };
+
+    /* Adds the summed votes of a chunk of atoms, lowering lowEnd if more than maxPairs pairs are kept */
+    void add(const std::vector<AtomEdge> &chunk);
+
+    /* Returns the most memory the pairs took so far */
+    size_t getPeakBytes() const { return peakBytes; };
+
+    static const size_t VOTE_PAIRS_PER_ATOM = 4; // most atoms are aligned to few others, so one pass suffices
+
+private:
+    friend bool uniteAtomPairs(AtomVotes &votes, ParityUnionFind &components);
+
+    size_t nrAtoms;
+    size_t maxPairs;
+    size_t lowFirst;
+    size_t lowEnd;
+    std::vector<AtomEdge> pairs;
+    size_t peakBytes;
+};
+
+/* Connects the atoms aligned to each other by at least minAlnCoverage in components.
+If mappings is given, the covering alignments of each atom are taken from it instead of the buckets.
+maxPairs bounds the votes kept at once, see AtomVotes. Returns the peak memory of the votes. */
+size_t constructAtomGraph(const std::vector<WasteRegion> &regions,
+	const std::vector<std::vector<AlignmentRecord *>> &buckets,
+	unsigned int bucketSize, float minAlnCoverage, unsigned int numThreads,
+	const AtomMappings *mappings, ParityUnionFind &components, size_t maxPairs = 0);
+
+/* Like constructAtomGraph for the atoms [begin, end) only, buckets[0] being bucket firstBucket,
+so the atoms of a window can be connected with the buckets of that window. Instead of connecting the atoms,
+the edges found are added to votes. A pair is also found from the other atom, which may lie in another range,
+so call uniteAtomPairs once all ranges are done, and repeat all ranges while it returns true. */
+void connectAtomRange(const std::vector<WasteRegion> &regions, size_t begin, size_t end,
+	const std::vector<std::vector<AlignmentRecord *>> &buckets, unsigned long firstBucket,
+	unsigned int bucketSize, float minAlnCoverage, unsigned int numThreads,
+	const AtomMappings *mappings, AtomVotes &votes);
+
+/* Sums the strand votes per atom pair over all ranges and merges the pairs into components in pair order,
+on opposite strands if the sum is negative. Frees the pairs and returns true if the pairs of higher atoms
+were dropped, which another pass over all atoms collects. The passes go up in pair order, so the components
+are the same as if all pairs had been kept. */
+bool uniteAtomPairs(AtomVotes &votes, ParityUnionFind &components);
+
+/* Finds connected components. The atom graph is built with numThreads threads.
+If mappings holds the valid atom mappings of the last IMP iteration, they are used instead of the buckets.
+If store is enabled, the alignments are read from it window by window instead.
+voteBytes is set to the peak memory of the strand votes of the atom pairs. */
+void classify(const std::vector<WasteRegion> &regions,
+	const std::vector<std::vector<AlignmentRecord *>> &buckets,
+	unsigned int bucketSize, float minAlnCoverage, unsigned int numThreads,
+	const AtomMappings *mappings, const AlignmentStore &store, std::vector<int> &classes, int &nrClasses,
+	size_t &voteBytes);
\ No newline at end of file
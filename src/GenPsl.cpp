@@ -0,0 +1,383 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+/* Generates synthetic psl input for atomizer at any scale, without sequences or external tools.
+The genomes derive from a common ancestor, a chain of units of about --unitLength positions. Every genome
+gets its own rearrangements (inversions and transpositions of unit ranges) and segmental duplications,
+and copies of --repeatFamilies short repeat units are interspersed with --repeatDensity. The psl lines
+align every pair of copies of an ancestral unit and each repeat copy to --repeatLinks other copies,
+split into blocks of about --blockLength positions with small indels, and with probability --fragmentation
+a gap between blocks is longer than atomizer's default maxGap. The output only depends on the parameters
+and --seed, not on the number of threads. */
+
+/* Fast generator (splitmix64), one per unit so units can be generated in any order */
+struct Rng {
+	uint64_t state;
+
+	explicit Rng(uint64_t seed) : state(seed) {}
+
+	uint64_t next() {
+		uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+	/* Returns a number in [0, n), 0 if n is 0 */
+	uint64_t below(uint64_t n) { return n ? next() % n : 0; }
+	/* Returns a number in [lo, hi] */
+	uint64_t between(uint64_t lo, uint64_t hi) { return lo + below(hi - lo + 1); }
+	/* Returns true with probability p */
+	bool chance(double p) { return (next() >> 11) * (1.0 / 9007199254740992.0) < p; }
+};
+
+struct Params {
+	unsigned int genomes = 3;
+	unsigned long genomeLength = 1000000;
+	unsigned int chromosomes = 1;
+	unsigned int unitLength = 5000;
+	unsigned int rearrangements = 10;
+	unsigned int duplications = 5;
+	double repeatDensity = 0.05;
+	unsigned int repeatFamilies = 20;
+	unsigned int repeatLength = 300;
+	unsigned int repeatLinks = 5;
+	unsigned int blockLength = 200;
+	double fragmentation = 0.01;
+	unsigned int minIdent = 80;
+	unsigned long seed = 1;
+	unsigned int numThreads = 1;
+	std::string output;
+};
+
+/* A unit in a genome layout */
+struct Piece {
+	uint32_t unit;
+	bool reverse;
+};
+
+/* Where a copy of a unit lies */
+struct Occurrence {
+	uint32_t sequence;
+	uint64_t position;
+	bool reverse;
+};
+
+struct Sequence {
+	std::string name;
+	uint64_t size;
+};
+
+/* Appends the decimal representation of x to buf */
+static inline void appendUInt(std::string &buf, uint64_t x) {
+	char digits[20];
+	int n = 0;
+	do {
+		digits[n++] = '0' + x % 10;
+		x /= 10;
+	} while (x);
+	while (n) buf.push_back(digits[--n]);
+}
+
+/* Applies the rearrangements and duplications of one genome to layout */
+static void evolve(const Params &params, Rng &rng, std::vector<Piece> &layout) {
+	const uint64_t maxRange = std::max<uint64_t>(1, std::min<uint64_t>(20, layout.size() / 100));
+	for (unsigned int r = 0; r < params.rearrangements && layout.size() > 1; r++) {
+		uint64_t length = rng.between(1, maxRange), first = rng.below(layout.size() - length + 1);
+		if (rng.chance(0.5)) { // inversion
+			std::reverse(layout.begin() + first, layout.begin() + first + length);
+			for (uint64_t i = first; i < first + length; i++)
+				layout[i].reverse = !layout[i].reverse;
+		} else { // transposition
+			std::vector<Piece> moved(layout.begin() + first, layout.begin() + first + length);
+			layout.erase(layout.begin() + first, layout.begin() + first + length);
+			uint64_t to = rng.below(layout.size() + 1);
+			layout.insert(layout.begin() + to, moved.begin(), moved.end());
+		}
+	}
+	for (unsigned int d = 0; d < params.duplications && !layout.empty(); d++) {
+		uint64_t length = rng.between(1, std::min<uint64_t>(5, layout.size())), first = rng.below(layout.size() - length + 1);
+		std::vector<Piece> copy(layout.begin() + first, layout.begin() + first + length);
+		if (rng.chance(0.5)) { // duplicated to the other strand
+			std::reverse(copy.begin(), copy.end());
+			for (auto &piece : copy)
+				piece.reverse = !piece.reverse;
+		}
+		uint64_t to = rng.below(layout.size() + 1);
+		layout.insert(layout.begin() + to, copy.begin(), copy.end());
+	}
+}
+
+/* Appends the psl line aligning the copies q and t of a unit of length length,
+returns false if the unit is too short to be aligned */
+static bool emitAlignment(const Params &params, Rng &rng, const std::vector<Sequence> &sequences,
+	const Occurrence &q, const Occurrence &t, uint64_t length, std::string &buf, unsigned long &blockCount) {
+	const uint64_t trimMax = std::min<uint64_t>(params.blockLength / 4, length / 4);
+	uint64_t xq = rng.below(trimMax + 1), xt = xq;
+	const uint64_t end = length - rng.below(trimMax + 1);
+	std::vector<uint64_t> sizes, qOffsets, tOffsets;
+	uint64_t qInserts = 0, qInserted = 0, tInserts = 0, tInserted = 0;
+	while (xq < end && xt < end) {
+		if (!sizes.empty()) { // gap to the previous block
+			uint64_t qGap, tGap;
+			if (rng.chance(params.fragmentation)) // splits the alignment in atomizer
+				qGap = tGap = rng.between(14, 100);
+			else {
+				qGap = rng.below(6);
+				tGap = rng.below(6);
+				if (!qGap && !tGap) qGap = 1;
+			}
+			xq += qGap;
+			xt += tGap;
+			if (xq >= end || xt >= end) break;
+			qInserts += (qGap > 0);
+			qInserted += qGap;
+			tInserts += (tGap > 0);
+			tInserted += tGap;
+		}
+		uint64_t size = std::min(rng.between(1, 2 * params.blockLength), end - std::max(xq, xt));
+		sizes.push_back(size);
+		qOffsets.push_back(xq);
+		tOffsets.push_back(xt);
+		xq += size;
+		xt += size;
+	}
+	if (sizes.empty()) return false;
+	const size_t n = sizes.size();
+	const Sequence &qSeq = sequences[q.sequence], &tSeq = sequences[t.sequence];
+	const bool minus = q.reverse != t.reverse;
+	// query starts of - strand alignments are positions on the reverse complement
+	const uint64_t qBase = minus ? qSeq.size - q.position - length : q.position;
+	const uint64_t qFirst = qBase + qOffsets[0], qLast = qBase + qOffsets[n - 1] + sizes[n - 1];
+	uint64_t aligned = 0;
+	for (auto size : sizes)
+		aligned += size;
+	const uint64_t identity = rng.between(params.minIdent, 100);
+	const uint64_t matches = aligned * identity / 100;
+
+	appendUInt(buf, matches);
+	buf.push_back('\t');
+	appendUInt(buf, aligned - matches);
+	buf.append("\t0\t0\t");
+	appendUInt(buf, qInserts);
+	buf.push_back('\t');
+	appendUInt(buf, qInserted);
+	buf.push_back('\t');
+	appendUInt(buf, tInserts);
+	buf.push_back('\t');
+	appendUInt(buf, tInserted);
+	buf.push_back('\t');
+	buf.push_back(minus ? '-' : '+');
+	buf.push_back('\t');
+	buf.append(qSeq.name);
+	buf.push_back('\t');
+	appendUInt(buf, qSeq.size);
+	buf.push_back('\t');
+	appendUInt(buf, minus ? qSeq.size - qLast : qFirst);
+	buf.push_back('\t');
+	appendUInt(buf, minus ? qSeq.size - qFirst : qLast);
+	buf.push_back('\t');
+	buf.append(tSeq.name);
+	buf.push_back('\t');
+	appendUInt(buf, tSeq.size);
+	buf.push_back('\t');
+	appendUInt(buf, t.position + tOffsets[0]);
+	buf.push_back('\t');
+	appendUInt(buf, t.position + tOffsets[n - 1] + sizes[n - 1]);
+	buf.push_back('\t');
+	appendUInt(buf, n);
+	buf.push_back('\t');
+	for (auto size : sizes) {
+		appendUInt(buf, size);
+		buf.push_back(',');
+	}
+	buf.push_back('\t');
+	for (auto offset : qOffsets) {
+		appendUInt(buf, qBase + offset);
+		buf.push_back(',');
+	}
+	buf.push_back('\t');
+	for (auto offset : tOffsets) {
+		appendUInt(buf, t.position + offset);
+		buf.push_back(',');
+	}
+	buf.push_back('\n');
+	blockCount += n;
+	return true;
+}
+
+static void printUsage() {
+	Params defaults;
+	std::cerr << "Usage: genPsl -o <file|-> [options]\n\n"
+		<< "Generates synthetic psl input for atomizer, see the top of GenPsl.cpp for the model.\n"
+		<< "The descriptors are NOT case-sensitive.\n"
+		<< "-o <file>: Output file, - for STDOUT.\n"
+		<< "--genomes <num>: Number of genomes (default: " << defaults.genomes << ").\n"
+		<< "--genomeLength <num>: Approximate length of each genome (default: " << defaults.genomeLength << ").\n"
+		<< "--chromosomes <num>: Sequences per genome (default: " << defaults.chromosomes << ").\n"
+		<< "--unitLength <num>: Mean length of the ancestral units (default: " << defaults.unitLength << ").\n"
+		<< "--rearrangements <num>: Inversions and transpositions per genome (default: " << defaults.rearrangements << ").\n"
+		<< "--duplications <num>: Segmental duplications per genome (default: " << defaults.duplications << ").\n"
+		<< "--repeatDensity <frac>: Repeat copies per ancestral unit (default: " << defaults.repeatDensity << ").\n"
+		<< "--repeatFamilies <num>: Number of repeat families (default: " << defaults.repeatFamilies << ").\n"
+		<< "--repeatLength <num>: Length of the repeat units (default: " << defaults.repeatLength << ").\n"
+		<< "--repeatLinks <num>: Alignments of each repeat copy to other copies (default: " << defaults.repeatLinks << ").\n"
+		<< "--blockLength <num>: Mean block length (default: " << defaults.blockLength << ").\n"
+		<< "--fragmentation <frac>: Probability of a gap longer than maxGap between blocks (default: "
+		<< defaults.fragmentation << ").\n"
+		<< "--minIdent <num>: Lowest identity of the alignments in percent (default: " << defaults.minIdent << ").\n"
+		<< "--seed <num>: Random seed (default: " << defaults.seed << ").\n"
+		<< "--numThreads <num>: Threads formatting the output (default: " << defaults.numThreads << ")." << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc <= 1) {
+		printUsage();
+		return EXIT_SUCCESS;
+	}
+	Params params;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		std::transform(arg.begin(), arg.end(), arg.begin(), tolower);
+		if (i + 1 >= argc) {
+			std::cerr << "Missing value for argument " << arg << ". Call without arguments for instructions." << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::string value = argv[++i];
+		try {
+			if (arg == "-o") params.output = value;
+			else if (arg == "--genomes") params.genomes = std::stoul(value);
+			else if (arg == "--genomelength") params.genomeLength = std::stoul(value);
+			else if (arg == "--chromosomes") params.chromosomes = std::stoul(value);
+			else if (arg == "--unitlength") params.unitLength = std::stoul(value);
+			else if (arg == "--rearrangements") params.rearrangements = std::stoul(value);
+			else if (arg == "--duplications") params.duplications = std::stoul(value);
+			else if (arg == "--repeatdensity") params.repeatDensity = std::stod(value);
+			else if (arg == "--repeatfamilies") params.repeatFamilies = std::stoul(value);
+			else if (arg == "--repeatlength") params.repeatLength = std::stoul(value);
+			else if (arg == "--repeatlinks") params.repeatLinks = std::stoul(value);
+			else if (arg == "--blocklength") params.blockLength = std::stoul(value);
+			else if (arg == "--fragmentation") params.fragmentation = std::stod(value);
+			else if (arg == "--minident") params.minIdent = std::stoul(value);
+			else if (arg == "--seed") params.seed = std::stoul(value);
+			else if (arg == "--numthreads") params.numThreads = std::stoul(value);
+			else {
+				std::cerr << "Unknown argument " << arg << ". Call without arguments for instructions." << std::endl;
+				return EXIT_FAILURE;
+			}
+		} catch (const std::exception &) {
+			std::cerr << "The value for argument " << arg << " could not be parsed." << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	if (params.output.empty() || !params.genomes || !params.chromosomes || params.unitLength < 2
+		|| !params.blockLength || params.minIdent > 100 || !params.numThreads) {
+		std::cerr << "genPsl needs -o, at least one genome and chromosome, --unitLength >= 2, --blockLength >= 1,\n"
+			<< "--minIdent <= 100 and --numThreads >= 1." << std::endl;
+		return EXIT_FAILURE;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	Rng rng(params.seed);
+
+	// ancestral units, followed by one unit per repeat family
+	const uint64_t ancestralUnits = std::max<uint64_t>(1, params.genomeLength / params.unitLength);
+	std::vector<uint64_t> unitLengths;
+	for (uint64_t u = 0; u < ancestralUnits; u++)
+		unitLengths.push_back(rng.between(params.unitLength / 2, params.unitLength * 3 / 2));
+	for (unsigned int f = 0; f < params.repeatFamilies; f++)
+		unitLengths.push_back(std::max<uint64_t>(2, rng.between(params.repeatLength * 9 / 10, params.repeatLength * 11 / 10)));
+	std::vector<Piece> ancestor;
+	for (uint64_t u = 0; u < ancestralUnits; u++) {
+		ancestor.push_back({static_cast<uint32_t>(u), false});
+		if (params.repeatFamilies && rng.chance(params.repeatDensity))
+			ancestor.push_back({static_cast<uint32_t>(ancestralUnits + rng.below(params.repeatFamilies)), rng.chance(0.5)});
+	}
+
+	// lay out the genomes and collect where the copies of each unit are
+	std::vector<Sequence> sequences;
+	std::vector<std::vector<Occurrence>> layoutOccurrences(params.genomes);
+	std::vector<std::vector<Piece>> layouts(params.genomes, ancestor);
+	for (unsigned int g = 0; g < params.genomes; g++) {
+		std::vector<Piece> &layout = layouts[g];
+		evolve(params, rng, layout);
+		const uint64_t perChromosome = (layout.size() + params.chromosomes - 1) / params.chromosomes;
+		for (uint64_t i = 0; i < layout.size(); i++) {
+			if (i % perChromosome == 0)
+				sequences.push_back({"g" + std::to_string(g) + ".chr" + std::to_string(i / perChromosome), 0});
+			Sequence &sequence = sequences.back();
+			layoutOccurrences[g].push_back({static_cast<uint32_t>(sequences.size() - 1), sequence.size, layout[i].reverse});
+			sequence.size += unitLengths[layout[i].unit] + rng.below(params.unitLength / 10 + 1); // unique spacer
+		}
+	}
+	std::vector<size_t> offsets(unitLengths.size() + 1, 0); // occurrences of unit u: occurrences[offsets[u]..offsets[u+1])
+	for (auto &layout : layouts)
+		for (auto &piece : layout)
+			offsets[piece.unit + 1]++;
+	for (size_t u = 0; u < unitLengths.size(); u++)
+		offsets[u + 1] += offsets[u];
+	std::vector<Occurrence> occurrences(offsets.back());
+	std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned int g = 0; g < params.genomes; g++)
+		for (size_t i = 0; i < layouts[g].size(); i++)
+			occurrences[fill[layouts[g][i].unit]++] = layoutOccurrences[g][i];
+	layouts.clear();
+	layoutOccurrences.clear();
+
+	FILE *out = (params.output == "-") ? stdout : fopen(params.output.c_str(), "w");
+	if (out == nullptr) {
+		std::cerr << "ERROR: Output file could not be opened: " << params.output << std::endl;
+		return EXIT_FAILURE;
+	}
+	// format chunks of units in parallel, then write them in order
+	const size_t CHUNK_UNITS = 256;
+	const size_t units = unitLengths.size();
+	std::vector<std::string> bufs(params.numThreads);
+	unsigned long blocks = 0, bytes = 0, lines = 0;
+	for (size_t roundStart = 0; roundStart < units; roundStart += CHUNK_UNITS * params.numThreads) {
+		#pragma omp parallel for num_threads(params.numThreads) schedule(static, 1) reduction(+: blocks, lines)
+		for (unsigned int k = 0; k < params.numThreads; k++) {
+			bufs[k].clear();
+			size_t begin = std::min(units, roundStart + k * CHUNK_UNITS), end = std::min(units, begin + CHUNK_UNITS);
+			for (size_t u = begin; u < end; u++) {
+				Rng unitRng(params.seed * 0x100000001b3ULL + u);
+				const size_t first = offsets[u], count = offsets[u + 1] - offsets[u];
+				if (u < ancestralUnits) {
+					for (size_t i = 0; i < count; i++)
+						for (size_t j = i + 1; j < count; j++)
+							lines += emitAlignment(params, unitRng, sequences, occurrences[first + i], occurrences[first + j],
+								unitLengths[u], bufs[k], blocks);
+				} else if (count > 1) { // repeat copies are linked to some others only, to stay linear in the copies
+					for (size_t i = 0; i < count; i++)
+						for (unsigned int l = 0; l < params.repeatLinks; l++) {
+							size_t j = (i + 1 + unitRng.below(count - 1)) % count;
+							lines += emitAlignment(params, unitRng, sequences, occurrences[first + i], occurrences[first + j],
+								unitLengths[u], bufs[k], blocks);
+						}
+				}
+			}
+		}
+		for (auto &buf : bufs) {
+			if (fwrite(buf.data(), 1, buf.size(), out) != buf.size()) {
+				std::cerr << "ERROR: Writing the output failed." << std::endl;
+				return EXIT_FAILURE;
+			}
+			bytes += buf.size();
+		}
+	}
+	if (fflush(out) != 0 || (out != stdout && fclose(out) != 0)) {
+		std::cerr << "ERROR: Writing the output failed." << std::endl;
+		return EXIT_FAILURE;
+	}
+	uint64_t totalLength = 0;
+	for (auto &sequence : sequences)
+		totalLength += sequence.size;
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cerr << "Wrote " << lines << " alignments with " << blocks << " blocks (" << bytes << " bytes) between "
+		<< sequences.size() << " sequences of " << totalLength << " positions in " << ms << " milliseconds." << std::endl;
+	return EXIT_SUCCESS;
+}
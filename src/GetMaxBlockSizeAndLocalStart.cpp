@@ -1,19 +1,113 @@
-#include <iostream>
-#include <fstream>
-#include <stdexcept>
-#include <vector>
-#include <string>
-
-#include "Util.h"
-#include "InputParser.h"
-
-int main(int argc, char *argv[]) {
-    unsigned long max_bsize, max_start;
-    
-    InputParser parser;
-    parser.parseCmdArgs(argc, argv);
-    parser.getMaxBlockSizeAndLocalStart(max_bsize, max_start);
-    std::cerr << "For values that fit, MAX SIZE: " << max_bsize << ", MAX START: " << max_start << std::endl;
-    
-    return 0;
-}
\ No newline at end of file
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+#include "Util.h"
+#include "InputParser.h"
+
+/* Prints bytes in a human readable unit */
+static std::string formatBytes(double bytes) {
+    const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int u = 0;
+    for ( ; bytes >= 1024 && u < 4; u++)
+        bytes /= 1024;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.1f %s", bytes, units[u]);
+    return buf;
+}
+
+/* Pre-flight memory planner: scans the psl files with the given parsing options and reports the block
+ * width the records need, the number of records after gap splitting and the memory of the records and
+ * of the buckets for candidate bucket sizes, to size a run before starting it.
+ * Takes the arguments of atomizer and additionally --bucketSizes <size,size,...>. */
+int main(int argc, char *argv[]) {
+    std::vector<unsigned int> bucketSizes;
+    std::vector<char *> args; // arguments for InputParser, without --bucketSizes
+    for (int i = 0; i < argc; i++) {
+        std::string arg = argv[i];
+        std::transform(arg.begin(), arg.end(), arg.begin(), tolower);
+        if (arg == "--bucketsizes" && i + 1 < argc) {
+            std::string list = argv[++i];
+            size_t pos = 0;
+            try {
+                while (pos <= list.size()) {
+                    size_t comma = std::min(list.find(',', pos), list.size());
+                    bucketSizes.push_back(stoui(list.substr(pos, comma - pos)));
+                    pos = comma + 1;
+                }
+            } catch (const std::exception &e) {
+                std::cerr << "The value for argument --bucketSizes could not be parsed." << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else args.push_back(argv[i]);
+    }
+    if (argc == 1)
+        std::cerr << "GetMaxBlockSizeAndLocalStart takes the arguments of atomizer and additionally\n"
+                  << "--bucketSizes <size,size,...>: Bucket sizes to predict the bucket memory for\n"
+                  << "  (default: --bucketSize and 250, 500, 1000, 2000, 5000, 10000).\n" << std::endl;
+    int parserArgc = args.size();
+    char **parserArgv = args.data();
+    unsigned int minLength, maxGapLength, minAlnLength, bucketSize, numThreads;
+    float minAlnIdentity;
+    InputParser parser;
+    try {
+        parser.parseCmdArgs(parserArgc, parserArgv);
+    } catch (const std::exception &e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    parser.getCmdLineArgs(minLength, maxGapLength, minAlnLength, minAlnIdentity, bucketSize, numThreads);
+    if (bucketSizes.empty())
+        bucketSizes = {250, 500, 1000, 2000, 5000, 10000};
+    if (std::find(bucketSizes.begin(), bucketSizes.end(), bucketSize) == bucketSizes.end())
+        bucketSizes.push_back(bucketSize);
+    std::sort(bucketSizes.begin(), bucketSizes.end());
+    if (bucketSizes.front() == 0) {
+        std::cerr << "Bucket sizes must be positive." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    MemoryPlan plan;
+    try {
+        parser.planMemory(bucketSizes, plan);
+    } catch (const std::exception &e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cerr << "INFO: Scanned " << plan.lines << " alignments.";
+    shoutTime(start);
+
+    const unsigned int widths[3] = {2, 4, 8};
+    unsigned int width = plan.requiredBlockWidth();
+    std::cout << "Parameters: maxGap " << maxGapLength << ", minAlnLength " << minAlnLength
+              << ", minIdent " << minAlnIdentity * 100 << "\n"
+              << "Alignments: " << plan.lines << " (" << plan.lowIdentity << " below minIdent)\n"
+              << "Sequences: " << plan.sequences << ", concatenated length " << plan.totalLength << "\n"
+              << "Records after gap splitting: " << plan.records << " (including reverse), " << plan.blocks << " blocks\n"
+              << "Max block size: " << plan.maxBlockSize << ", max local block start: " << plan.maxLocalStart
+              << ", max block count: " << plan.maxBlockCount << "\n"
+              << "Required block width: " << width << " bytes (compiled: " << sizeof(block_local_t) << " bytes"
+              << (width > sizeof(block_local_t) ? ", TOO SMALL, change BLOCKS_SIZE in AlignmentRecord.h" : "") << ")\n"
+              << "Predicted AlignmentRecord memory:\n";
+    for (int w = 0; w < 3; w++)
+        std::cout << "  " << widths[w] << " byte blocks: " << formatBytes(plan.recordBytes[w])
+                  << (widths[w] == sizeof(block_local_t) ? " (compiled)" : "")
+                  << (widths[w] < width ? " (values don't fit)" : "") << "\n";
+    std::cout << "Predicted bucket memory (entries + up to the same again for vector growth):\n";
+    for (size_t b = 0; b < plan.bucketSizes.size(); b++) {
+        unsigned long buckets = plan.totalLength / plan.bucketSizes[b] + 1;
+        double bytes = static_cast<double>(buckets) * sizeof(std::vector<AlignmentRecord *>)
+            + static_cast<double>(plan.bucketEntries[b]) * sizeof(AlignmentRecord *);
+        std::cout << "  --bucketSize " << plan.bucketSizes[b] << ": " << buckets << " buckets, "
+                  << plan.bucketEntries[b] << " entries, " << formatBytes(bytes) << " to "
+                  << formatBytes(bytes + plan.bucketEntries[b] * sizeof(AlignmentRecord *))
+                  << (plan.bucketSizes[b] == bucketSize ? " (--bucketSize)" : "") << "\n";
+    }
+    std::cout.flush();
+    return EXIT_SUCCESS;
+}
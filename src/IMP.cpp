@@ -1,302 +1,463 @@
-#include <algorithm>
-#include <map>
-#include <set>
-#include <iostream>
-#include <utility>
-
-#include "Util.h"
-#include "IMP.h"
-
-
-void IMP(std::vector<Region>& protoAtoms,
-	std::vector<WasteRegion>& wasteRegions,
-	const std::vector<std::vector<AlignmentRecord *>>& buckets,
-	unsigned int bucketSize, unsigned int minLength, double epsilon,
-	const std::chrono::time_point<std::chrono::high_resolution_clock> start,
-	unsigned int numThreads) {
-	
-	auto startIMP = std::chrono::high_resolution_clock::now();
-	
-	int iterationCount = 0;
-	while (true) {
-		#pragma omp declare reduction (merge : std::vector<Region> : omp_out.insert(omp_out.end(), omp_in.begin(), omp_in.end()))
-		std::vector<Region> newRegions;
-		#pragma omp parallel for num_threads(numThreads) reduction(merge: newRegions)
-		for (size_t i = 0; i < protoAtoms.size(); i++) { // iterate over all current atoms
-			Region* atom = &protoAtoms[i];
-			unsigned long bucketIdx = atom->getMiddlePos() / bucketSize;
-			auto alns = &buckets[bucketIdx]; // get all alignments that contain middlePos
-			std::vector<Region> intervals; // waste region set W
-			for (auto aln : *alns) { // iterate over all alignments covering the atom
-				if (aln->tStart > atom->first || aln->tEnd < atom->last) continue; // skip alns that don't cover atom
-				Region mappedRegion = mapAtomThroughAln(*atom, *aln);
-				auto regionFirst = binSearchRegion(mappedRegion.first, wasteRegions);
-				auto regionLast = binSearchRegion(mappedRegion.last, wasteRegions);
-				for (auto j = regionFirst; j <= regionLast; j++) { // iterate over waste regions in mappedRegion
-					WasteRegion* currentRegion = &wasteRegions[j];
-					if (mappedRegion.first > currentRegion->last || currentRegion-> first > mappedRegion.last) continue;
-					// map waste region back to atom
-					auto inverseRegionFirst = mapBreakpoint(currentRegion->first, *(aln->sym));
-					auto inverseRegionLast = mapBreakpoint(currentRegion->last, *(aln->sym));
-					// skip if inversely mapped region does not overlap atom
-					if ((inverseRegionFirst < atom->first && inverseRegionLast < atom->first)
-						|| (inverseRegionFirst > atom->last && inverseRegionLast > atom->last))
-						continue;
-					// else push region to interval list
-					if (inverseRegionFirst > inverseRegionLast)
-						std::swap(inverseRegionFirst, inverseRegionLast);
-					Region inverselyMappedRegion(inverseRegionFirst, inverseRegionLast);
-					// clip ends to atom
-					if (inverselyMappedRegion.first < atom->first) inverselyMappedRegion.first = atom->first;
-					if (inverselyMappedRegion.last > atom->last) inverselyMappedRegion.last = atom->last;
-					intervals.push_back(inverselyMappedRegion);
-				} // end of iteration over waste in mappedRegion
-			} // end of iteration over alignments containing middlepos
-			// add waste regions at ends of atom
-			intervals.push_back(Region(atom->first, atom->first));
-			intervals.push_back(Region(atom->last, atom->last));
-			std::sort(intervals.begin(), intervals.end()); // sorting before removing duplicates
-			intervals.erase(std::unique(intervals.begin(), intervals.end()), intervals.end()); // remove duplicates
-
-			// create waste region set set W_new from W
-			std::vector<Region> covering, notCovering, newWasteRegions;
-			partitionCoveringRegion(intervals, minLength, covering, notCovering);
-			createNewWasteRegions(notCovering, covering, epsilon, minLength, atom->first, newWasteRegions);
-			// add W_new to all new regions
-			newRegions.insert(newRegions.end(), newWasteRegions.begin(), newWasteRegions.end());
-		}
-		wasteRegions.insert(wasteRegions.end(), newRegions.begin(), newRegions.end());
-		consolidateRegions(wasteRegions, minLength); // join new and old waste regions
-		std::vector<Region> newAtoms;
-		atomsFromWaste(wasteRegions, newAtoms);
-		if (!areDifferent(protoAtoms, newAtoms)) break; // stop if there is no improvement
-		protoAtoms = newAtoms;
-		std::cerr << "INFO: " << wasteRegions.size() << " waste regions after IMP iteration "
-			<< ++iterationCount << ".";
-		shoutTime(start);
-	}
-	std::cerr << "IMP algorithm done.";
-
-	auto endIMP = std::chrono::high_resolution_clock::now();
-	auto timeIMP = std::chrono::duration_cast<std::chrono::milliseconds>(endIMP - startIMP).count();
-	std::cerr << " Algorithm time: " << timeIMP << " milliseconds.";
-	
-	shoutTime(start);
-}
-
-void fillBuckets(std::deque<AlignmentRecord *>& alns, unsigned int bucketSize,
-	std::vector<std::vector<AlignmentRecord *>>& result) {
-	unsigned int firstBucket, lastBucket;
-        for (auto bucket : result)
-            bucket.reserve(bucketSize); // preallocate vector of the necessary size
-	for (auto alnPtr : alns) {
-		firstBucket = alnPtr->tStart / bucketSize;
-		lastBucket = alnPtr->tEnd / bucketSize;
-		for (auto i = firstBucket; i <= lastBucket; i++)
-			result[i].push_back(alnPtr);
-	}
-}
-
-unsigned int binSearch_tStarts(unsigned long x, const AlignmentRecord& aln) {
-	unsigned int result = std::distance(aln.begin_tStarts(), std::upper_bound(aln.begin_tStarts(), aln.end_tStarts(), x));
-	if (result == 0) return result;
-	else return result - 1;
-}
-
-unsigned int binSearchRegion(unsigned long x, const std::vector<WasteRegion>& bpList) {
-	const WasteRegion tmp(x);
-	unsigned int result = std::distance(bpList.begin(), std::upper_bound(bpList.begin(), bpList.end(), tmp,
-		[](WasteRegion lbp, WasteRegion rbp) {return lbp.first < rbp.first; }));
-	if (result == 0) return result;
-	else return result - 1;
-}
-
-unsigned int mapBreakpoint(unsigned long bpPosition, const AlignmentRecord& aln) {
-	auto idx = binSearch_tStarts(bpPosition, aln);
-	unsigned int result;
-	unsigned long dist = (bpPosition >= aln.get_tStarts(idx)) ? bpPosition - aln.get_tStarts(idx) : 0;
-	if (dist > aln.blockSizes[idx]) dist = aln.blockSizes[idx];
-	if (aln.strand == '+')
-		result = aln.get_qStarts(idx) + dist;
-	else
-		result = aln.get_qStarts(idx) - dist;
-	return result;
-}
-
-Region mapAtomThroughAln(const Region& atom, const AlignmentRecord& aln) {
-	auto firstMapped = mapBreakpoint(atom.first, aln);
-	auto lastMapped = mapBreakpoint(atom.last, aln);
-	if (firstMapped <= lastMapped) return Region(firstMapped, lastMapped);
-	else return Region(lastMapped, firstMapped);
-}
-
-void partitionCoveringRegion(const std::vector<Region>& input, unsigned int minL,
-	std::vector<Region>& covering, std::vector<Region>& notCovering) {
-	int minLength = static_cast<signed int>(minL);
-	for (size_t i = 0; i < input.size(); i++) {
-		const Region* currentRegion = &input[i];
-		long lastShortStart, lastLongStart;
-
-		if (notCovering.empty()) lastShortStart = 0 - minLength - 2;
-		else lastShortStart = notCovering.back().first;
-		if (covering.empty()) lastLongStart = 0 - minLength - 2;
-		else lastLongStart = covering.back().first;
-
-		if (lastLongStart >= 0 && static_cast<unsigned long>(lastLongStart) >= currentRegion->first) {
-			while (lastLongStart >= 0 && static_cast<unsigned long>(lastLongStart) >= currentRegion->first) {
-				if (!covering.empty()) covering.pop_back();
-				if (covering.empty()) lastLongStart = 0 - minLength - 2;
-				else lastLongStart = covering.back().first;
-			}
-			covering.push_back(*currentRegion);
-		} else {
-			if (lastShortStart >= 0 && static_cast<unsigned long>(lastShortStart) >= currentRegion->first)
-				covering.push_back(*currentRegion);
-			else notCovering.push_back(*currentRegion);
-		}
-	}
-}
-
-/* Calculates the optimal cost for a new waste region set with waste regions at pos and in closestLeftRegion.
-Best results for each position are stored for dynamic programming. */
-void dpFindOptimal(Region closestLeftRegion, std::map<unsigned long, dpPosition>& allPositions,
-	unsigned long pos, double epsilon, unsigned int minLength) {
-	std::vector<dpStats> positionCost; // contains min cost for each pos & position which achieved it
-	for (auto l = closestLeftRegion.first; l <= closestLeftRegion.last; l++) { // iterate over P(j,k)
-		if ((pos - l) < minLength) // join waste regions
-			positionCost.push_back(dpStats(allPositions.find(l)->second.cost + pos - l, true, l));
-		else {
-			bool alignedToWaste = false;
-			for (auto i : allPositions.find(l)->second.notCoveringIds)
-				for (auto j : allPositions.find(pos)->second.notCoveringIds)
-					if (i == j) alignedToWaste = true;
-			if (alignedToWaste)  // join waste regions
-				positionCost.push_back(dpStats(allPositions.find(l)->second.cost + pos - l, true, l));
-			else // don't join - create new atom in between
-				positionCost.push_back(dpStats(allPositions.find(l)->second.cost + epsilon, false, l));
-
-			// now check covering regions
-			alignedToWaste = false;
-			for (auto i : allPositions.find(l)->second.coveringIds)
-				for (auto j : allPositions.find(pos)->second.coveringIds)
-					if (i == j) alignedToWaste = true;
-			if (alignedToWaste)
-				positionCost.push_back(dpStats(allPositions.find(l)->second.cost + pos - l, true, l));
-			else
-				positionCost.push_back(dpStats(allPositions.find(l)->second.cost + epsilon, false, l));
-		}
-	}
-	dpStats optimal = *std::min_element(positionCost.rbegin(), positionCost.rend(),
-		[](dpStats a, dpStats b) {return a.cost < b.cost; });
-	dpPosition* toChange = &allPositions.find(pos)->second;
-	toChange->cost = optimal.cost;
-	toChange->dist = optimal.dist;
-	toChange->prev = optimal.prev;
-}
-
-/* After the cost of an optimal solution is computed, the optimal set for that solution
-is created by tracing back the stored positions. The optimal set will be stored in result. */
-void dpTraceBack(std::map<unsigned long, dpPosition>& allPositions,
-	unsigned long lastPos, unsigned long atomFirst, std::vector<Region>& result) {
-	unsigned long currentPos = allPositions.find(lastPos)->second.prev;
-	dpPosition *posData = &(allPositions.find(currentPos)->second);
-	std::vector<bool> tmpRegionBools;
-        bool is_first = true;
-	while (currentPos >= atomFirst) {
-		if (is_first) {
-                        result.push_back(Region(currentPos, currentPos));
-			tmpRegionBools.push_back(posData->dist);
-                        is_first = false;
-                }
-		else {
-                        bool tmpBool = tmpRegionBools.back();
-                        Region *tmpRegion = &result.back();
-			if (tmpBool) {
-				tmpRegion->first = currentPos;
-                                tmpRegionBools[tmpRegionBools.size()-1] = posData->dist;
-			}
-			else {
-                                tmpRegionBools.push_back(posData->dist);
-				result.push_back(Region(currentPos, currentPos));
-			}
-		}
-		if (!currentPos) break; // atom starts at 0
-		currentPos = posData->prev;
-		posData = &(allPositions.find(currentPos)->second);
-	}
-}
-
-void createNewWasteRegions(const std::vector<Region>& notCovering, const std::vector<Region>& covering,
-	double epsilon, unsigned int minLength, unsigned long atomStart, std::vector<Region>& result) {
-	std::set<unsigned long> nonCovPos; // positions in noncovering
-	std::map<unsigned long, dpPosition> allPositions; // positions in either vector
-
-	// collect positions of nonCovering intervals
-	for (size_t i = 0; i < notCovering.size(); i++) {
-		const Region* curRegion = &notCovering[i];
-		for (auto pos = curRegion->first; pos <= curRegion->last; pos++) {
-			nonCovPos.insert(pos);
-			allPositions.insert(std::pair<unsigned long, dpPosition>(pos, dpPosition(i))).
-				first->second.notCoveringIds.push_back(i);
-		}
-	}
-	// add positions also contained in covering regions
-	for (size_t i = 0; i < covering.size(); i++) {
-		const Region* curRegion = &covering[i];
-		for (auto pos = curRegion->first; pos <= curRegion->last; pos++)
-			if (allPositions.count(pos))
-				allPositions.find(pos)->second.coveringIds.push_back(i);
-	}
-
-	std::set<unsigned int> *currentShortIntervals = new std::set<unsigned int>(), *lastShortIntervals = new std::set<unsigned int>();
-	unsigned int lastFinishedIdx = 0;
-	for (auto pos : nonCovPos) { // iterate over all viable positions i from left to right
-		auto position = allPositions.find(pos);
-		for (auto i : position->second.notCoveringIds)
-			currentShortIntervals->insert(i);
-		if (pos == *(nonCovPos.begin())) continue; // only init for first (leftmost) position
-		// get ID of rightmost region not containing pos but left of pos
-		for (auto previous : *lastShortIntervals)
-			if (currentShortIntervals->find(previous) == currentShortIntervals->end()) // not in set
-				lastFinishedIdx = previous;
-		dpFindOptimal(notCovering[lastFinishedIdx], allPositions, pos, epsilon, minLength);
-		delete lastShortIntervals;
-                lastShortIntervals = currentShortIntervals; //lastShortIntervals = currentShortIntervals;
-		currentShortIntervals = new std::set<unsigned int>(); //currentShortIntervals.clear();
-	}
-	dpTraceBack(allPositions, notCovering.back().last, atomStart, result);
-        delete lastShortIntervals; delete currentShortIntervals;
-}
-
-void consolidateRegions(std::vector<WasteRegion> &regions, unsigned int minLength) {
-	std::vector<WasteRegion> tmp(regions);
-	std::sort(tmp.begin(), tmp.end());
-	regions.clear();
-	size_t i = 0;
-	WasteRegion currentRegion = *tmp.begin();
-	while (i < tmp.size()) {
-		if (i + 1 < tmp.size()) {
-			WasteRegion nextRegion = tmp[i + 1];
-			i++;
-			if (nextRegion.first <= currentRegion.last + minLength) {
-				// join regions
-				currentRegion.last = std::max(currentRegion.last, nextRegion.last);
-			} else { // not close enough to join
-				regions.push_back(currentRegion);
-				currentRegion = nextRegion;
-			}
-		} else { // push last element region
-			regions.push_back(currentRegion);
-			i++;
-		}
-	}
-}
-
-bool areDifferent(std::vector<Region> &first, std::vector<Region> &second) {
-	if (first.size() != second.size()) return true;
-	// if size is equal, compare each elements positions
-	for (size_t i = 0; i < first.size(); i++)
-		if (first[i].first != second[i].first || first[i].last != second[i].last)
-			return true;
-	return false;
-}
+#include <algorithm>
+#include <map>
+#include <set>
+#include <iostream>
+#include <utility>
+#include <limits>
+#include <stdexcept>
+#include <omp.h>
+
+#include "Util.h"
+#include "Scratch.h"
+#include "IMP.h"
+#include "Kernels.h"
+
+
+const char *stopReasonName(IMPStopReason reason) {
+	switch (reason) {
+	case IMP_MAX_ITERATIONS: return "maxIterations";
+	case IMP_CONVERGENCE_FRACTION: return "convergenceFraction";
+	default: return "converged";
+	}
+}
+
+/* Computes the new waste regions by the worker processes of shard or from store, if either is enabled,
+and returns true, else false. Both work on unsigned long positions only. */
+static bool newWasteRegionsElsewhere(const std::vector<Region>& protoAtoms, const std::vector<WasteRegion>& wasteRegions,
+	unsigned int minLength, double epsilon, unsigned int numThreads, Shard &shard, const AlignmentStore &store,
+	std::vector<Region>& newRegions, IMPCounters& counters) {
+	if (shard.isEnabled()) // let the worker processes compute the new regions
+		shard.newWasteRegions(wasteRegions, newRegions);
+	else if (store.isEnabled()) // load the alignments window by window
+		store.newWasteRegions(protoAtoms, wasteRegions, minLength, epsilon, numThreads, newRegions, counters);
+	else
+		return false;
+	return true;
+}
+
+static bool newWasteRegionsElsewhere(const std::vector<CompactRegion>&, const std::vector<CompactWasteRegion>&,
+	unsigned int, double, unsigned int, Shard &shard, const AlignmentStore &store,
+	std::vector<CompactRegion>&, IMPCounters&) {
+	if (shard.isEnabled() || store.isEnabled())
+		throw std::logic_error("Shards and the alignment store need unsigned long positions");
+	return false;
+}
+
+template <typename coord_t>
+IMPStopReason IMP(std::vector<BasicRegion<coord_t>>& protoAtoms,
+	std::vector<BasicWasteRegion<coord_t>>& wasteRegions,
+	const std::vector<std::vector<AlignmentRecord *>>& buckets,
+	unsigned int bucketSize, unsigned int minLength, double epsilon,
+	const std::chrono::time_point<std::chrono::high_resolution_clock> start,
+	unsigned int numThreads, unsigned int &iterationCount,
+	unsigned int maxIterations, double convergenceFraction,
+	Checkpoint &checkpoint, Shard &shard, const AlignmentStore &store, Metrics &metrics, AtomMappings *mappings) {
+	
+	auto startIMP = std::chrono::high_resolution_clock::now();
+	resetScratchStats();
+	IMPStopReason reason = IMP_CONVERGED;
+	if (mappings != nullptr) mappings->valid = false;
+	
+	while (true) {
+		if (maxIterations && iterationCount >= maxIterations) {
+			reason = IMP_MAX_ITERATIONS;
+			break;
+		}
+		std::vector<BasicRegion<coord_t>> newRegions;
+		IMPCounters counters;
+		metrics.startIteration();
+		if (newWasteRegionsElsewhere(protoAtoms, wasteRegions, minLength, epsilon, numThreads, shard, store,
+			newRegions, counters)) {}
+		else
+			newWasteRegionsForAtoms(protoAtoms, 0, protoAtoms.size(), wasteRegions, buckets,
+				bucketSize, minLength, epsilon, numThreads, newRegions, counters, mappings);
+		wasteRegions.insert(wasteRegions.end(), newRegions.begin(), newRegions.end());
+		consolidateRegions(wasteRegions, minLength); // join new and old waste regions
+		if (wasteRegions.size() > std::numeric_limits<unsigned int>::max()) // indexed by unsigned int, see AtomMapping
+			throw std::length_error("More than 2^32 waste regions, increase minLength");
+		std::vector<BasicRegion<coord_t>> newAtoms;
+		atomsFromWaste(wasteRegions, newAtoms);
+		metrics.endIteration(iterationCount + 1, counters, wasteRegions.size());
+		if (!areDifferent(protoAtoms, newAtoms)) { // stop if there is no improvement
+			// the atoms and their waste region boundaries are unchanged, so the mappings stay valid
+			if (mappings != nullptr && !shard.isEnabled()) mappings->valid = true;
+			break;
+		}
+		size_t changed = convergenceFraction > 0.0 ? countChanged(protoAtoms, newAtoms) : newAtoms.size();
+		protoAtoms = newAtoms;
+		std::cerr << "INFO: " << wasteRegions.size() << " waste regions after IMP iteration "
+			<< ++iterationCount << ".";
+		shoutTime(start);
+		checkpoint.update(wasteRegions, iterationCount);
+		if (changed < convergenceFraction * newAtoms.size()) { // stop if only few atoms changed
+			std::cerr << "INFO: Only " << changed << " of " << newAtoms.size() << " atoms changed." << std::endl;
+			reason = IMP_CONVERGENCE_FRACTION;
+			break;
+		}
+	}
+	std::cerr << "IMP algorithm done (" << stopReasonName(reason) << ").";
+
+	auto endIMP = std::chrono::high_resolution_clock::now();
+	auto timeIMP = std::chrono::duration_cast<std::chrono::milliseconds>(endIMP - startIMP).count();
+	std::cerr << " Algorithm time: " << timeIMP << " milliseconds.";
+	
+	shoutTime(start);
+	printScratchStats("IMP");
+	return reason;
+}
+
+template <typename coord_t>
+void newWasteRegionsForAtoms(const std::vector<BasicRegion<coord_t>>& protoAtoms, size_t begin, size_t end,
+	const std::vector<BasicWasteRegion<coord_t>>& wasteRegions,
+	const std::vector<std::vector<AlignmentRecord *>>& buckets,
+	unsigned int bucketSize, unsigned int minLength, double epsilon,
+	unsigned int numThreads, std::vector<BasicRegion<coord_t>>& newRegions, IMPCounters& counters,
+	AtomMappings *mappings, unsigned long firstBucket) {
+	unsigned long alnsScanned = 0, alnsCovering = 0, wasteMapped = 0, dpPositions = 0;
+	const bool recordMappings = mappings != nullptr;
+	std::vector<std::pair<size_t, AtomMapping>> found; // mappings tagged with their atom
+	#pragma omp declare reduction (merge : std::vector<BasicRegion<coord_t>> : omp_out.insert(omp_out.end(), omp_in.begin(), omp_in.end()))
+	#pragma omp declare reduction (mergeMappings : std::vector<std::pair<size_t, AtomMapping>> : \
+		omp_out.insert(omp_out.end(), omp_in.begin(), omp_in.end()))
+	#pragma omp parallel for num_threads(numThreads) reduction(merge: newRegions) reduction(mergeMappings: found) \
+		reduction(+: alnsScanned, alnsCovering, wasteMapped, dpPositions)
+	for (size_t i = begin; i < end; i++) { // iterate over all current atoms
+		ScratchScope scratch; // temporary containers of this atom live in the thread's arena
+		const Region atom(protoAtoms[i]); // positions are unsigned long within an atom
+		unsigned long bucketIdx = atom.getMiddlePos() / bucketSize;
+		auto alns = &buckets[bucketIdx - firstBucket]; // get all alignments that contain middlePos
+		scratch_vector<Region> intervals; // waste region set W
+		alnsScanned += alns->size();
+		for (auto aln : *alns) { // iterate over all alignments covering the atom
+			if (aln->tStart > atom.first || aln->tEnd < atom.last) continue; // skip alns that don't cover atom
+			alnsCovering++;
+			Region mappedRegion = mapAtomThroughAln(atom, *aln);
+			auto regionFirst = binSearchRegion(mappedRegion.first, wasteRegions);
+			auto regionLast = binSearchRegion(mappedRegion.last, wasteRegions);
+			if (recordMappings)
+				found.push_back(std::make_pair(i, AtomMapping{aln, mappedRegion.first, mappedRegion.last,
+					regionFirst, regionLast}));
+			for (auto j = regionFirst; j <= regionLast; j++) { // iterate over waste regions in mappedRegion
+				const BasicWasteRegion<coord_t>* currentRegion = &wasteRegions[j];
+				if (mappedRegion.first > currentRegion->last || currentRegion-> first > mappedRegion.last) continue;
+				wasteMapped++;
+				// map waste region back to atom
+				auto inverseRegionFirst = mapBreakpoint(currentRegion->first, *(aln->sym));
+				auto inverseRegionLast = mapBreakpoint(currentRegion->last, *(aln->sym));
+				// skip if inversely mapped region does not overlap atom
+				if ((inverseRegionFirst < atom.first && inverseRegionLast < atom.first)
+					|| (inverseRegionFirst > atom.last && inverseRegionLast > atom.last))
+					continue;
+				// else push region to interval list
+				if (inverseRegionFirst > inverseRegionLast)
+					std::swap(inverseRegionFirst, inverseRegionLast);
+				Region inverselyMappedRegion(inverseRegionFirst, inverseRegionLast);
+				// clip ends to atom
+				if (inverselyMappedRegion.first < atom.first) inverselyMappedRegion.first = atom.first;
+				if (inverselyMappedRegion.last > atom.last) inverselyMappedRegion.last = atom.last;
+				intervals.push_back(inverselyMappedRegion);
+			} // end of iteration over waste in mappedRegion
+		} // end of iteration over alignments containing middlepos
+		// add waste regions at ends of atom
+		intervals.push_back(Region(atom.first, atom.first));
+		intervals.push_back(Region(atom.last, atom.last));
+		std::sort(intervals.begin(), intervals.end()); // sorting before removing duplicates
+		intervals.erase(intervals.begin() + kernels.uniqueRegions(intervals.data(), intervals.size()), intervals.end()); // remove duplicates
+
+		// create waste region set set W_new from W
+		scratch_vector<Region> covering, notCovering, newWasteRegions;
+		partitionCoveringRegion(intervals, minLength, covering, notCovering);
+		dpPositions += createNewWasteRegions(notCovering, covering, epsilon, minLength, atom.first, newWasteRegions);
+		// add W_new to all new regions
+		for (auto &region : newWasteRegions)
+			newRegions.push_back(BasicRegion<coord_t>(region));
+	}
+	if (recordMappings) { // group by atom (counting sort), keeping the bucket order within an atom
+		mappings->offsets.assign(protoAtoms.size() + 1, 0);
+		for (auto &m : found)
+			mappings->offsets[m.first + 1]++;
+		for (size_t i = 1; i < mappings->offsets.size(); i++)
+			mappings->offsets[i] += mappings->offsets[i - 1];
+		std::vector<size_t> next(mappings->offsets.begin(), mappings->offsets.end() - 1);
+		mappings->mappings.resize(found.size());
+		for (auto &m : found)
+			mappings->mappings[next[m.first]++] = m.second;
+	}
+	counters.atoms += end - begin;
+	counters.alnsScanned += alnsScanned;
+	counters.alnsCovering += alnsCovering;
+	counters.wasteMapped += wasteMapped;
+	counters.dpPositions += dpPositions;
+}
+
+void fillBuckets(std::deque<AlignmentRecord *>& alns, unsigned int bucketSize,
+	std::vector<std::vector<AlignmentRecord *>>& result) {
+	unsigned long firstBucket, lastBucket;
+        for (auto bucket : result)
+            bucket.reserve(bucketSize); // preallocate vector of the necessary size
+	for (auto alnPtr : alns) {
+		firstBucket = alnPtr->tStart / bucketSize;
+		lastBucket = alnPtr->tEnd / bucketSize;
+		for (auto i = firstBucket; i <= lastBucket; i++)
+			result[i].push_back(alnPtr);
+	}
+}
+
+void fillBucketsFirstTouch(std::deque<AlignmentRecord *>& alns, unsigned int bucketSize,
+	unsigned int numThreads, std::vector<std::vector<AlignmentRecord *>>& result) {
+	std::vector<unsigned int> counts(result.size(), 0);
+	for (auto alnPtr : alns)
+		for (auto i = alnPtr->tStart / bucketSize; i <= alnPtr->tEnd / bucketSize; i++)
+			counts[i]++;
+	// like the atoms of newWasteRegionsForAtoms, the buckets are split evenly among the threads
+	#pragma omp parallel num_threads(numThreads)
+	{
+		size_t t = omp_get_thread_num(), n = omp_get_num_threads();
+		for (size_t i = result.size() * t / n; i < result.size() * (t + 1) / n; i++)
+			result[i].resize(counts[i]); // allocated and touched by this thread
+	}
+	std::fill(counts.begin(), counts.end(), 0);
+	for (auto alnPtr : alns)
+		for (auto i = alnPtr->tStart / bucketSize; i <= alnPtr->tEnd / bucketSize; i++)
+			result[i][counts[i]++] = alnPtr;
+}
+
+unsigned int binSearch_tStarts(unsigned long x, const AlignmentRecord& aln) {
+	unsigned int result;
+	if (x < aln.tStart) result = 0;
+	else if (x - aln.tStart >= std::numeric_limits<block_local_t>::max()) result = aln.blockCount;
+	else result = kernels.upperBoundBlocks(aln.local_tStarts(), aln.blockCount, x - aln.tStart);
+	if (result == 0) return result;
+	else return result - 1;
+}
+
+unsigned int binSearchRegion(unsigned long x, const std::vector<WasteRegion>& bpList) {
+	unsigned int result = kernels.upperBoundRegions(bpList.data(), bpList.size(), x);
+	if (result == 0) return result;
+	else return result - 1;
+}
+
+unsigned int binSearchRegion(unsigned long x, const std::vector<CompactWasteRegion>& bpList) {
+	unsigned int result = std::upper_bound(bpList.begin(), bpList.end(), x,
+		[](unsigned long x, const CompactWasteRegion &region) { return x < region.first; }) - bpList.begin();
+	if (result == 0) return result;
+	else return result - 1;
+}
+
+unsigned long mapBreakpoint(unsigned long bpPosition, const AlignmentRecord& aln) {
+	auto idx = binSearch_tStarts(bpPosition, aln);
+	unsigned long result;
+	unsigned long dist = (bpPosition >= aln.get_tStarts(idx)) ? bpPosition - aln.get_tStarts(idx) : 0;
+	if (dist > aln.blockSizes[idx]) dist = aln.blockSizes[idx];
+	if (aln.strand == '+')
+		result = aln.get_qStarts(idx) + dist;
+	else
+		result = aln.get_qStarts(idx) - dist;
+	return result;
+}
+
+Region mapAtomThroughAln(const Region& atom, const AlignmentRecord& aln) {
+	auto firstMapped = mapBreakpoint(atom.first, aln);
+	auto lastMapped = mapBreakpoint(atom.last, aln);
+	if (firstMapped <= lastMapped) return Region(firstMapped, lastMapped);
+	else return Region(lastMapped, firstMapped);
+}
+
+void partitionCoveringRegion(const scratch_vector<Region>& input, unsigned int minL,
+	scratch_vector<Region>& covering, scratch_vector<Region>& notCovering) {
+	int minLength = static_cast<signed int>(minL);
+	for (size_t i = 0; i < input.size(); i++) {
+		const Region* currentRegion = &input[i];
+		long lastShortStart, lastLongStart;
+
+		if (notCovering.empty()) lastShortStart = 0 - minLength - 2;
+		else lastShortStart = notCovering.back().first;
+		if (covering.empty()) lastLongStart = 0 - minLength - 2;
+		else lastLongStart = covering.back().first;
+
+		if (lastLongStart >= 0 && static_cast<unsigned long>(lastLongStart) >= currentRegion->first) {
+			while (lastLongStart >= 0 && static_cast<unsigned long>(lastLongStart) >= currentRegion->first) {
+				if (!covering.empty()) covering.pop_back();
+				if (covering.empty()) lastLongStart = 0 - minLength - 2;
+				else lastLongStart = covering.back().first;
+			}
+			covering.push_back(*currentRegion);
+		} else {
+			if (lastShortStart >= 0 && static_cast<unsigned long>(lastShortStart) >= currentRegion->first)
+				covering.push_back(*currentRegion);
+			else notCovering.push_back(*currentRegion);
+		}
+	}
+}
+
+/* Calculates the optimal cost for a new waste region set with waste regions at pos and in closestLeftRegion.
+Best results for each position are stored for dynamic programming. */
+void dpFindOptimal(Region closestLeftRegion, scratch_map<unsigned long, dpPosition>& allPositions,
+	unsigned long pos, double epsilon, unsigned int minLength) {
+	scratch_vector<dpStats> positionCost; // contains min cost for each pos & position which achieved it
+	for (auto l = closestLeftRegion.first; l <= closestLeftRegion.last; l++) { // iterate over P(j,k)
+		if ((pos - l) < minLength) // join waste regions
+			positionCost.push_back(dpStats(allPositions.find(l)->second.cost + pos - l, true, l));
+		else {
+			bool alignedToWaste = false;
+			for (auto i : allPositions.find(l)->second.notCoveringIds)
+				for (auto j : allPositions.find(pos)->second.notCoveringIds)
+					if (i == j) alignedToWaste = true;
+			if (alignedToWaste)  // join waste regions
+				positionCost.push_back(dpStats(allPositions.find(l)->second.cost + pos - l, true, l));
+			else // don't join - create new atom in between
+				positionCost.push_back(dpStats(allPositions.find(l)->second.cost + epsilon, false, l));
+
+			// now check covering regions
+			alignedToWaste = false;
+			for (auto i : allPositions.find(l)->second.coveringIds)
+				for (auto j : allPositions.find(pos)->second.coveringIds)
+					if (i == j) alignedToWaste = true;
+			if (alignedToWaste)
+				positionCost.push_back(dpStats(allPositions.find(l)->second.cost + pos - l, true, l));
+			else
+				positionCost.push_back(dpStats(allPositions.find(l)->second.cost + epsilon, false, l));
+		}
+	}
+	dpStats optimal = *std::min_element(positionCost.rbegin(), positionCost.rend(),
+		[](dpStats a, dpStats b) {return a.cost < b.cost; });
+	dpPosition* toChange = &allPositions.find(pos)->second;
+	toChange->cost = optimal.cost;
+	toChange->dist = optimal.dist;
+	toChange->prev = optimal.prev;
+}
+
+/* After the cost of an optimal solution is computed, the optimal set for that solution
+is created by tracing back the stored positions. The optimal set will be stored in result. */
+void dpTraceBack(scratch_map<unsigned long, dpPosition>& allPositions,
+	unsigned long lastPos, unsigned long atomFirst, scratch_vector<Region>& result) {
+	unsigned long currentPos = allPositions.find(lastPos)->second.prev;
+	dpPosition *posData = &(allPositions.find(currentPos)->second);
+	scratch_vector<bool> tmpRegionBools;
+        bool is_first = true;
+	while (currentPos >= atomFirst) {
+		if (is_first) {
+                        result.push_back(Region(currentPos, currentPos));
+			tmpRegionBools.push_back(posData->dist);
+                        is_first = false;
+                }
+		else {
+                        bool tmpBool = tmpRegionBools.back();
+                        Region *tmpRegion = &result.back();
+			if (tmpBool) {
+				tmpRegion->first = currentPos;
+                                tmpRegionBools[tmpRegionBools.size()-1] = posData->dist;
+			}
+			else {
+                                tmpRegionBools.push_back(posData->dist);
+				result.push_back(Region(currentPos, currentPos));
+			}
+		}
+		if (!currentPos) break; // atom starts at 0
+		currentPos = posData->prev;
+		posData = &(allPositions.find(currentPos)->second);
+	}
+}
+
+unsigned long createNewWasteRegions(const scratch_vector<Region>& notCovering, const scratch_vector<Region>& covering,
+	double epsilon, unsigned int minLength, unsigned long atomStart, scratch_vector<Region>& result) {
+	scratch_set<unsigned long> nonCovPos; // positions in noncovering
+	scratch_map<unsigned long, dpPosition> allPositions; // positions in either vector
+
+	// collect positions of nonCovering intervals
+	for (size_t i = 0; i < notCovering.size(); i++) {
+		const Region* curRegion = &notCovering[i];
+		for (auto pos = curRegion->first; pos <= curRegion->last; pos++) {
+			nonCovPos.insert(pos);
+			allPositions.insert(std::pair<unsigned long, dpPosition>(pos, dpPosition(i))).
+				first->second.notCoveringIds.push_back(i);
+		}
+	}
+	// add positions also contained in covering regions
+	for (size_t i = 0; i < covering.size(); i++) {
+		const Region* curRegion = &covering[i];
+		for (auto pos = curRegion->first; pos <= curRegion->last; pos++)
+			if (allPositions.count(pos))
+				allPositions.find(pos)->second.coveringIds.push_back(i);
+	}
+
+	scratch_set<unsigned int> currentShortIntervals, lastShortIntervals;
+	unsigned int lastFinishedIdx = 0;
+	for (auto pos : nonCovPos) { // iterate over all viable positions i from left to right
+		auto position = allPositions.find(pos);
+		for (auto i : position->second.notCoveringIds)
+			currentShortIntervals.insert(i);
+		if (pos == *(nonCovPos.begin())) continue; // only init for first (leftmost) position
+		// get ID of rightmost region not containing pos but left of pos
+		for (auto previous : lastShortIntervals)
+			if (currentShortIntervals.find(previous) == currentShortIntervals.end()) // not in set
+				lastFinishedIdx = previous;
+		dpFindOptimal(notCovering[lastFinishedIdx], allPositions, pos, epsilon, minLength);
+		lastShortIntervals.swap(currentShortIntervals);
+		currentShortIntervals.clear();
+	}
+	dpTraceBack(allPositions, notCovering.back().last, atomStart, result);
+	return nonCovPos.size();
+}
+
+template <typename coord_t>
+void consolidateRegions(std::vector<BasicWasteRegion<coord_t>> &regions, unsigned int minLength) {
+	std::vector<BasicWasteRegion<coord_t>> tmp(regions);
+	std::sort(tmp.begin(), tmp.end());
+	regions.clear();
+	size_t i = 0;
+	BasicWasteRegion<coord_t> currentRegion = *tmp.begin();
+	while (i < tmp.size()) {
+		if (i + 1 < tmp.size()) {
+			BasicWasteRegion<coord_t> nextRegion = tmp[i + 1];
+			i++;
+			if (nextRegion.first <= currentRegion.last + minLength) {
+				// join regions
+				currentRegion.last = std::max(currentRegion.last, nextRegion.last);
+			} else { // not close enough to join
+				regions.push_back(currentRegion);
+				currentRegion = nextRegion;
+			}
+		} else { // push last element region
+			regions.push_back(currentRegion);
+			i++;
+		}
+	}
+}
+
+template <typename coord_t>
+size_t countChanged(const std::vector<BasicRegion<coord_t>> &first, const std::vector<BasicRegion<coord_t>> &second) {
+	size_t changed = 0, i = 0;
+	for (auto &atom : second) {
+		while (i < first.size() && first[i].first < atom.first) i++;
+		if (i == first.size() || first[i].first != atom.first || first[i].last != atom.last)
+			changed++;
+	}
+	return changed;
+}
+
+template <typename coord_t>
+bool areDifferent(std::vector<BasicRegion<coord_t>> &first, std::vector<BasicRegion<coord_t>> &second) {
+	if (first.size() != second.size()) return true;
+	// if size is equal, compare each elements positions
+	for (size_t i = 0; i < first.size(); i++)
+		if (first[i].first != second[i].first || first[i].last != second[i].last)
+			return true;
+	return false;
+}
+
+// the instantiations for both position types
+#define INSTANTIATE_IMP(coord_t) \
+	template IMPStopReason IMP(std::vector<BasicRegion<coord_t>>&, std::vector<BasicWasteRegion<coord_t>>&, \
+		const std::vector<std::vector<AlignmentRecord *>>&, unsigned int, unsigned int, double, \
+		const std::chrono::time_point<std::chrono::high_resolution_clock>, unsigned int, \
+		unsigned int&, unsigned int, double, Checkpoint&, Shard&, const AlignmentStore&, Metrics&, AtomMappings*); \
+	template void newWasteRegionsForAtoms(const std::vector<BasicRegion<coord_t>>&, size_t, size_t, \
+		const std::vector<BasicWasteRegion<coord_t>>&, const std::vector<std::vector<AlignmentRecord *>>&, \
+		unsigned int, unsigned int, double, unsigned int, std::vector<BasicRegion<coord_t>>&, IMPCounters&, \
+		AtomMappings*, unsigned long); \
+	template void consolidateRegions(std::vector<BasicWasteRegion<coord_t>>&, unsigned int); \
+	template size_t countChanged(const std::vector<BasicRegion<coord_t>>&, const std::vector<BasicRegion<coord_t>>&); \
+	template bool areDifferent(std::vector<BasicRegion<coord_t>>&, std::vector<BasicRegion<coord_t>>&);
+INSTANTIATE_IMP(unsigned long)
+INSTANTIATE_IMP(unsigned int)
@@ -1,52 +1,117 @@
-#pragma once
-
-#include <chrono>
-#include <deque>
-#include "Breakpoints.h"
-#include "AlignmentRecord.h"
-
-/* Runs the IMP algorithm */
-void IMP(std::vector<Region>& , std::vector<WasteRegion>&,
-	const std::vector<std::vector<AlignmentRecord *>>&,
-	unsigned int, unsigned int, double,
-	const std::chrono::time_point<std::chrono::high_resolution_clock>,
-	unsigned int);
-
-/* Organizes AlignmentRecords into buckets with regards to their target positions.
-A bucket represents a number of sequence positions, said number being equal to bucketSize.
-This makes finding alignments covering a certain positions much faster. */
-void fillBuckets(std::deque<AlignmentRecord *>& alns, unsigned int bucketSize,
-	std::vector<std::vector<AlignmentRecord *>>& result);
-
-/* Returns index of the last element in tStarts that is <= x.
-If all elements in tStarts are > x, result is 0. Expects tStarts to be sorted ascending. */
-unsigned int binSearch_tStarts(unsigned long x, const AlignmentRecord& aln);
-
-/* Returns index of the last element in bpList whose starting position is <= x.
-If there are none, result is 0. Expects bpList to be sorted ascending. */
-unsigned int binSearchRegion(unsigned long x, const std::vector<WasteRegion>& bpList);
-
-/* Maps input breakpoint from alignment query to alignment target. */
-unsigned int mapBreakpoint(unsigned long bpPosition, const AlignmentRecord& aln);
-
-/* Maps an atom to the target of an alignment covering that atom.
-This means it returns a region that is aligned to the input atom. */
-Region mapAtomThroughAln(const Region& atom, const AlignmentRecord& aln);
-
-/* Paritions input regions in two set, one containing the regions that cover other regions,
-the other one containing the ones that don't.
-Input must be sorted according to operator < in Region. */
-void partitionCoveringRegion(const std::vector<Region>& input, unsigned int minLength,
-	std::vector<Region>& covering, std::vector<Region>& notCovering);
-
-/* Creates a new optimal set of waste region from notCovering and covering
-via dynamic programming and stores it in result. */
-void createNewWasteRegions(const std::vector<Region>& notCovering, const std::vector<Region>& covering,
-	double epsilon, unsigned int minLength, unsigned long atomStart, std::vector<Region>& result);
-
-/* Joins newly added waste regions with older ones. */
-void consolidateRegions(std::vector<WasteRegion> &regions, unsigned int minLength);
-
-/* Checks if both vectors contain the same elements.
-Expects both input vectors to be sorted in the same way, e.g. by atom length. */
-bool areDifferent(std::vector<Region> &first, std::vector<Region> &second);
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include "Breakpoints.h"
+#include "AlignmentRecord.h"
+#include "Scratch.h"
+#include "Checkpoint.h"
+#include "Shard.h"
+#include "AlignmentStore.h"
+#include "Metrics.h"
+
+/* An alignment covering an atom, with the atom mapped through it and the range of waste regions it maps to.
+Positions are unsigned long, waste region indices unsigned int, IMP stops if there are more regions. */
+struct AtomMapping {
+	const AlignmentRecord *aln;
+	unsigned long mappedFirst;
+	unsigned long mappedLast;
+	unsigned int regionFirst;
+	unsigned int regionLast;
+};
+
+/* The mappings of all atoms found in the last IMP iteration, grouped by atom:
+the mappings of atom i are mappings[offsets[i]..offsets[i+1]).
+Only valid if IMP stopped because the atoms did not change, then classify can reuse them. */
+struct AtomMappings {
+	bool valid = false;
+	std::vector<size_t> offsets;
+	std::vector<AtomMapping> mappings;
+};
+
+/* Criterion that ended the IMP iterations */
+enum IMPStopReason { IMP_CONVERGED, IMP_MAX_ITERATIONS, IMP_CONVERGENCE_FRACTION };
+
+/* Returns a short name of reason, as written to the output header */
+const char *stopReasonName(IMPStopReason reason);
+
+/* Runs the IMP algorithm, starting with iteration number iterationCount (updated to the last iteration).
+It stops when the atoms don't change anymore, after maxIterations iterations (0: unbounded),
+or when less than convergenceFraction of the atoms changed in an iteration (0: exact).
+The state after each iteration is handed to checkpoint, its timing and counters to metrics.
+If shard is enabled, the new waste regions of each iteration are computed by worker processes.
+If store is enabled, the alignments are read from it window by window instead of from the buckets.
+If mappings is not null, the atom mappings of the last iteration are stored in it.
+Instantiated for unsigned long and unsigned int (compact) positions, shard and store need unsigned long. */
+template <typename coord_t>
+IMPStopReason IMP(std::vector<BasicRegion<coord_t>>& , std::vector<BasicWasteRegion<coord_t>>&,
+	const std::vector<std::vector<AlignmentRecord *>>&,
+	unsigned int, unsigned int, double,
+	const std::chrono::time_point<std::chrono::high_resolution_clock>,
+	unsigned int, unsigned int&, unsigned int, double, Checkpoint&, Shard&, const AlignmentStore&, Metrics&,
+	AtomMappings*);
+
+/* Computes the new waste regions (set W_new) of the atoms protoAtoms[begin..end)
+and appends them to newRegions. This is the body of one IMP iteration, its work is added to counters.
+If mappings is not null, the covering alignments found for each atom are stored in it.
+buckets[0] is bucket firstBucket, so a window of the buckets covering the atoms suffices. */
+template <typename coord_t>
+void newWasteRegionsForAtoms(const std::vector<BasicRegion<coord_t>>& protoAtoms, size_t begin, size_t end,
+	const std::vector<BasicWasteRegion<coord_t>>& wasteRegions,
+	const std::vector<std::vector<AlignmentRecord *>>& buckets,
+	unsigned int bucketSize, unsigned int minLength, double epsilon,
+	unsigned int numThreads, std::vector<BasicRegion<coord_t>>& newRegions, IMPCounters& counters,
+	AtomMappings *mappings, unsigned long firstBucket = 0);
+
+/* Organizes AlignmentRecords into buckets with regards to their target positions.
+A bucket represents a number of sequence positions, said number being equal to bucketSize.
+This makes finding alignments covering a certain positions much faster. */
+void fillBuckets(std::deque<AlignmentRecord *>& alns, unsigned int bucketSize,
+	std::vector<std::vector<AlignmentRecord *>>& result);
+
+/* Like fillBuckets, but each bucket vector is allocated with its exact size and first touched by the thread
+that reads it in the IMP iterations: the buckets are split among numThreads threads like the atoms by the
+static OpenMP schedule, which roughly matches when the atoms are evenly spread. With pinned threads the buckets lie on the node reading them. */
+void fillBucketsFirstTouch(std::deque<AlignmentRecord *>& alns, unsigned int bucketSize,
+	unsigned int numThreads, std::vector<std::vector<AlignmentRecord *>>& result);
+
+/* Returns index of the last element in tStarts that is <= x.
+If all elements in tStarts are > x, result is 0. Expects tStarts to be sorted ascending. */
+unsigned int binSearch_tStarts(unsigned long x, const AlignmentRecord& aln);
+
+/* Returns index of the last element in bpList whose starting position is <= x.
+If there are none, result is 0. Expects bpList to be sorted ascending. */
+unsigned int binSearchRegion(unsigned long x, const std::vector<WasteRegion>& bpList);
+unsigned int binSearchRegion(unsigned long x, const std::vector<CompactWasteRegion>& bpList);
+
+/* Maps input breakpoint from alignment query to alignment target. */
+unsigned long mapBreakpoint(unsigned long bpPosition, const AlignmentRecord& aln);
+
+/* Maps an atom to the target of an alignment covering that atom.
+This means it returns a region that is aligned to the input atom. */
+Region mapAtomThroughAln(const Region& atom, const AlignmentRecord& aln);
+
+/* Paritions input regions in two set, one containing the regions that cover other regions,
+the other one containing the ones that don't.
+Input must be sorted according to operator < in Region. */
+void partitionCoveringRegion(const scratch_vector<Region>& input, unsigned int minLength,
+	scratch_vector<Region>& covering, scratch_vector<Region>& notCovering);
+
+/* Creates a new optimal set of waste region from notCovering and covering
+via dynamic programming and stores it in result. Returns the number of positions evaluated. */
+unsigned long createNewWasteRegions(const scratch_vector<Region>& notCovering, const scratch_vector<Region>& covering,
+	double epsilon, unsigned int minLength, unsigned long atomStart, scratch_vector<Region>& result);
+
+/* Joins newly added waste regions with older ones. */
+template <typename coord_t>
+void consolidateRegions(std::vector<BasicWasteRegion<coord_t>> &regions, unsigned int minLength);
+
+/* Returns the number of atoms in second that are not in first.
+Expects both input vectors to be sorted by position, as created by atomsFromWaste. */
+template <typename coord_t>
+size_t countChanged(const std::vector<BasicRegion<coord_t>> &first, const std::vector<BasicRegion<coord_t>> &second);
+
+/* Checks if both vectors contain the same elements.
+Expects both input vectors to be sorted in the same way, e.g. by atom length. */
+template <typename coord_t>
+bool areDifferent(std::vector<BasicRegion<coord_t>> &first, std::vector<BasicRegion<coord_t>> &second);
@@ -1,333 +1,976 @@
-#include <iostream>
-#include <fstream>
-#include <stdexcept>
-#include <algorithm>
-
-#include "InputParser.h"
-#include "AlignmentRecord.h"
-#include "Util.h"
-
-InputParser::InputParser() {
-    // Default values
-    maxGapLength = 13;
-    minAlnLength = 13;
-    minLength = 250;
-    bucketSize = 1000;
-    numThreads = 1;
-    minAlnIdentity = 0.8f;
-    printZeroLines = false;
-    inputNotPsl = false;
-}
-
-void InputParser::parseCmdArgs(int argc, char** &argv) {
-	if (argc <= 1) {
-		std::cerr << "Usage: atomizer <psl file(s) | list files(s)> [options]\n\n"
-                        << "Multiple input psl files (or list files, see --inputNotPsl) may be given,\n"
-                        << "but always as first arguments.\n"
-			<< "Optional arguments are given after their descriptor. The descriptor is NOT case-sensitive. \n"
-			<< "If an optional argument is not given, the default value will be used.\n"
-			<< "--minLength <minLength>: The minimum length an atom must have (defualt: 250).\n"
-			<< "--minIdent <minIdent>: Minimum identity an alignment must have to be considered,\n"
-			<< "  alignments with lower identity will be skipped (default: 80).\n"
-			<< "--maxGap <maxGap>: The maximum gap length inside of an alignment. If this length is\n"
-			<< "  exceeded, the alignment will be split in two (default: 13).\n"
-			<< "--minAlnLength <minAlnLength>: The minimal length an alignment must have to be considered.\n"
-			<< "  Shorter alignments are ignored (default: 13).\n"
-			<< "--bucketSize <size>: Size of buckets used to find covering alignments,\n"
-			<< "  increase if you run out of memory (default: 1000).\n"
-			<< "--numThreads <num>: Number of threads to run IMP algorithm (default: 1).\n"
-                        << "--printZeroLines: Print line numbers with blocks of size 0 (default: no).\n"
-                        << "--inputNotPsl: Each input file is not a psl file. Instead of data, the given files contain\n"
-                        << "  the path of one psl file per line, which actually contain the data to be read (default: no)."
-			<< std::endl;
-		exit(EXIT_SUCCESS);
-	}
-	int mandatoryArgs = 0;
-	for (int i = 1; i < argc; i++) {
-		std::string arg = argv[i];
-		if (arg.substr(0, 2) != "--") mandatoryArgs++;
-		else break;
-	}
-	if (mandatoryArgs < 1) {
-		std::cerr << "Insufficient arguments, call without arguments to get instructions." << std::endl;
-		exit(EXIT_FAILURE);
-	}
-        for (int i = 1; i <= mandatoryArgs; i++)
-            pslPaths.push_back(argv[i]);
-	for (int i = mandatoryArgs + 1; i < argc; i++) {
-		std::string arg = argv[i];
-		std::transform(arg.begin(), arg.end(), arg.begin(), tolower);
-		try {
-			if (arg == "--minlength") minLength = std::stoul(argv[++i]);
-			else if (arg == "--minident") minAlnIdentity = std::stoul(argv[++i]) / 100.0f;
-			else if (arg == "--maxgap") maxGapLength = std::stoul(argv[++i]);
-			else if (arg == "--minalnlength") minAlnLength = std::stoul(argv[++i]);
-			else if (arg == "--bucketsize") bucketSize = std::stoul(argv[++i]);
-			else if (arg == "--numthreads") numThreads = std::stoul(argv[++i]);
-                        else if (arg == "--printzerolines") printZeroLines = true;
-                        else if (arg == "--inputnotpsl") inputNotPsl = true;
-			else {
-				std::cerr << "Unknown argument " << arg << ". Call without arguments for instructions." << std::endl;
-				exit(EXIT_FAILURE);
-			}
-		}
-		catch (std::invalid_argument) {
-			std::cerr << "The value for argument " << arg << " could not be parsed." << std::endl;
-			exit(EXIT_FAILURE);
-		}
-	}
-        if (inputNotPsl) // in this case, pslPaths currently contains the files from which we have to read the actual paths
-            readPslPaths(); 
-}
-
-void InputParser::getCmdLineArgs(std::vector<std::string> &pslPaths,
-        unsigned int &minLength, unsigned int &maxGapLength, unsigned int &minAlnLength,
-        float &minAlnIdentity, unsigned int &bucketSize, unsigned int &numThreads) {
-    
-    pslPaths = this->pslPaths;
-    minLength = this->minLength;
-    maxGapLength = this->maxGapLength;
-    minAlnLength = this->minAlnLength;
-    minAlnIdentity = this->minAlnIdentity;
-    bucketSize = this->bucketSize;
-    numThreads = this->numThreads;
-}
-
-void InputParser::getCmdLineArgs(unsigned int &minLength, unsigned int &maxGapLength,
-        unsigned int &minAlnLength, float &minAlnIdentity, unsigned int &bucketSize,
-        unsigned int &numThreads) {
-    
-    minLength = this->minLength;
-    maxGapLength = this->maxGapLength;
-    minAlnLength = this->minAlnLength;
-    minAlnIdentity = this->minAlnIdentity;
-    bucketSize = this->bucketSize;
-    numThreads = this->numThreads;
-}
-
-/* Parses a single psl line to alignment records (original and reverse,
- * sometimes split) and add them to records vector, returns the number of
- * records added */
-unsigned long InputParser::recordsFromPsl(std::deque<AlignmentRecord *>& records,
-        std::map<std::string, unsigned long>& speciesStart) {
-    
-        unsigned int orig_size = 0; // records size before adding new records
-        pos = 0; // position in line
-        
-        { // skip low quality alignments
-            unsigned int matches = getIntField();
-            unsigned int mismatches = getIntField();
-            unsigned int repmatches = getIntField();
-            matches += repmatches;
-            if (matches == 0) return 0;
-            unsigned int all = matches + mismatches;
-            if (static_cast<float>(matches) / static_cast<float>(all) < minAlnIdentity) return 0;    
-            // Comments from original parser:
-            /* removed these filters for now - filter input psl by hand instead when needed
-             * if (curRec.tStart > curRec.qStart) continue; // only one version of symmetric alignments 
-             * if (curRec.tStart == curRec.qStart && curRec.tEnd == curRec.qEnd)
-             *	continue; // skip alignments that align a region to itself*/
-        }
-        
-        skipFields(5);
-        
-        // fields variables, in the order they appear
-        const char strand = line[pos++];
-        ++pos; // we should be at \t now, move past it
-        
-        const std::string qName = getStringField();
-        const unsigned long qSize = getLongField();
-        updateSpeciesStart(speciesStart, qName, qSize); // check if sequence is in the map, if not, add it
-        const unsigned long qOffset = speciesStart.find(qName)->second; // offset positions for concatenated sequence
-        const unsigned long qStart = getLongField() + qOffset;
-        const unsigned long qEnd = getLongField() + qOffset;
-        
-        const std::string tName = getStringField();
-        const unsigned long tSize = getLongField();
-        updateSpeciesStart(speciesStart, tName, tSize);
-        const unsigned long tOffset = speciesStart.find(tName)->second;
-        const unsigned long tStart = getLongField() + tOffset;
-        const unsigned long tEnd = getLongField() + tOffset;
-        
-        unsigned int blockCount = getIntField();
-        
-        std::vector<unsigned int> blockSizes = getIntArrayField(blockCount);
-        std::vector<unsigned long> qStarts = getLongArrayField(blockCount);
-        std::vector<unsigned long> tStarts = getLongArrayField(blockCount);
-        
-        removeZeroBlocks(blockCount, blockSizes, qStarts, tStarts);
-        
-	// shift start positions by offset, if on reverse strand (only query) recompute w.r.t. starts to start of sequence
-	if (strand == '+')
-            for (auto i = qStarts.begin(); i != qStarts.end(); i++)
-                *i += qOffset;
-	else
-            for (auto i = qStarts.begin(); i != qStarts.end(); i++)
-                *i = qSize - *i + qOffset;
-	for (auto i = tStarts.begin(); i != tStarts.end(); i++)
-            *i += tOffset;
-        
-        // Splits alignment in parts if it contains gaps longer than maxGapLength,
-        // adds to results only if split parts are longer than minAlnLength
-	unsigned int start = 0, length, end;
-	for (end = 0; end < blockCount - 1; end++)	
-            if (tStarts[end + 1] - (tStarts[end] + blockSizes[end]) > maxGapLength
-                    || (strand == '+' && qStarts[end + 1] - (qStarts[end] + blockSizes[end]) > maxGapLength)
-                    || (strand == '-' && qStarts[end] - (qStarts[end + 1] + blockSizes[end]) > maxGapLength)) {
-                length = (tStarts[end] + blockSizes[end]) - tStarts[start];
-                if (length > minAlnLength)
-                    setupSymAndAdd(records, new AlignmentRecord(strand, qStart, qEnd, tStart, tEnd, end-start+1, blockSizes, qStarts, tStarts, start));
-                start = end + 1;
-            }
-	length = (tStarts[end] + blockSizes[end]) - tStarts[start];
-	if (length > minAlnLength)
-            setupSymAndAdd(records, new AlignmentRecord(strand, qStart, qEnd, tStart, tEnd, end-start+1, blockSizes, qStarts, tStarts, start));
-        
-        return records.size() - orig_size;
-}
-
-void InputParser::parsePsl(std::map<std::string, unsigned long>& speciesStart,
-	std::deque<AlignmentRecord *>& result) {
-    
-        line = new char[MAX_LINE]; // I'm not sure if it is a good idea to allocate this big block in the stack
-        zeroBlockLines.reserve(1024);
-        int filen = 1;
-                
-	std::ifstream pslFile;
-        for (auto psl : pslPaths) {
-            std::cerr << "Reading " << psl << " (" << filen++ << "/" << pslPaths.size() << ")... ";
-            pslFile.open(psl);
-            if (pslFile.is_open()) {
-                    line_num = 0;
-                    while (!pslFile.getline(line, MAX_LINE).eof()) {
-                            ++line_num;
-                            if (line[0] == '#' || line[0] == '\0') continue; // skip comments and empty lines
-                            
-                            recordsFromPsl(result, speciesStart);
-                    }
-                    pslFile.close();
-                    std::cerr << "Done." << std::endl;
-                    printZeroBlockInfo();
-                    zeroBlockLines.clear();
-            }
-            else {
-                    std::cerr << "ERROR: psl file could not be opened: " << psl << std::endl;
-                    exit(EXIT_FAILURE);
-            }
-        }
-        delete[] line;
-}
-
-void InputParser::getMaxBlockSizeAndLocalStart(unsigned long &max_bsize, unsigned long &max_start) {
-        max_bsize = 0;
-        max_start = 0;
-        line = new char[MAX_LINE]; // I'm not sure if it is a good idea to allocate this big block in the stack
-        
-        std::map<std::string, unsigned long> speciesStarts; // maps species name to their starting position in concatenated string
-        speciesStarts = { {"$", 0} };
-        
-        std::deque<AlignmentRecord *> records;
-        
-        std::vector<std::string> dontFit;
-        dontFit.reserve(1024);
-        unsigned long last_size = 0;
-        int filen = 1;
-        
-	std::ifstream pslFile;
-        for (auto psl : pslPaths) {
-            std::cout << "Reading " << psl << " (" << filen++ << "/" << pslPaths.size() << ")... ";
-            pslFile.open(psl);
-            if (pslFile.is_open()) {
-                    line_num = 0;
-                    while (!pslFile.getline(line, MAX_LINE).eof()) {
-                            ++line_num;
-                            if (line[0] == '#' || line[0] == '\0') continue; // skip comments and empty lines
-                            
-                            try {
-                                recordsFromPsl(records, speciesStarts);
-                            } catch (std::range_error& e) { 
-                                dontFit.push_back(std::string("Input line ") + std::to_string(line_num) + ": " + std::string(e.what()));
-                            }
-                            
-                            for (auto curRec : records) {
-                                for (auto size = curRec->begin_blockSizes(); size != curRec->end_blockSizes(); size++)
-                                    if (*size > max_bsize)
-                                        max_bsize = *size;
-                                for (auto start = curRec->begin_qStarts(); start != curRec->end_qStarts(); start++)
-                                    if (*start - curRec->qStart > max_bsize)
-                                        max_start = *start - curRec->qStart;
-                                for (auto start = curRec->begin_tStarts(); start != curRec->end_tStarts(); start++)
-                                    if (*start - curRec->tStart > max_bsize)
-                                        max_start = *start - curRec->tStart;
-                                delete curRec;
-                            }
-                            
-                            records.clear();
-                    }
-                    pslFile.close();
-                    std::cout << "Done." << std::endl;
-                    unsigned long newEntries = dontFit.size() - last_size;
-                    if (newEntries > 0) {
-                        std::cout << "\t" << newEntries << " lines have values that don't fit in <" << sizeof(block_local_t) << " bytes>" << ", the first ones for each line are:" << std::endl;
-                        for (auto msg = dontFit.end() - newEntries; msg != dontFit.end(); ++msg)
-                            std::cout << "\t" << *msg << std::endl;
-                    }
-                    last_size = dontFit.size();
-            }
-            else {
-                    std::cerr << "ERROR: psl file \"" << psl <<"\" could not be opened!" << std::endl;
-                    exit(EXIT_FAILURE);
-            }
-        }
-        std::cerr << dontFit.size() << " lines with values that don't fit in <" << sizeof(block_local_t) << " bytes>" << std::endl;
-        delete[] line;
-}
-
-void InputParser::printZeroBlockInfo(void) {
-    if (zeroBlockLines.size() == 0)
-        return;
-    
-    std::cerr << "\tBlocks of size 0 found and removed in " << zeroBlockLines.size() << " alignments";
-    if (!printZeroLines) {
-        std::cerr << std::endl;
-        return;
-    }
-    
-    std::cerr << ", lines ";
-    bool first = true;
-    for (auto l : zeroBlockLines)
-        if (first) {
-            std::cerr << l;
-            first = false;
-        }
-        else
-            std::cerr << ", " << l;
-    std::cerr << std::endl;
-}
-
-void InputParser::readPslPaths(void) {
-        line = new char[MAX_LINE]; // I'm not sure if it is a good idea to allocate this big block in the stack
-        zeroBlockLines.reserve(1024);
-        std::vector<std::string> listFilesPaths = pslPaths;
-        pslPaths.clear();
-        
-	std::ifstream pathsFile;
-        for (auto psl : listFilesPaths) {
-            pathsFile.open(psl);
-            if (pathsFile.is_open()) {
-                    line_num = 0;
-                    while (!pathsFile.getline(line, MAX_LINE).eof()) {
-                            ++line_num;
-                            if (line[0] == '\0') continue; // skip comments and empty lines
-                            
-                            pslPaths.push_back(line);
-                    }
-                    pathsFile.close();
-            }
-            else {
-                    std::cerr << "ERROR: list file could not be opened: " << psl << std::endl;
-                    exit(EXIT_FAILURE);
-            }
-        }
-        delete[] line;   
-}
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include "InputParser.h"
+#include "AlignmentRecord.h"
+#include "Util.h"
+#include "Shard.h"
+
+/* Parses a memory size in MB or with a suffix K, M, G or T, throws std::invalid_argument otherwise */
+static unsigned long parseMemorySize(const std::string &size) {
+    size_t end;
+    unsigned long value = std::stoul(size, &end);
+    std::string suffix = size.substr(end);
+    if (suffix.empty() || suffix == "M" || suffix == "m") return value << 20;
+    if (suffix == "K" || suffix == "k") return value << 10;
+    if (suffix == "G" || suffix == "g") return value << 30;
+    if (suffix == "T" || suffix == "t") return value << 40;
+    throw std::invalid_argument(size);
+}
+
+InputParser::InputParser() {
+    // Default values
+    maxGapLength = 13;
+    minAlnLength = 13;
+    minLength = 250;
+    bucketSize = 1000;
+    numThreads = 1;
+    minAlnIdentity = 0.8f;
+    line_num = 0;
+    lineLength = 0;
+    printZeroLines = false;
+    inputNotPsl = false;
+    checkpointEvery = 1;
+    checkpointMinutes = 0;
+    resume = false;
+    numShards = 0;
+    shardWorker = false;
+    shardIdx = 0;
+    spawnShards = false;
+    shardTimeout = Shard::DEFAULT_TIMEOUT_SECONDS;
+    scratchArena = true;
+    maxIterations = 0;
+    convergenceFraction = 0.0f;
+    compactCoordinates = true;
+    numa = false;
+    hugePages = false;
+    reuseMappings = false;
+    memReport = false;
+    kernelVariant = "auto";
+    maxMemory = 0;
+    storeDir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    outputFormat = "tsv";
+    serveWorkers = 1;
+    sweep = false;
+}
+
+void InputParser::parseCmdArgs(int argc, char** &argv) {
+	if (argc <= 1) {
+		std::cerr << "Usage: atomizer <psl file(s) | list files(s)> [options]\n\n"
+                        << "Multiple input psl files (or list files, see --inputNotPsl) may be given,\n"
+                        << "but always as first arguments.\n"
+			<< "Optional arguments are given after their descriptor. The descriptor is NOT case-sensitive. \n"
+			<< "If an optional argument is not given, the default value will be used.\n"
+			<< "--minLength <minLength>: The minimum length an atom must have (defualt: 250).\n"
+			<< "--minIdent <minIdent>: Minimum identity an alignment must have to be considered,\n"
+			<< "  alignments with lower identity will be skipped (default: 80).\n"
+			<< "--maxGap <maxGap>: The maximum gap length inside of an alignment. If this length is\n"
+			<< "  exceeded, the alignment will be split in two (default: 13).\n"
+			<< "--minAlnLength <minAlnLength>: The minimal length an alignment must have to be considered.\n"
+			<< "  Shorter alignments are ignored (default: 13).\n"
+			<< "--bucketSize <size>: Size of buckets used to find covering alignments,\n"
+			<< "  increase if you run out of memory (default: 1000).\n"
+			<< "--numThreads <num>: Number of threads to run IMP algorithm (default: 1).\n"
+			<< "-o <file>, --output <file>: Write the result to <file> instead of STDOUT.\n"
+			<< "--outputFormat <tsv|binary|compressed>: Write the result as tab separated table, or in the\n"
+			<< "  binary format of Segmentation.h (compressed: with varint coded atoms), which needs -o.\n"
+			<< "  segToTsv converts binary results back to the table (default: tsv).\n"
+			<< "--cacheDir <dir>: Look up the result in <dir> by a hash of the input file contents and the\n"
+			<< "  parameters and write it without computing on a hit, store it there on a miss. The directory\n"
+			<< "  may be shared by concurrent runs (default: no).\n"
+			<< "--maxIterations <num>: Stop the IMP algorithm after <num> iterations, 0 for no limit (default: 0).\n"
+			<< "--convergenceFraction <frac>: Stop the IMP algorithm when less than this fraction of the atoms\n"
+			<< "  changed in an iteration, 0 to iterate until no atom changes (default: 0).\n"
+                        << "--printZeroLines: Print line numbers with blocks of size 0 (default: no).\n"
+                        << "--inputNotPsl: Each input file is not a psl file. Instead of data, the given files contain\n"
+                        << "  the path of one psl file per line, which actually contain the data to be read (default: no).\n"
+                        << "--checkpoint <dir>: Write the state of the IMP algorithm to <dir> during the run (default: no).\n"
+                        << "--checkpointEvery <num>: Write a checkpoint every <num> IMP iterations, 0 to disable (default: 1).\n"
+                        << "--checkpointMinutes <num>: Write a checkpoint if <num> minutes passed since the last one,\n"
+                        << "  0 to disable (default: 0).\n"
+                        << "--resume: Resume from the checkpoint in the --checkpoint directory if it matches\n"
+                        << "  the input files and parameters (default: no).\n"
+                        << "--shards <num>: Split each IMP iteration into <num> ranges of atoms that are computed by\n"
+                        << "  separate worker processes, exchanging data through files in --shardDir (default: 0, off).\n"
+                        << "--shardDir <dir>: Directory shared by the coordinator and the workers, e.g. on a shared\n"
+                        << "  filesystem. Use a separate directory for each run.\n"
+                        << "--shardWorker <k>: Run as worker for range k (0 to --shards - 1) of a coordinator using\n"
+                        << "  the same --shardDir, input files and parameters. Start the coordinator first, it removes\n"
+                        << "  the files of previous runs from --shardDir.\n"
+                        << "--spawnShards: The coordinator starts the --shards workers on this host itself and stops\n"
+                        << "  at once if one of them fails (default: no).\n"
+                        << "--shardTimeout <seconds>: The coordinator and the workers stop with an error if the other\n"
+                        << "  side has shown no sign of life for <seconds>, 0 to wait forever (default: 600).\n"
+                        << "--noScratchArena: Allocate temporary containers of the IMP algorithm from the global\n"
+                        << "  allocator instead of per-thread arenas, to compare allocator statistics (default: no).\n"
+                        << "--noCompactCoordinates: Keep positions in 8 bytes even if the concatenated sequence is\n"
+                        << "  shorter than 4 Gbp, where breakpoints and waste regions use 4 bytes (default: no).\n"
+                        << "--numa: Interleave the alignments and waste regions over the NUMA nodes, pin the threads\n"
+                        << "  and allocate each bucket on the node of the thread that reads it (default: no).\n"
+                        << "--hugePages: Back the large arrays with transparent huge pages (default: no).\n"
+                        << "--maxMemory <size>: Out-of-core mode for alignment sets larger than RAM: spill the alignments\n"
+                        << "  to a disk store grouped by sequence windows and process the windows in batches that keep\n"
+                        << "  the memory below <size> (MB, or with suffix K, M, G or T) (default: no).\n"
+                        << "--storeDir <dir>: Directory for the alignment store of --maxMemory (default: $TMPDIR or /tmp).\n"
+                        << "--kernels <variant>: Use the scalar, avx2 or avx512 variant of the parsing and search\n"
+                        << "  kernels instead of the best one the CPU supports, for testing and benchmarking (default: auto).\n"
+                        << "--reuseMappings: Keep the alignments covering each atom found in the IMP iterations\n"
+                        << "  and reuse those of the last one for classification, trading memory for time (default: no).\n"
+                        << "--metrics <file>: Write wall and CPU time of each phase and IMP iteration, per iteration\n"
+                        << "  work counters and the peak RSS to <file> as JSON (default: no).\n"
+                        << "--memReport: Print the bytes held by the records, block arrays, buckets, waste regions, atoms\n"
+                        << "  and classification graph after each phase, and the peak RSS, to stderr (default: no).\n"
+                        << "--serve <socket>: Load the alignments once and answer requests on the unix socket <socket>\n"
+                        << "  until a shutdown request, see Server.h for the protocol. --minIdent is the lowest identity\n"
+                        << "  requests may ask for, --minLength their default (default: no).\n"
+                        << "--serveWorkers <num>: Number of requests computed at the same time in --serve mode,\n"
+                        << "  each with --numThreads / <num> threads (default: 1).\n"
+                        << "--sweep minLength=<a,b,...> minIdent=<c,d,...>: Parse the input once at the lowest minIdent and\n"
+                        << "  run every combination, writing <output>.minLength<a>.minIdent<c>.tsv (.seg for binary formats)\n"
+                        << "  for -o <output>. A missing list uses --minLength or --minIdent (default: no)."
+			<< std::endl;
+		exit(EXIT_SUCCESS);
+	}
+	int mandatoryArgs = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.substr(0, 1) != "-") mandatoryArgs++;
+		else break;
+	}
+	if (mandatoryArgs < 1) {
+		std::cerr << "Insufficient arguments, call without arguments to get instructions." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+        for (int i = 1; i <= mandatoryArgs; i++)
+            pslPaths.push_back(argv[i]);
+        cmdArgs.assign(argv, argv + argc);
+        pslPathArgs = mandatoryArgs;
+	for (int i = mandatoryArgs + 1; i < argc; i++) {
+		std::string arg = argv[i];
+		std::transform(arg.begin(), arg.end(), arg.begin(), tolower);
+		try {
+			if (arg == "--minlength") minLength = std::stoul(argv[++i]);
+			else if (arg == "--minident") minAlnIdentity = std::stoul(argv[++i]) / 100.0f;
+			else if (arg == "--maxgap") maxGapLength = std::stoul(argv[++i]);
+			else if (arg == "--minalnlength") minAlnLength = std::stoul(argv[++i]);
+			else if (arg == "--bucketsize") bucketSize = std::stoul(argv[++i]);
+			else if (arg == "--numthreads") numThreads = std::stoul(argv[++i]);
+			else if (arg == "-o" || arg == "--output") outputPath = argv[++i];
+			else if (arg == "--outputformat") outputFormat = argv[++i];
+			else if (arg == "--cachedir") cacheDir = argv[++i];
+			else if (arg == "--maxiterations") maxIterations = std::stoul(argv[++i]);
+			else if (arg == "--convergencefraction") convergenceFraction = std::stof(argv[++i]);
+                        else if (arg == "--printzerolines") printZeroLines = true;
+                        else if (arg == "--inputnotpsl") inputNotPsl = true;
+                        else if (arg == "--checkpoint") checkpointDir = argv[++i];
+                        else if (arg == "--checkpointevery") checkpointEvery = std::stoul(argv[++i]);
+                        else if (arg == "--checkpointminutes") checkpointMinutes = std::stoul(argv[++i]);
+                        else if (arg == "--resume") resume = true;
+                        else if (arg == "--noscratcharena") scratchArena = false;
+                        else if (arg == "--nocompactcoordinates") compactCoordinates = false;
+                        else if (arg == "--numa") numa = true;
+                        else if (arg == "--hugepages") hugePages = true;
+                        else if (arg == "--kernels") kernelVariant = argv[++i];
+                        else if (arg == "--maxmemory") maxMemory = parseMemorySize(argv[++i]);
+                        else if (arg == "--storedir") storeDir = argv[++i];
+                        else if (arg == "--metrics") metricsPath = argv[++i];
+                        else if (arg == "--memreport") memReport = true;
+                        else if (arg == "--reusemappings") reuseMappings = true;
+                        else if (arg == "--sweep") {
+                                // the lists follow as separate key=value arguments
+                                while (i + 1 < argc && argv[i + 1][0] != '-') {
+                                        std::string list = argv[++i];
+                                        size_t eq = list.find('=');
+                                        std::string key = list.substr(0, eq);
+                                        std::transform(key.begin(), key.end(), key.begin(), tolower);
+                                        std::vector<unsigned int> &values = (key == "minlength") ? sweepMinLengths : sweepMinIdents;
+                                        if (eq == std::string::npos || (key != "minlength" && key != "minident")) {
+                                                std::cerr << "--sweep expects minLength=<list> and minIdent=<list>, not " << list << "." << std::endl;
+                                                exit(EXIT_FAILURE);
+                                        }
+                                        std::istringstream items(list.substr(eq + 1));
+                                        std::string item;
+                                        while (std::getline(items, item, ','))
+                                                values.push_back(stoui(item));
+                                }
+                                sweep = true;
+                        }
+                        else if (arg == "--serve") servePath = argv[++i];
+                        else if (arg == "--serveworkers") serveWorkers = std::stoul(argv[++i]);
+                        else if (arg == "--shards") numShards = std::stoul(argv[++i]);
+                        else if (arg == "--sharddir") shardDir = argv[++i];
+                        else if (arg == "--shardworker") {
+                                shardWorker = true;
+                                shardIdx = std::stoul(argv[++i]);
+                        }
+                        else if (arg == "--spawnshards") spawnShards = true;
+                        else if (arg == "--shardtimeout") shardTimeout = std::stoul(argv[++i]);
+			else {
+				std::cerr << "Unknown argument " << arg << ". Call without arguments for instructions." << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		catch (std::invalid_argument) {
+			std::cerr << "The value for argument " << arg << " could not be parsed." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+        if (resume && checkpointDir.empty()) {
+                std::cerr << "--resume requires --checkpoint <dir>." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (numShards && shardDir.empty()) {
+                std::cerr << "--shards requires --shardDir <dir>." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (spawnShards && (!numShards || shardWorker)) {
+                std::cerr << "--spawnShards requires --shards <num> and is given to the coordinator only." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (shardWorker && shardIdx >= numShards) {
+                std::cerr << "--shardWorker <k> requires --shards <num> with k < num." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (kernelVariant != "auto" && kernelVariant != "scalar" && kernelVariant != "avx2" && kernelVariant != "avx512") {
+                std::cerr << "--kernels must be auto, scalar, avx2 or avx512." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (outputFormat != "tsv" && outputFormat != "binary" && outputFormat != "compressed") {
+                std::cerr << "--outputFormat must be tsv, binary or compressed." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (outputFormat != "tsv" && outputPath.empty()) {
+                std::cerr << "--outputFormat " << outputFormat << " requires -o <file>." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (!servePath.empty() && (serveWorkers < 1 || shardWorker || numShards || !checkpointDir.empty())) {
+                std::cerr << "--serve requires --serveWorkers >= 1 and cannot be combined with shards or checkpoints." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (sweep) {
+                if (outputPath.empty() || !servePath.empty() || shardWorker || numShards || !checkpointDir.empty()) {
+                        std::cerr << "--sweep requires -o <output> and cannot be combined with --serve, shards or checkpoints." << std::endl;
+                        exit(EXIT_FAILURE);
+                }
+                if (sweepMinLengths.empty()) sweepMinLengths.push_back(minLength);
+                if (sweepMinIdents.empty()) sweepMinIdents.push_back(std::lround(minAlnIdentity * 100));
+                for (auto values : {&sweepMinLengths, &sweepMinIdents}) {
+                        std::sort(values->begin(), values->end());
+                        values->erase(std::unique(values->begin(), values->end()), values->end());
+                }
+                minAlnIdentity = sweepMinIdents.front() / 100.0f; // the alignments are parsed at the lowest identity
+        }
+        if (maxMemory && (!servePath.empty() || sweep || shardWorker || numShards || reuseMappings)) {
+                std::cerr << "--maxMemory cannot be combined with --serve, --sweep, shards or --reuseMappings." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (!cacheDir.empty() && (!servePath.empty() || sweep || shardWorker)) {
+                std::cerr << "--cacheDir cannot be combined with --serve, --sweep or --shardWorker." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (numa && !servePath.empty()) {
+                std::cerr << "--numa cannot be combined with --serve, whose workers split the threads." << std::endl;
+                exit(EXIT_FAILURE);
+        }
+        if (inputNotPsl) // in this case, pslPaths currently contains the files from which we have to read the actual paths
+            readPslPaths(); 
+}
+
+void InputParser::getCmdLineArgs(std::vector<std::string> &pslPaths,
+        unsigned int &minLength, unsigned int &maxGapLength, unsigned int &minAlnLength,
+        float &minAlnIdentity, unsigned int &bucketSize, unsigned int &numThreads) {
+    
+    pslPaths = this->pslPaths;
+    minLength = this->minLength;
+    maxGapLength = this->maxGapLength;
+    minAlnLength = this->minAlnLength;
+    minAlnIdentity = this->minAlnIdentity;
+    bucketSize = this->bucketSize;
+    numThreads = this->numThreads;
+}
+
+void InputParser::getCmdLineArgs(unsigned int &minLength, unsigned int &maxGapLength,
+        unsigned int &minAlnLength, float &minAlnIdentity, unsigned int &bucketSize,
+        unsigned int &numThreads) {
+    
+    minLength = this->minLength;
+    maxGapLength = this->maxGapLength;
+    minAlnLength = this->minAlnLength;
+    minAlnIdentity = this->minAlnIdentity;
+    bucketSize = this->bucketSize;
+    numThreads = this->numThreads;
+}
+
+void InputParser::setParseOptions(unsigned int maxGapLength, unsigned int minAlnLength, float minAlnIdentity) {
+    this->maxGapLength = maxGapLength;
+    this->minAlnLength = minAlnLength;
+    this->minAlnIdentity = minAlnIdentity;
+}
+
+void InputParser::setPslPaths(const std::vector<std::string> &pslPaths) {
+    this->pslPaths = pslPaths;
+}
+
+void InputParser::getCheckpointArgs(std::string &checkpointDir, unsigned int &checkpointEvery,
+        unsigned int &checkpointMinutes, bool &resume) {
+
+    checkpointDir = this->checkpointDir;
+    checkpointEvery = this->checkpointEvery;
+    checkpointMinutes = this->checkpointMinutes;
+    resume = this->resume;
+}
+
+void InputParser::getShardArgs(std::string &shardDir, unsigned int &numShards,
+        bool &shardWorker, unsigned int &shardIdx) {
+
+    shardDir = this->shardDir;
+    numShards = this->numShards;
+    shardWorker = this->shardWorker;
+    shardIdx = this->shardIdx;
+}
+
+void InputParser::getShardSpawnArgs(bool &spawnShards, unsigned int &shardTimeout) {
+    spawnShards = this->spawnShards;
+    shardTimeout = this->shardTimeout;
+}
+
+std::vector<std::string> InputParser::shardWorkerArgs(unsigned int k) const {
+    // options only the coordinator uses, with the number of values they take
+    static const std::map<std::string, int> coordinatorOnly = {
+        {"-o", 1}, {"--output", 1}, {"--outputformat", 1}, {"--cachedir", 1}, {"--metrics", 1},
+        {"--checkpoint", 1}, {"--checkpointevery", 1}, {"--checkpointminutes", 1}, {"--resume", 0},
+        {"--spawnshards", 0} };
+    std::vector<std::string> result(cmdArgs.begin(), cmdArgs.begin() + 1 + pslPathArgs);
+    for (size_t i = 1 + pslPathArgs; i < cmdArgs.size(); i++) {
+        std::string arg = cmdArgs[i];
+        std::transform(arg.begin(), arg.end(), arg.begin(), tolower);
+        auto option = coordinatorOnly.find(arg);
+        if (option != coordinatorOnly.end()) i += option->second;
+        else result.push_back(cmdArgs[i]);
+    }
+    result.push_back("--shardWorker");
+    result.push_back(std::to_string(k));
+    return result;
+}
+
+void InputParser::getScratchArgs(bool &scratchArena) {
+    scratchArena = this->scratchArena;
+}
+
+void InputParser::getCoordinateArgs(bool &compactCoordinates) {
+    compactCoordinates = this->compactCoordinates;
+}
+
+void InputParser::getKernelArgs(std::string &kernels) {
+    kernels = kernelVariant;
+}
+
+void InputParser::getStopArgs(unsigned int &maxIterations, float &convergenceFraction) {
+    maxIterations = this->maxIterations;
+    convergenceFraction = this->convergenceFraction;
+}
+
+void InputParser::getNumaArgs(bool &numa, bool &hugePages) {
+    numa = this->numa;
+    hugePages = this->hugePages;
+}
+
+void InputParser::getClassifyArgs(bool &reuseMappings) {
+    reuseMappings = this->reuseMappings;
+}
+
+void InputParser::getOutputArgs(std::string &outputPath, std::string &outputFormat) {
+    outputPath = this->outputPath;
+    outputFormat = this->outputFormat;
+}
+
+void InputParser::getCacheArgs(std::string &cacheDir) {
+    cacheDir = this->cacheDir;
+}
+
+void InputParser::getServeArgs(std::string &servePath, unsigned int &serveWorkers) {
+    servePath = this->servePath;
+    serveWorkers = this->serveWorkers;
+}
+
+void InputParser::getSweepArgs(bool &sweep, std::vector<unsigned int> &minLengths, std::vector<unsigned int> &minIdents) {
+    sweep = this->sweep;
+    minLengths = sweepMinLengths;
+    minIdents = sweepMinIdents;
+}
+
+void InputParser::getMetricsArgs(std::string &metricsPath) {
+    metricsPath = this->metricsPath;
+}
+
+void InputParser::getMemReportArgs(bool &memReport) {
+    memReport = this->memReport;
+}
+
+void InputParser::getStoreArgs(unsigned long &maxMemory, std::string &storeDir) {
+    maxMemory = this->maxMemory;
+    storeDir = this->storeDir;
+}
+
+unsigned long InputParser::inputFingerprint() const {
+    unsigned long h = fnv1a(nullptr, 0);
+    for (auto &psl : pslPaths) {
+        h = fnv1a(psl.data(), psl.size(), h);
+        struct stat st;
+        if (stat(psl.c_str(), &st) == 0) {
+            unsigned long size = st.st_size, mtime = st.st_mtime;
+            h = fnv1a(&size, sizeof(size), h);
+            h = fnv1a(&mtime, sizeof(mtime), h);
+        }
+    }
+    // numThreads does not influence the result, all other parameters do
+    h = fnv1a(&minLength, sizeof(minLength), h);
+    h = fnv1a(&maxGapLength, sizeof(maxGapLength), h);
+    h = fnv1a(&minAlnLength, sizeof(minAlnLength), h);
+    h = fnv1a(&minAlnIdentity, sizeof(minAlnIdentity), h);
+    h = fnv1a(&bucketSize, sizeof(bucketSize), h);
+    // maxIterations and convergenceFraction only decide when to stop, a checkpoint stays valid
+    return h;
+}
+
+unsigned long InputParser::resultFingerprint() const {
+    unsigned long h = fnv1a(nullptr, 0);
+    std::vector<char> buffer(1 << 20);
+    for (auto &psl : pslPaths) { // in order, the concatenated sequence depends on it
+        std::ifstream in(psl, std::ios::binary);
+        unsigned long size = 0;
+        while (in.read(buffer.data(), buffer.size()) || in.gcount() > 0) {
+            h = fnv1a(buffer.data(), in.gcount(), h);
+            size += in.gcount();
+        }
+        h = fnv1a(&size, sizeof(size), h); // separates the files
+    }
+    h = fnv1a(&minLength, sizeof(minLength), h);
+    h = fnv1a(&maxGapLength, sizeof(maxGapLength), h);
+    h = fnv1a(&minAlnLength, sizeof(minAlnLength), h);
+    h = fnv1a(&minAlnIdentity, sizeof(minAlnIdentity), h);
+    h = fnv1a(&maxIterations, sizeof(maxIterations), h);
+    h = fnv1a(&convergenceFraction, sizeof(convergenceFraction), h);
+    h = fnv1a(&bucketSize, sizeof(bucketSize), h); // epsilon of IMP depends on it
+    h = fnv1a(outputFormat.data(), outputFormat.size(), h);
+    // numThreads, windows, the out-of-core mode, kernels, coordinates and NUMA placement give identical results
+    return h;
+}
+
+/* Parses a single psl line to alignment records (original and reverse,
+ * sometimes split) and add them to records vector, returns the number of
+ * records added */
+unsigned long InputParser::recordsFromPsl(std::deque<AlignmentRecord *>& records,
+        std::map<std::string, unsigned long>& speciesStart) {
+    
+        PslAlignment aln;
+        pos = 0; // position in line
+        
+        { // skip low quality alignments
+            aln.matches = getIntField();
+            aln.mismatches = getIntField();
+            aln.repMatches = getIntField();
+            if (!passesIdentity(aln)) return 0;
+            // Comments from original parser:
+            /* removed these filters for now - filter input psl by hand instead when needed
+             * if (curRec.tStart > curRec.qStart) continue; // only one version of symmetric alignments 
+             * if (curRec.tStart == curRec.qStart && curRec.tEnd == curRec.qEnd)
+             *	continue; // skip alignments that align a region to itself*/
+        }
+        
+        getRemainingFields(aln);
+        return recordsFromAlignment(records, speciesStart, aln);
+}
+
+/* Reads the fields of the current line after repMatches into aln */
+void InputParser::getRemainingFields(PslAlignment &aln) {
+        skipFields(5);
+        
+        // fields variables, in the order they appear
+        aln.strand = line[pos++];
+        if ((aln.strand != '+' && aln.strand != '-') || line[pos] != '\t') malformed("strand is not + or -");
+        ++pos; // we should be at \t now, move past it
+        
+        aln.qName = getStringField();
+        aln.qSize = getLongField();
+        aln.qStart = getLongField();
+        aln.qEnd = getLongField();
+        
+        aln.tName = getStringField();
+        aln.tSize = getLongField();
+        aln.tStart = getLongField();
+        aln.tEnd = getLongField();
+        
+        unsigned int blockCount = getIntField();
+        if (blockCount > lineLength) malformed("blockCount exceeds the length of the line"); // before allocating
+        
+        aln.blockSizes = getIntArrayField(blockCount);
+        aln.qStarts = getLongArrayField(blockCount);
+        aln.tStarts = getLongArrayField(blockCount);
+}
+
+/* Reads the next line that is not a comment or empty into line, returns false at the end of the stream */
+bool InputParser::nextPslLine(std::istream &pslFile) {
+        while (!pslFile.getline(line.get(), MAX_LINE).eof()) {
+                ++line_num;
+                if (pslFile.fail()) malformed("longer than " + std::to_string(MAX_LINE - 1) + " characters");
+                if (line[0] == '#' || line[0] == '\0') continue; // skip comments and empty lines
+                lineLength = pslFile.gcount() - 1; // without the line break
+                return true;
+        }
+        return false;
+}
+
+bool InputParser::readPslAlignment(std::istream &pslFile, PslAlignment &aln) {
+        if (!line) line.reset(new char[MAX_LINE]);
+        try {
+                if (!nextPslLine(pslFile)) return false;
+                pos = 0;
+                aln.matches = getIntField();
+                aln.mismatches = getIntField();
+                aln.repMatches = getIntField();
+                getRemainingFields(aln);
+        } catch (const std::invalid_argument &e) {
+                throw std::invalid_argument("malformed psl line " + std::to_string(line_num) + ": " + e.what());
+        }
+        return true;
+}
+
+InputParser::~InputParser() {
+}
+
+unsigned long InputParser::addAlignment(std::deque<AlignmentRecord *>& records,
+        std::map<std::string, unsigned long>& speciesStart, const PslAlignment &aln) {
+        ++line_num;
+        if (!passesIdentity(aln)) return 0;
+        PslAlignment copy = aln;
+        try {
+                return recordsFromAlignment(records, speciesStart, copy);
+        } catch (const std::invalid_argument &e) {
+                throw std::invalid_argument("malformed alignment " + std::to_string(line_num) + ": " + e.what());
+        }
+}
+
+void InputParser::malformed(const std::string &reason) {
+        throw std::invalid_argument(reason);
+}
+
+void InputParser::checkAlignment(const PslAlignment &aln) {
+        if (aln.strand != '+' && aln.strand != '-') malformed("strand is not + or -");
+        if (aln.qName == "$" || aln.tName == "$") malformed("$ is reserved as the end of all sequences");
+        if (aln.qStart > aln.qEnd || aln.qEnd > aln.qSize || aln.tStart > aln.tEnd || aln.tEnd > aln.tSize)
+                malformed("start and end do not lie within the sequences");
+        if (aln.qStarts.size() != aln.blockSizes.size() || aln.tStarts.size() != aln.blockSizes.size())
+                malformed("the block lists differ in length");
+        for (size_t i = 0; i < aln.blockSizes.size(); i++) // without overflowing on huge starts
+                if (aln.qStarts[i] > aln.qSize || aln.blockSizes[i] > aln.qSize - aln.qStarts[i]
+                        || aln.tStarts[i] > aln.tSize || aln.blockSizes[i] > aln.tSize - aln.tStarts[i])
+                        malformed("block " + std::to_string(i + 1) + " does not lie within the sequences");
+}
+
+bool InputParser::removeZeroBlocks(std::vector<unsigned int> &blockSizes,
+        std::vector<unsigned long> &qStarts, std::vector<unsigned long> &tStarts) {
+    size_t i;
+    for (i = 0; i < blockSizes.size() && blockSizes[i] != 0; ++i)
+        ;
+    
+    if (i == blockSizes.size()) // no zero blocks
+        return false; // this is the most usual case and we want to know fast
+    
+    size_t n = i; // blocks kept
+    for (++i; i < blockSizes.size(); ++i)
+        if (blockSizes[i] != 0) {
+            blockSizes[n] = blockSizes[i];
+            qStarts[n] = qStarts[i];
+            tStarts[n] = tStarts[i];
+            n++;
+        }
+    
+    blockSizes.resize(n);
+    qStarts.resize(n);
+    tStarts.resize(n);
+    return true;
+}
+
+void InputParser::shiftBlockStarts(char strand, unsigned long qSize, unsigned long qOffset, unsigned long tOffset,
+        std::vector<unsigned long> &qStarts, std::vector<unsigned long> &tStarts) {
+	if (strand == '+')
+            for (auto i = qStarts.begin(); i != qStarts.end(); i++)
+                *i += qOffset;
+	else
+            for (auto i = qStarts.begin(); i != qStarts.end(); i++)
+                *i = qSize - *i + qOffset;
+	for (auto i = tStarts.begin(); i != tStarts.end(); i++)
+            *i += tOffset;
+}
+
+template <typename Part>
+void InputParser::forEachAlignmentPart(char strand, const std::vector<unsigned int> &blockSizes,
+        const std::vector<unsigned long> &qStarts, const std::vector<unsigned long> &tStarts,
+        unsigned int maxGapLength, unsigned int minAlnLength, Part part) {
+	const unsigned int blockCount = blockSizes.size();
+	unsigned int start = 0, end;
+	for (end = 0; end < blockCount; end++) {
+            bool split = end + 1 == blockCount
+                    || tStarts[end + 1] - (tStarts[end] + blockSizes[end]) > maxGapLength
+                    || (strand == '+' && qStarts[end + 1] - (qStarts[end] + blockSizes[end]) > maxGapLength)
+                    || (strand == '-' && qStarts[end] - (qStarts[end + 1] + blockSizes[end]) > maxGapLength);
+            if (!split) continue;
+            if ((tStarts[end] + blockSizes[end]) - tStarts[start] > minAlnLength)
+                part(start, end);
+            start = end + 1;
+	}
+}
+
+/* Creates the records of an alignment that passed the identity filter, see recordsFromPsl */
+unsigned long InputParser::recordsFromAlignment(std::deque<AlignmentRecord *>& records,
+        std::map<std::string, unsigned long>& speciesStart, PslAlignment &aln) {
+    
+        checkAlignment(aln);
+        size_t orig_size = records.size(); // records size before adding new records
+        const char strand = aln.strand;
+        const unsigned int matches = aln.matches + aln.repMatches;
+        const float identity = static_cast<float>(matches) / static_cast<float>(matches + aln.mismatches);
+        // check if sequence is in the map, if not, add it; offset positions for concatenated sequence
+        const unsigned long qOffset = updateSpeciesStart(speciesStart, aln.qName, aln.qSize);
+        const unsigned long qStart = aln.qStart + qOffset;
+        const unsigned long qEnd = aln.qEnd + qOffset;
+        
+        const unsigned long tOffset = updateSpeciesStart(speciesStart, aln.tName, aln.tSize);
+        const unsigned long tStart = aln.tStart + tOffset;
+        const unsigned long tEnd = aln.tEnd + tOffset;
+        
+        std::vector<unsigned int> &blockSizes = aln.blockSizes;
+        std::vector<unsigned long> &qStarts = aln.qStarts;
+        std::vector<unsigned long> &tStarts = aln.tStarts;
+        
+        if (removeZeroBlocks(blockSizes, qStarts, tStarts)) zeroBlockLines.push_back(line_num);
+        if (blockSizes.empty()) return 0;
+        shiftBlockStarts(strand, aln.qSize, qOffset, tOffset, qStarts, tStarts);
+        
+        // Splits alignment in parts if it contains gaps longer than maxGapLength,
+        // adds to results only if split parts are longer than minAlnLength
+        forEachAlignmentPart(strand, blockSizes, qStarts, tStarts, maxGapLength, minAlnLength,
+            [&](unsigned int first, unsigned int last) {
+                setupSymAndAdd(records, new AlignmentRecord(strand, qStart, qEnd, tStart, tEnd, last - first + 1,
+                    blockSizes, qStarts, tStarts, first), identity);
+            });
+        
+        return records.size() - orig_size;
+}
+
+void InputParser::parsePsl(std::map<std::string, unsigned long>& speciesStart,
+	std::deque<AlignmentRecord *>& result, AlignmentStore *store) {
+        const size_t STORE_BATCH = 1 << 14; // records handed to the store at once
+    
+        if (!line) line.reset(new char[MAX_LINE]); // I'm not sure if it is a good idea to allocate this big block in the stack
+        zeroBlockLines.reserve(1024);
+        int filen = 1;
+                
+	std::ifstream pslFile;
+        for (auto psl : pslPaths) {
+            std::cerr << "Reading " << psl << " (" << filen++ << "/" << pslPaths.size() << ")... ";
+            pslFile.open(psl);
+            if (pslFile.is_open()) {
+                    line_num = 0;
+                    try {
+                            while (nextPslLine(pslFile)) {
+                                    recordsFromPsl(result, speciesStart);
+                                    if (store && result.size() >= STORE_BATCH) store->add(result);
+                            }
+                    } catch (const std::invalid_argument &e) {
+                            throw std::invalid_argument("malformed psl line " + std::to_string(line_num) + " of " + psl
+                                + ": " + e.what());
+                    }
+                    if (store) store->add(result);
+                    pslFile.close();
+                    std::cerr << "Done." << std::endl;
+                    printZeroBlockInfo();
+                    zeroBlockLines.clear();
+            }
+            else
+                    throw std::runtime_error("psl file could not be opened: " + psl);
+        }
+        line.reset();
+}
+
+unsigned long InputParser::parsePslLine(const std::string &pslLine, std::deque<AlignmentRecord *>& records,
+        std::map<std::string, unsigned long>& speciesStart) {
+        if (!line) line.reset(new char[MAX_LINE]); // kept for the next line
+        size_t length = std::min(pslLine.size(), static_cast<size_t>(MAX_LINE - 1));
+        std::memcpy(line.get(), pslLine.data(), length);
+        line[length] = '\0';
+        lineLength = length;
+        ++line_num;
+        try {
+                return recordsFromPsl(records, speciesStart);
+        } catch (const std::invalid_argument &e) {
+                throw std::invalid_argument("malformed psl line: " + std::string(e.what()));
+        }
+}
+
+unsigned int MemoryPlan::requiredBlockWidth() const {
+    unsigned long largest = std::max(std::max(maxBlockSize, maxLocalStart), maxBlockCount);
+    if (largest <= 0xffffUL) return 2;
+    if (largest <= 0xffffffffUL) return 4;
+    return 8;
+}
+
+/* Reentrant psl field readers for planMemory, p points into the line ending at end and is moved past the field.
+ * They accept the lines the field readers of the parser accept and throw std::invalid_argument like them. */
+static inline unsigned long planNumber(const char *&p, const char *end) {
+    const char *start = p;
+    unsigned long v = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        v = v * 10 + (*p++ - '0');
+    if (p == start || p == end || *p != '\t') throw std::invalid_argument("field is not a number");
+    ++p; // move past \t
+    return v;
+}
+
+static inline std::string planName(const char *&p, const char *end) {
+    const char *start = p;
+    while (p < end && *p != '\t')
+        ++p;
+    if (p == start || p == end) throw std::invalid_argument("missing sequence name");
+    return std::string(start, p++);
+}
+
+static inline void planSkip(const char *&p, const char *end, unsigned int fields) {
+    for (unsigned int skipped = 0; skipped < fields; ++p) {
+        if (p == end) throw std::invalid_argument("too few fields");
+        if (*p == '\t') ++skipped;
+    }
+}
+
+/* Reads the subfields of an array field like the parse kernels, each followed by one separator */
+template <typename T>
+static inline void planArray(const char *&p, const char *end, std::vector<T> &values) {
+    for (auto &x : values) {
+        unsigned long v = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+            v = v * 10 + (*p++ - '0');
+        if (p == end) throw std::invalid_argument("block list does not have blockCount entries");
+        x = v;
+        ++p; // move past the separator
+    }
+    if (p > end || (p < end && *p != '\t' && *p != '\r'))
+        throw std::invalid_argument("block list does not have blockCount entries");
+    ++p; // move past \t
+}
+
+/* Adds one record (its blocks relative to its own start) to plan */
+static inline void planRecord(MemoryPlan &plan, unsigned long blockCount, unsigned long maxLocal) {
+    plan.records++;
+    plan.blocks += blockCount;
+    plan.maxBlockCount = std::max(plan.maxBlockCount, blockCount);
+    plan.maxLocalStart = std::max(plan.maxLocalStart, maxLocal);
+    const unsigned int widths[3] = {2, 4, 8};
+    for (int w = 0; w < 3; w++) // the record, its three block arrays and the pointer in the deque
+        plan.recordBytes[w] += mallocBytes(sizeof(AlignmentRecord)) + 3 * mallocBytes(blockCount * widths[w])
+            + sizeof(AlignmentRecord *);
+}
+
+/* Adds the bucket entries of a record covering [start, end] of its target sequence */
+static inline void planBuckets(MemoryPlan &plan, unsigned long start, unsigned long end) {
+    for (size_t b = 0; b < plan.bucketSizes.size(); b++)
+        plan.bucketEntries[b] += end / plan.bucketSizes[b] - start / plan.bucketSizes[b] + 1;
+}
+
+/* Plans the records of one psl line the way recordsFromPsl creates them: identity filter,
+ * removal of zero blocks, splitting at long gaps and the minAlnLength filter, each part with its reverse */
+void InputParser::planPslLine(const char *p, const char *end, float minAlnIdentity, unsigned int maxGapLength,
+        unsigned int minAlnLength, MemoryPlan &plan, std::map<std::string, unsigned long> &sequences) {
+    plan.lines++;
+    const char *line = p;
+    unsigned long matches = planNumber(p, end), mismatches = planNumber(p, end);
+    matches += planNumber(p, end); // repmatches
+    if (!identityPasses(matches, mismatches, minAlnIdentity)) {
+        plan.lowIdentity++;
+        return;
+    }
+    planSkip(p, end, 5);
+    const char strand = *p;
+    if ((strand != '+' && strand != '-') || end - p < 2 || p[1] != '\t')
+        throw std::invalid_argument("strand is not + or -");
+    p += 2;
+    std::string qName = planName(p, end);
+    unsigned long qSize = planNumber(p, end);
+    planNumber(p, end); // qStart
+    planNumber(p, end); // qEnd
+    std::string tName = planName(p, end);
+    unsigned long tSize = planNumber(p, end);
+    planNumber(p, end); // tStart
+    planNumber(p, end); // tEnd
+    unsigned long blockCount = planNumber(p, end);
+    if (blockCount > static_cast<unsigned long>(end - line)) // before allocating
+        throw std::invalid_argument("blockCount exceeds the length of the line");
+    std::vector<unsigned int> sizes(blockCount);
+    std::vector<unsigned long> qStarts(blockCount), tStarts(blockCount);
+    planArray(p, end, sizes);
+    planArray(p, end, qStarts);
+    planArray(p, end, tStarts);
+    sequences.insert(std::make_pair(qName, qSize));
+    sequences.insert(std::make_pair(tName, tSize));
+    removeZeroBlocks(sizes, qStarts, tStarts);
+    if (sizes.empty()) return;
+    shiftBlockStarts(strand, qSize, 0, 0, qStarts, tStarts); // the local values do not depend on the offsets
+    for (auto size : sizes)
+        plan.maxBlockSize = std::max<unsigned long>(plan.maxBlockSize, size);
+
+    forEachAlignmentPart(strand, sizes, qStarts, tStarts, maxGapLength, minAlnLength,
+        [&](unsigned int first, unsigned int last) {
+            unsigned long tStart = tStarts[first], tEnd = tStarts[last] + sizes[last];
+            unsigned long qStart = (strand == '+') ? qStarts[first] : qStarts[last] - sizes[last];
+            unsigned long qEnd = (strand == '+') ? qStarts[last] + sizes[last] : qStarts[first];
+            // the record and its reverse store the same local values, on the reverse strand shifted by the block size
+            unsigned long maxLocal = 0;
+            for (unsigned int i = first; i <= last; i++) {
+                maxLocal = std::max(maxLocal, std::max(tStarts[i] - tStart, qStarts[i] - qStart));
+                if (strand == '-')
+                    maxLocal = std::max(maxLocal, std::max(tStarts[i] + sizes[i] - tStart, qStarts[i] - sizes[i] - qStart));
+            }
+            planRecord(plan, last - first + 1, maxLocal);
+            planRecord(plan, last - first + 1, maxLocal);
+            planBuckets(plan, tStart, tEnd);
+            planBuckets(plan, qStart, qEnd);
+        });
+}
+
+void InputParser::planMemory(const std::vector<unsigned int> &bucketSizes, MemoryPlan &plan) {
+    const size_t CHUNK_BYTES = 64UL << 20;
+    plan.bucketSizes = bucketSizes;
+    plan.bucketEntries.assign(bucketSizes.size(), 0);
+    std::map<std::string, unsigned long> sequences;
+    std::vector<char> buf;
+    int filen = 1;
+    for (auto psl : pslPaths) {
+        std::cerr << "Scanning " << psl << " (" << filen++ << "/" << pslPaths.size() << ")... ";
+        std::ifstream pslFile(psl, std::ios::binary);
+        if (!pslFile.is_open())
+            throw std::runtime_error("psl file could not be opened: " + psl);
+        size_t carry = 0; // bytes of an incomplete line kept from the previous chunk
+        unsigned long fileLines = 0; // lines of the file before this chunk
+        while (pslFile) {
+            buf.resize(carry + CHUNK_BYTES);
+            pslFile.read(buf.data() + carry, CHUNK_BYTES);
+            size_t len = carry + pslFile.gcount();
+            // complete lines of this chunk; like parsePsl, a last line without newline is not read
+            std::vector<size_t> lineStarts, lineEnds;
+            std::vector<unsigned long> lineNumbers;
+            size_t lineStart = 0;
+            for (size_t i = 0; i < len; i++)
+                if (buf[i] == '\n') {
+                    ++fileLines;
+                    if (buf[lineStart] != '#' && buf[lineStart] != '\n') {
+                        lineStarts.push_back(lineStart);
+                        lineEnds.push_back(i);
+                        lineNumbers.push_back(fileLines);
+                    }
+                    lineStart = i + 1;
+                }
+
+            std::vector<MemoryPlan> threadPlans(numThreads);
+            std::vector<std::map<std::string, unsigned long>> threadSequences(numThreads);
+            size_t errorLine = lineStarts.size(); // the first malformed line, exceptions cannot leave the loop
+            std::string error;
+            #pragma omp parallel num_threads(numThreads)
+            {
+                int t = omp_get_thread_num();
+                threadPlans[t].bucketSizes = bucketSizes;
+                threadPlans[t].bucketEntries.assign(bucketSizes.size(), 0);
+                #pragma omp for schedule(dynamic, 1024)
+                for (size_t l = 0; l < lineStarts.size(); l++) try {
+                    if (lineEnds[l] - lineStarts[l] > MAX_LINE - 1)
+                        throw std::invalid_argument("longer than " + std::to_string(MAX_LINE - 1) + " characters");
+                    planPslLine(buf.data() + lineStarts[l], buf.data() + lineEnds[l], minAlnIdentity, maxGapLength,
+                        minAlnLength, threadPlans[t], threadSequences[t]);
+                } catch (const std::invalid_argument &e) {
+                    #pragma omp critical(planMemoryError)
+                    if (l < errorLine) {
+                        errorLine = l;
+                        error = e.what();
+                    }
+                }
+            }
+            if (errorLine < lineStarts.size())
+                throw std::invalid_argument("malformed psl line " + std::to_string(lineNumbers[errorLine]) + " of "
+                    + psl + ": " + error);
+            for (int t = 0; t < static_cast<int>(numThreads); t++) {
+                const MemoryPlan &tp = threadPlans[t];
+                plan.lines += tp.lines;
+                plan.lowIdentity += tp.lowIdentity;
+                plan.records += tp.records;
+                plan.blocks += tp.blocks;
+                plan.maxBlockSize = std::max(plan.maxBlockSize, tp.maxBlockSize);
+                plan.maxLocalStart = std::max(plan.maxLocalStart, tp.maxLocalStart);
+                plan.maxBlockCount = std::max(plan.maxBlockCount, tp.maxBlockCount);
+                for (int w = 0; w < 3; w++)
+                    plan.recordBytes[w] += tp.recordBytes[w];
+                for (size_t b = 0; b < bucketSizes.size(); b++)
+                    plan.bucketEntries[b] += tp.bucketEntries[b];
+                sequences.insert(threadSequences[t].begin(), threadSequences[t].end());
+            }
+            carry = len - lineStart;
+            std::copy(buf.begin() + lineStart, buf.begin() + len, buf.begin());
+        }
+        std::cerr << "Done." << std::endl;
+    }
+    plan.sequences = sequences.size();
+    for (auto &seq : sequences) // as in updateSpeciesStart, each sequence counts once (psl lines agree on its size)
+        plan.totalLength += seq.second;
+}
+
+void InputParser::printZeroBlockInfo(void) {
+    if (zeroBlockLines.size() == 0)
+        return;
+    
+    std::cerr << "\tBlocks of size 0 found and removed in " << zeroBlockLines.size() << " alignments";
+    if (!printZeroLines) {
+        std::cerr << std::endl;
+        return;
+    }
+    
+    std::cerr << ", lines ";
+    bool first = true;
+    for (auto l : zeroBlockLines)
+        if (first) {
+            std::cerr << l;
+            first = false;
+        }
+        else
+            std::cerr << ", " << l;
+    std::cerr << std::endl;
+}
+
+void InputParser::readPslPaths(void) {
+        if (!line) line.reset(new char[MAX_LINE]); // I'm not sure if it is a good idea to allocate this big block in the stack
+        zeroBlockLines.reserve(1024);
+        std::vector<std::string> listFilesPaths = pslPaths;
+        pslPaths.clear();
+        
+	std::ifstream pathsFile;
+        for (auto psl : listFilesPaths) {
+            pathsFile.open(psl);
+            if (pathsFile.is_open()) {
+                    line_num = 0;
+                    while (!pathsFile.getline(line.get(), MAX_LINE).eof()) {
+                            ++line_num;
+                            if (line[0] == '\0') continue; // skip comments and empty lines
+                            
+                            pslPaths.push_back(line.get());
+                    }
+                    pathsFile.close();
+            }
+            else
+                    throw std::runtime_error("list file could not be opened: " + psl);
+        }
+        line.reset();
+}
@@ -1,230 +1,426 @@
-#pragma once
-#include <string>
-#include <map>
-#include <vector>
-#include <deque>
-#include <memory>
-#include "AlignmentRecord.h"
-
-class InputParser {
-    
-public:
-    /* Constructor */
-    InputParser();
-    
-    /* Parses command line arguments or prints help if none are given. */
-    void parseCmdArgs(int argc, char** &argv);
-    
-    /* Places in variables command line arguments parsed */
-    void getCmdLineArgs(std::vector<std::string> &pslPaths,
-            unsigned int &minLength, unsigned int &maxGap, unsigned int &minAlnLength,
-            float &minAlnIdentity, unsigned int &bucketSize, unsigned int &numThreads);
-    
-    /* Places in variables command line arguments parsed, except for pslPaths */
-    void getCmdLineArgs(unsigned int &minLength, unsigned int &maxGap,
-            unsigned int &minAlnLength, float &minAlnIdentity,
-            unsigned int &bucketSize, unsigned int &numThreads);
-
-    /* Reads a psl file. 
-    Each line is parsed to an AlignmentRecord. Pointers to all records are stored in result.
-    Result is sorted by the alignment's starting position in the target sequence. */
-    void parsePsl(std::map<std::string, unsigned long>& speciesStart,
-            std::deque<AlignmentRecord *>& result);
-    
-    /* Reads psl files and finds the maximum block size and maximum block start
-     * (using local coordinates) inside an alignment */
-    void getMaxBlockSizeAndLocalStart(unsigned long &max_bsize, unsigned long &max_start);
-
-private:
-    std::vector<std::string> pslPaths;
-    unsigned int minLength;
-    unsigned int maxGapLength;
-    unsigned int minAlnLength;
-    float minAlnIdentity;
-    unsigned int bucketSize;
-    unsigned int numThreads;
-    bool printZeroLines;
-    bool inputNotPsl;
-    
-    // We suppose psl lines won't be longer than that
-    static const unsigned int MAX_LINE = 32768;
-    
-    // Used during parse
-    char *line; // current line
-    unsigned int pos; // position in current line
-    unsigned long line_num; // current line number
-    std::vector<unsigned long> zeroBlockLines; // lines containing blocks of size 0
-    
-
-    /* Parses a single psl line to alignment records (original and reverse,
-     * sometimes split) and add them to records vector, returns the number of
-     * records added */
-    unsigned long recordsFromPsl(std::deque<AlignmentRecord *>& records,             
-            std::map<std::string, unsigned long>& speciesStart);
-    
-    /* Reads a string field  */
-    inline std::string getStringField();
-
-    /* Reads and returns a long field value (we assume no sign, just digits) */
-    inline unsigned long getLongField();
-
-    /* Reads and returns an int field value (we assume no sign, just digits) */
-    inline unsigned int getIntField();
-
-    /* Reads and returns a long subfield value (we assume no sign, just digits, ends with comma) */
-    inline unsigned long getLongSubField();
-
-    /* Reads and returns an int subfield value (we assume no sign, just digits, ends with comma) */
-    inline unsigned int getIntSubField();
-
-    /* Reads and returns an integer vector from a field composed by a set of int subfields separated and ending by comma + \t */
-    inline std::vector<unsigned int> getIntArrayField(unsigned int numberOfSubfields);
-
-    /* Reads and returns an integer vector from a field composed by a set of long subfields separated and ending by comma + \t */
-    inline std::vector<unsigned long> getLongArrayField(unsigned int numberOfSubfields);
-
-    /* Advances in line skipping a number of fields */
-    inline void skipFields(unsigned int numberOfFields);
-
-    /* Check if sequences in current line were already read. If not, add with its related offset */
-    inline void updateSpeciesStart(std::map<std::string, unsigned long>& speciesStart,
-            std::string name, unsigned long size);
-
-    /* Adds record and reverse to vector and setup sym pointers */
-    inline void setupSymAndAdd(std::deque<AlignmentRecord *>& records, AlignmentRecord *rec);
-    
-    /* Removes blocks of size 0 and updates related data */
-    inline void removeZeroBlocks(unsigned int &blockCount, std::vector<unsigned int> &blockSizes,
-            std::vector<unsigned long> &qStarts, std::vector<unsigned long> &tStarts);
-    
-    /* Prints to stderr message about lines that have removed blocks of size 0 */
-    void printZeroBlockInfo(void);
-    
-    /* For each file in pslPaths read that file and get the psl paths inside it,
-     * then replace the strings in pslPaths with the actual psl paths */
-    void readPslPaths(void);
-};
-
-
-/* InputParser inline methods */
-
-inline std::string InputParser::getStringField() {
-        std::string str;
-        str.reserve(16); // should be enough in most cases
-        while (line[pos] != '\t')
-            str.push_back(line[pos++]);
-        ++pos; // move to after \t
-        return str;
-}
-
-inline unsigned long InputParser::getLongField() {
-        unsigned long v = 0;
-        while (line[pos] != '\t') {
-            v *= 10;
-            v += line[pos++] - '0';
-        }
-        ++pos; // move to after \t
-        return v;
-}
-
-inline unsigned int InputParser::getIntField() {
-        unsigned int v = 0;
-        while (line[pos] != '\t') {
-            v *= 10;
-            v += line[pos++] - '0';
-        }
-        ++pos; // move to after \t
-        return v;
-}
-
-inline unsigned long InputParser::getLongSubField() {
-// we could join this function with getNumericField function, but an extra || comparison would make it slower
-        unsigned long v = 0;
-        while (line[pos] != ',') {
-            v *= 10;
-            v += line[pos++] - '0';
-        }
-        ++pos; // move to after ,
-        return v;
-}
-
-inline unsigned int InputParser::getIntSubField() {
-// we could join this function with getNumericField function, but an extra || comparison would make it slower
-        unsigned int v = 0;
-        while (line[pos] != ',') {
-            v *= 10;
-            v += line[pos++] - '0';
-        }
-        ++pos; // move to after ,
-        return v;
-}
-
-inline std::vector<unsigned int> InputParser::getIntArrayField(unsigned int numberOfSubfields) {
-        std::vector<unsigned int> values;
-        values.reserve(numberOfSubfields);
-        for (unsigned int i = 0; i < numberOfSubfields; i++)
-            values.push_back(getIntSubField());
-        ++pos; // move to after \t (or \n if this is the last field)
-        return values;
-}
-
-inline std::vector<unsigned long> InputParser::getLongArrayField(unsigned int numberOfSubfields) {
-        std::vector<unsigned long> values;
-        values.reserve(numberOfSubfields);
-        for (unsigned int i = 0; i < numberOfSubfields; i++)
-            values.push_back(getLongSubField());
-        ++pos; // move to after \t (or \n if this is the last field)
-        return values;
-}
-
-inline void InputParser::skipFields(unsigned int numberOfFields) {
-        for (unsigned int skipped = 0; skipped < numberOfFields; ++pos)
-            if (line[pos] == '\t')
-                ++skipped;
-}
-
-inline void InputParser::updateSpeciesStart(std::map<std::string, unsigned long>& speciesStart,
-        std::string name, unsigned long size) {
-        if (!speciesStart.count(name)) {
-            auto last = speciesStart.find("$");
-            auto curLen = last->second;
-            speciesStart.insert(std::pair<std::string, unsigned long>(name, curLen));
-            last->second = curLen + size;
-        }
-}
-
-inline void InputParser::setupSymAndAdd(std::deque<AlignmentRecord *>& records, AlignmentRecord *rec) {
-        AlignmentRecord *rev = rec->revert();
-        rec->sym = rev;
-        rev->sym = rec;
-        records.push_back(rec);
-        records.push_back(rev);
-}
-
-inline void InputParser::removeZeroBlocks(unsigned int &blockCount, std::vector<unsigned int> &blockSizes,
-        std::vector<unsigned long> &qStarts, std::vector<unsigned long> &tStarts) {
-    unsigned int i;
-    for (i = 0; i < blockCount && blockSizes[i] != 0; ++i)
-        ;
-    
-    if (i == blockCount) // no zero blocks
-        return; // this is the most usual case and we want to know fast
-    
-    ++i; // i is in the 1st occurrence of 0, we go to the next position
-    unsigned int zeros = 1;
-    for ( ; i < blockCount; ++i)
-        if (blockSizes[i] == 0)
-            ++zeros;
-        else {
-            blockSizes[i - zeros] = blockSizes[i];
-            qStarts[i - zeros] = qStarts[i];
-            tStarts[i - zeros] = tStarts[i];
-        }
-    
-    blockCount -= zeros;
-    blockSizes.resize(blockCount);
-    qStarts.resize(blockCount);
-    tStarts.resize(blockCount);
-    
-    zeroBlockLines.push_back(line_num);
-}
+#pragma once
+#include <string>
+#include <map>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <istream>
+#include "AlignmentRecord.h"
+#include "Kernels.h"
+#include "AlignmentStore.h"
+
+/* The fields of a psl line that atomizer uses, positions as in the psl format */
+struct PslAlignment {
+    unsigned int matches = 0;
+    unsigned int mismatches = 0;
+    unsigned int repMatches = 0;
+    char strand = '+';
+    std::string qName;
+    unsigned long qSize = 0;
+    unsigned long qStart = 0;
+    unsigned long qEnd = 0;
+    std::string tName;
+    unsigned long tSize = 0;
+    unsigned long tStart = 0;
+    unsigned long tEnd = 0;
+    std::vector<unsigned int> blockSizes;
+    std::vector<unsigned long> qStarts;
+    std::vector<unsigned long> tStarts;
+};
+
+/* Predicted sizes of the parsed input, see InputParser::planMemory */
+struct MemoryPlan {
+    unsigned long lines = 0; // alignment lines read
+    unsigned long lowIdentity = 0; // of those, lines skipped because of --minIdent
+    unsigned long records = 0; // AlignmentRecords after gap splitting, including the reverse ones
+    unsigned long blocks = 0; // blocks of all records
+    unsigned long maxBlockSize = 0;
+    unsigned long maxLocalStart = 0; // largest block start relative to the start of its record
+    unsigned long maxBlockCount = 0;
+    unsigned long sequences = 0;
+    unsigned long totalLength = 0; // length of the concatenated sequences
+    unsigned long recordBytes[3] = {0, 0, 0}; // heap bytes of all records with 2, 4 and 8 byte block values
+    std::vector<unsigned int> bucketSizes; // candidate bucket sizes
+    std::vector<unsigned long> bucketEntries; // alignment pointers stored in the buckets, per candidate
+
+    /* Returns the smallest block value width in bytes (2, 4 or 8) all records fit in */
+    unsigned int requiredBlockWidth() const;
+};
+
+class InputParser {
+    
+public:
+    /* Constructor */
+    InputParser();
+
+    /* Destructor */
+    ~InputParser();
+
+    InputParser(const InputParser &) = delete;
+    InputParser &operator=(const InputParser &) = delete;
+    
+    /* Parses command line arguments or prints help if none are given.
+     * With --inputNotPsl, throws std::runtime_error if a list file cannot be opened. */
+    void parseCmdArgs(int argc, char** &argv);
+    
+    /* Places in variables command line arguments parsed */
+    void getCmdLineArgs(std::vector<std::string> &pslPaths,
+            unsigned int &minLength, unsigned int &maxGap, unsigned int &minAlnLength,
+            float &minAlnIdentity, unsigned int &bucketSize, unsigned int &numThreads);
+    
+    /* Places in variables command line arguments parsed, except for pslPaths */
+    void getCmdLineArgs(unsigned int &minLength, unsigned int &maxGap,
+            unsigned int &minAlnLength, float &minAlnIdentity,
+            unsigned int &bucketSize, unsigned int &numThreads);
+
+    /* Sets the options that filter and split alignments, instead of parsing them from the command line */
+    void setParseOptions(unsigned int maxGapLength, unsigned int minAlnLength, float minAlnIdentity);
+
+    /* Sets the psl files read by parsePsl, instead of parsing them from the command line */
+    void setPslPaths(const std::vector<std::string> &pslPaths);
+
+    /* Places in variables the checkpoint related command line arguments parsed */
+    void getCheckpointArgs(std::string &checkpointDir, unsigned int &checkpointEvery,
+            unsigned int &checkpointMinutes, bool &resume);
+
+    /* Places in variables the shard related command line arguments parsed */
+    void getShardArgs(std::string &shardDir, unsigned int &numShards,
+            bool &shardWorker, unsigned int &shardIdx);
+
+    /* Places in variables whether the coordinator starts the shard workers itself
+     * and how many seconds the shard processes wait for a silent peer (0: forever) */
+    void getShardSpawnArgs(bool &spawnShards, unsigned int &shardTimeout);
+
+    /* Returns the command line of shard worker k of this coordinator: the same arguments without those
+     * of the coordinator's output, checkpoints and cache, followed by --shardWorker k */
+    std::vector<std::string> shardWorkerArgs(unsigned int k) const;
+
+    /* Places in variables the memory related command line arguments parsed */
+    void getScratchArgs(bool &scratchArena);
+
+    /* Places in variables whether positions may be compact (unsigned int) if the input is short enough */
+    void getCoordinateArgs(bool &compactCoordinates);
+
+    /* Places in variables the kernel variant asked for: auto, scalar, avx2 or avx512 */
+    void getKernelArgs(std::string &kernels);
+
+    /* Places in variables the IMP stopping criteria parsed */
+    void getStopArgs(unsigned int &maxIterations, float &convergenceFraction);
+
+    /* Places in variables whether memory and threads are placed on the NUMA nodes and huge pages are advised */
+    void getNumaArgs(bool &numa, bool &hugePages);
+
+    /* Places in variables the classification related command line arguments parsed */
+    void getClassifyArgs(bool &reuseMappings);
+
+    /* Places in variables the output file path (empty for STDOUT) and format (tsv, binary or compressed) parsed */
+    void getOutputArgs(std::string &outputPath, std::string &outputFormat);
+
+    /* Places in variables the directory of the result cache (empty if not given) */
+    void getCacheArgs(std::string &cacheDir);
+
+    /* Places in variables the socket path of server mode (empty if not given) and the number of concurrent requests */
+    void getServeArgs(std::string &servePath, unsigned int &serveWorkers);
+
+    /* Places in variables whether a parameter sweep was asked for and its minLength and minIdent (percent)
+     * values, sorted ascending. In a sweep the alignments are parsed at the lowest minIdent. */
+    void getSweepArgs(bool &sweep, std::vector<unsigned int> &minLengths, std::vector<unsigned int> &minIdents);
+
+    /* Places in variables the metrics file path parsed (empty if not given) */
+    void getMetricsArgs(std::string &metricsPath);
+
+    /* Places in variables whether the memory held by each structure is printed after each phase */
+    void getMemReportArgs(bool &memReport);
+
+    /* Places in variables the memory limit of the out-of-core mode in bytes (0 if not given)
+     * and the directory for its alignment store */
+    void getStoreArgs(unsigned long &maxMemory, std::string &storeDir);
+
+    /* Returns a hash of the input files (paths, sizes and modification times)
+     * and of all parameters that influence the result */
+    unsigned long inputFingerprint() const;
+
+    /* Returns a hash of the contents and sizes of the input files (not their paths or modification times,
+     * so copies match) and of all parameters that influence the written result, including the output
+     * format and stopping criteria. Reads every input file once. */
+    unsigned long resultFingerprint() const;
+
+    /* Reads a psl file. 
+    Each line is parsed to an AlignmentRecord. Pointers to all records are stored in result.
+    Result is sorted by the alignment's starting position in the target sequence.
+    If store is given, the records are handed to it in batches instead and result stays empty.
+    Throws std::runtime_error if a file cannot be opened and std::invalid_argument on a malformed line. */
+    void parsePsl(std::map<std::string, unsigned long>& speciesStart,
+            std::deque<AlignmentRecord *>& result, AlignmentStore *store = nullptr);
+    
+    /* Parses one psl line (without line break) like parsePsl and adds its records to records.
+     * Returns the number of records added, throws std::invalid_argument if the line is malformed. */
+    unsigned long parsePslLine(const std::string &pslLine, std::deque<AlignmentRecord *>& records,
+            std::map<std::string, unsigned long>& speciesStart);
+
+    /* Reads the next alignment of a psl stream into aln, skipping comments and empty lines.
+     * Returns false at the end of the stream. Alignments are not filtered.
+     * Throws std::invalid_argument on a malformed line. */
+    bool readPslAlignment(std::istream &pslFile, PslAlignment &aln);
+
+    /* Adds the records of an alignment given in memory, filtered and split like a psl line.
+     * Returns the number of records added, throws std::invalid_argument if the alignment is malformed. */
+    unsigned long addAlignment(std::deque<AlignmentRecord *>& records,
+            std::map<std::string, unsigned long>& speciesStart, const PslAlignment &aln);
+
+    /* Scans the psl files with numThreads threads without building AlignmentRecords and predicts
+     * the records parsePsl would create and the memory of the buckets for each of bucketSizes.
+     * Bucket entries are counted in sequence coordinates, so they can be off by one per record
+     * from the concatenated coordinates fillBuckets uses. Throws std::runtime_error if a file cannot be opened. */
+    void planMemory(const std::vector<unsigned int> &bucketSizes, MemoryPlan &plan);
+
+private:
+    std::vector<std::string> pslPaths;
+    unsigned int minLength;
+    unsigned int maxGapLength;
+    unsigned int minAlnLength;
+    float minAlnIdentity;
+    unsigned int bucketSize;
+    unsigned int numThreads;
+    bool printZeroLines;
+    bool inputNotPsl;
+    std::string checkpointDir;
+    unsigned int checkpointEvery;
+    unsigned int checkpointMinutes;
+    bool resume;
+    std::string shardDir;
+    unsigned int numShards;
+    bool shardWorker;
+    unsigned int shardIdx;
+    bool spawnShards;
+    unsigned int shardTimeout;
+    std::vector<std::string> cmdArgs; // the command line as given
+    int pslPathArgs; // number of input paths at the start of cmdArgs, after the program
+    bool scratchArena;
+    std::string kernelVariant;
+    std::string metricsPath;
+    bool memReport;
+    unsigned long maxMemory;
+    std::string storeDir;
+    unsigned int maxIterations;
+    float convergenceFraction;
+    bool compactCoordinates;
+    bool numa;
+    bool hugePages;
+    bool reuseMappings;
+    std::string outputPath;
+    std::string outputFormat;
+    std::string cacheDir;
+    std::string servePath;
+    unsigned int serveWorkers;
+    bool sweep;
+    std::vector<unsigned int> sweepMinLengths;
+    std::vector<unsigned int> sweepMinIdents;
+    
+    // We suppose psl lines won't be longer than that
+    static const unsigned int MAX_LINE = 32768;
+    
+    // Used during parse
+    std::unique_ptr<char[]> line; // current line, MAX_LINE chars allocated on first use
+    unsigned int pos; // position in current line
+    unsigned int lineLength; // length of current line, the field readers do not read past it
+    std::vector<unsigned long> numbers; // subfields of getIntArrayField before narrowing
+    unsigned long line_num; // current line number
+    std::vector<unsigned long> zeroBlockLines; // lines containing blocks of size 0
+    std::map<std::string, unsigned long> sequenceSizes; // size of each sequence, alignments must agree on it
+    
+
+    /* Parses a single psl line to alignment records (original and reverse,
+     * sometimes split) and add them to records vector, returns the number of
+     * records added */
+    unsigned long recordsFromPsl(std::deque<AlignmentRecord *>& records,             
+            std::map<std::string, unsigned long>& speciesStart);
+
+    /* Reads the next psl line that is not a comment into line, returns false at the end of the stream */
+    bool nextPslLine(std::istream &pslFile);
+
+    /* Reads the fields of the current line after repMatches into aln */
+    void getRemainingFields(PslAlignment &aln);
+
+    /* Throws std::invalid_argument for a malformed line or alignment, the callers add where it is */
+    [[noreturn]] static void malformed(const std::string &reason);
+
+    /* Throws if the strand, the coordinates or the blocks of aln do not fit its sequences */
+    static void checkAlignment(const PslAlignment &aln);
+
+    /* Adds the records of an alignment that passed the identity filter, aln is modified */
+    unsigned long recordsFromAlignment(std::deque<AlignmentRecord *>& records,
+            std::map<std::string, unsigned long>& speciesStart, PslAlignment &aln);
+
+    /* Returns true if the alignment's identity reaches minAlnIdentity */
+    inline bool passesIdentity(const PslAlignment &aln) const;
+
+    /* Plans the records of the psl line [p, end) the way recordsFromPsl creates them, see planMemory.
+     * Throws std::invalid_argument if the line is malformed. */
+    static void planPslLine(const char *p, const char *end, float minAlnIdentity, unsigned int maxGapLength,
+            unsigned int minAlnLength, MemoryPlan &plan, std::map<std::string, unsigned long> &sequences);
+
+    /* The filter and split steps of recordsFromAlignment, which planPslLine shares so that the memory plan
+     * counts the records parsing creates */
+
+    /* Returns true if matches (with repMatches) reach minAlnIdentity of all aligned bases */
+    static inline bool identityPasses(unsigned long matches, unsigned long mismatches, float minAlnIdentity);
+
+    /* Removes blocks of size 0, returns true if there were any */
+    static bool removeZeroBlocks(std::vector<unsigned int> &blockSizes,
+            std::vector<unsigned long> &qStarts, std::vector<unsigned long> &tStarts);
+
+    /* Adds the sequence offsets to the block starts. On the reverse strand the query starts, which count
+     * from the end of the query, become the ends of the blocks on the forward strand. */
+    static void shiftBlockStarts(char strand, unsigned long qSize, unsigned long qOffset, unsigned long tOffset,
+            std::vector<unsigned long> &qStarts, std::vector<unsigned long> &tStarts);
+
+    /* Splits the alignment at gaps longer than maxGapLength and calls part(first, last) with the first and
+     * last block of every part whose target is longer than minAlnLength */
+    template <typename Part>
+    static void forEachAlignmentPart(char strand, const std::vector<unsigned int> &blockSizes,
+            const std::vector<unsigned long> &qStarts, const std::vector<unsigned long> &tStarts,
+            unsigned int maxGapLength, unsigned int minAlnLength, Part part);
+    
+    /* The field readers below throw via malformed if the field does not end where expected */
+
+    /* Reads a string field  */
+    inline std::string getStringField();
+
+    /* Reads and returns a long field value (we assume no sign, just digits) */
+    inline unsigned long getLongField();
+
+    /* Reads and returns an int field value (we assume no sign, just digits) */
+    inline unsigned int getIntField();
+
+    /* Checks that an array field ended after its subfields and moves past its end */
+    inline void endArrayField();
+
+    /* Reads and returns an integer vector from a field composed by a set of int subfields separated and ending by comma + \t */
+    inline std::vector<unsigned int> getIntArrayField(unsigned int numberOfSubfields);
+
+    /* Reads and returns an integer vector from a field composed by a set of long subfields separated and ending by comma + \t */
+    inline std::vector<unsigned long> getLongArrayField(unsigned int numberOfSubfields);
+
+    /* Advances in line skipping a number of fields */
+    inline void skipFields(unsigned int numberOfFields);
+
+    /* Check if sequences in current line were already read. If not, add with its related offset.
+     * Returns the offset, throws if size differs from the size of the sequence in earlier alignments. */
+    inline unsigned long updateSpeciesStart(std::map<std::string, unsigned long>& speciesStart,
+            const std::string &name, unsigned long size);
+
+    /* Adds record and reverse to vector and setup sym pointers and identity */
+    inline void setupSymAndAdd(std::deque<AlignmentRecord *>& records, AlignmentRecord *rec, float identity);
+    
+    /* Prints to stderr message about lines that have removed blocks of size 0 */
+    void printZeroBlockInfo(void);
+    
+    /* For each file in pslPaths read that file and get the psl paths inside it,
+     * then replace the strings in pslPaths with the actual psl paths */
+    void readPslPaths(void);
+};
+
+
+/* InputParser inline methods */
+
+inline bool InputParser::passesIdentity(const PslAlignment &aln) const {
+        return identityPasses(static_cast<unsigned long>(aln.matches) + aln.repMatches, aln.mismatches, minAlnIdentity);
+}
+
+inline bool InputParser::identityPasses(unsigned long matches, unsigned long mismatches, float minAlnIdentity) {
+        if (matches == 0) return false;
+        return static_cast<float>(matches) / static_cast<float>(matches + mismatches) >= minAlnIdentity;
+}
+
+inline std::string InputParser::getStringField() {
+        std::string str;
+        str.reserve(16); // should be enough in most cases
+        while (line[pos] != '\t' && line[pos] != '\0')
+            str.push_back(line[pos++]);
+        if (str.empty() || line[pos] != '\t') malformed("missing sequence name");
+        ++pos; // move to after \t
+        return str;
+}
+
+inline unsigned long InputParser::getLongField() {
+        const unsigned int start = pos;
+        unsigned long v = 0;
+        while (line[pos] >= '0' && line[pos] <= '9') {
+            v *= 10;
+            v += line[pos++] - '0';
+        }
+        if (pos == start || line[pos] != '\t') malformed("field is not a number");
+        ++pos; // move to after \t
+        return v;
+}
+
+inline unsigned int InputParser::getIntField() {
+        const unsigned int start = pos;
+        unsigned int v = 0;
+        while (line[pos] >= '0' && line[pos] <= '9') {
+            v *= 10;
+            v += line[pos++] - '0';
+        }
+        if (pos == start || line[pos] != '\t') malformed("field is not a number");
+        ++pos; // move to after \t
+        return v;
+}
+
+inline void InputParser::endArrayField() {
+        // with fewer subfields the kernel runs into the next field, with more it stops within the field
+        if (pos > lineLength || (line[pos] != '\t' && line[pos] != '\0' && line[pos] != '\r'))
+            malformed("block list does not have blockCount entries");
+        ++pos; // move to after \t (or \0 if this is the last field)
+}
+
+inline std::vector<unsigned int> InputParser::getIntArrayField(unsigned int numberOfSubfields) {
+        numbers.resize(numberOfSubfields);
+        pos = kernels.parseNumbers(line.get() + pos, line.get() + lineLength + 1, numberOfSubfields, numbers.data()) - line.get();
+        endArrayField();
+        return std::vector<unsigned int>(numbers.begin(), numbers.end());
+}
+
+inline std::vector<unsigned long> InputParser::getLongArrayField(unsigned int numberOfSubfields) {
+        std::vector<unsigned long> values(numberOfSubfields);
+        pos = kernels.parseNumbers(line.get() + pos, line.get() + lineLength + 1, numberOfSubfields, values.data()) - line.get();
+        endArrayField();
+        return values;
+}
+
+inline void InputParser::skipFields(unsigned int numberOfFields) {
+        for (unsigned int skipped = 0; skipped < numberOfFields; ++pos) {
+            if (line[pos] == '\t')
+                ++skipped;
+            else if (line[pos] == '\0')
+                malformed("too few fields");
+        }
+}
+
+inline unsigned long InputParser::updateSpeciesStart(std::map<std::string, unsigned long>& speciesStart,
+        const std::string &name, unsigned long size) {
+        auto known = speciesStart.find(name);
+        if (known != speciesStart.end()) {
+            auto sized = sequenceSizes.find(name);
+            if (sized != sequenceSizes.end() && sized->second != size)
+                malformed("size " + std::to_string(size) + " of " + name + " differs from earlier alignments ("
+                    + std::to_string(sized->second) + ")");
+            return known->second;
+        }
+        auto last = speciesStart.find("$");
+        auto curLen = last->second;
+        speciesStart.insert(std::pair<std::string, unsigned long>(name, curLen));
+        sequenceSizes[name] = size;
+        last->second = curLen + size;
+        return curLen;
+}
+
+inline void InputParser::setupSymAndAdd(std::deque<AlignmentRecord *>& records, AlignmentRecord *rec, float identity) {
+        rec->identity = identity;
+        AlignmentRecord *rev = rec->revert();
+        rec->sym = rev;
+        rev->sym = rec;
+        records.push_back(rec);
+        records.push_back(rev);
+}
+
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cstddef>
+
+#include "Kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+// the variants are compiled for their instruction set only, the rest of the binary stays baseline
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw,popcnt")))
+#endif
+
+static_assert(sizeof(WasteRegion) == 2 * sizeof(unsigned long) && offsetof(WasteRegion, first) == 0,
+	"the region kernels load first and last of consecutive regions as pairs of 64 bit lanes");
+
+/* Scalar variants, also used for the ends the vector variants leave over */
+
+static unsigned int upperBoundBlocksScalar(const block_local_t *values, unsigned int n, block_local_t key) {
+	return std::upper_bound(values, values + n, key) - values;
+}
+
+static unsigned int upperBoundRegionsScalar(const WasteRegion *regions, unsigned int n, unsigned long x) {
+	return std::upper_bound(regions, regions + n, x,
+		[](unsigned long x, const WasteRegion &region) { return x < region.first; }) - regions;
+}
+
+static const char *parseNumbersScalar(const char *p, const char *end, unsigned int n, unsigned long *out) {
+	for (unsigned int i = 0; i < n; i++) {
+		if (p >= end) { // malformed input, the caller checks the returned position
+			std::fill(out + i, out + n, 0UL);
+			return end;
+		}
+		unsigned long v = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+			v = v * 10 + (*p++ - '0');
+		out[i] = v;
+		++p; // move past the separator
+	}
+	return p;
+}
+
+static size_t uniqueRegionsScalar(Region *regions, size_t n) {
+	return std::unique(regions, regions + n) - regions;
+}
+
+#ifdef KERNELS_X86
+
+/* Narrows [first, first + n) of a sorted array by binary search until at most window elements are left,
+so the vector loops only count within the window. Elements before first are all not greater than key. */
+template <typename Greater>
+static inline void narrow(unsigned int &first, unsigned int &n, unsigned int window, Greater greater) {
+	while (n > window) {
+		unsigned int half = n / 2;
+		if (greater(first + half)) n = half;
+		else {
+			first += half + 1;
+			n -= half + 1;
+		}
+	}
+}
+
+/* Shuffle masks moving the first length bytes of a 16 byte vector to its end and zeroing the others,
+so numbers of any length line up with the place values of the digit kernel */
+struct AlignRightMasks {
+	alignas(16) unsigned char masks[17][16];
+	AlignRightMasks() {
+		for (unsigned int length = 0; length <= 16; length++)
+			for (unsigned int j = 0; j < 16; j++)
+				masks[length][j] = (j >= 16 - length) ? j - (16 - length) : 0x80;
+	}
+};
+static const AlignRightMasks alignRight;
+
+#if BLOCKS_SIZE == BLOCKS_USHORT
+TARGET_AVX2 static unsigned int upperBoundBlocksAvx2(const block_local_t *values, unsigned int n, block_local_t key) {
+	unsigned int first = 0;
+	narrow(first, n, 64, [&](unsigned int i) { return values[i] > key; });
+	const unsigned int end = first + n;
+	const __m256i k = _mm256_set1_epi16(static_cast<short>(key));
+	unsigned int count = first, i = first;
+	for (; i + 16 <= end; i += 16) { // v <= key if min(v, key) == v, unsigned
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+		count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_min_epu16(v, k), v))) / 2;
+	}
+	for (; i < end; i++)
+		count += values[i] <= key;
+	return count;
+}
+
+TARGET_AVX512 static unsigned int upperBoundBlocksAvx512(const block_local_t *values, unsigned int n, block_local_t key) {
+	unsigned int first = 0;
+	narrow(first, n, 128, [&](unsigned int i) { return values[i] > key; });
+	const unsigned int end = first + n;
+	const __m512i k = _mm512_set1_epi16(static_cast<short>(key));
+	unsigned int count = first;
+	for (unsigned int i = first; i < end; i += 32) { // the last load is masked to the values left
+		__mmask32 lanes = (end - i >= 32) ? 0xffffffffU : (1U << (end - i)) - 1;
+		__m512i v = _mm512_maskz_loadu_epi16(lanes, values + i);
+		count += __builtin_popcount(_mm512_mask_cmple_epu16_mask(lanes, v, k));
+	}
+	return count;
+}
+#else // the vector variants are written for 16 bit blocks
+#define upperBoundBlocksAvx2 upperBoundBlocksScalar
+#define upperBoundBlocksAvx512 upperBoundBlocksScalar
+#endif
+
+TARGET_AVX2 static unsigned int upperBoundRegionsAvx2(const WasteRegion *regions, unsigned int n, unsigned long x) {
+	unsigned int first = 0;
+	narrow(first, n, 16, [&](unsigned int i) { return regions[i].first > x; });
+	const unsigned int end = first + n;
+	// AVX2 only compares signed 64 bit lanes, flipping the sign bit makes that an unsigned comparison
+	const __m256i bias = _mm256_set1_epi64x(static_cast<long long>(1ULL << 63));
+	const __m256i key = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(x)), bias);
+	unsigned int count = first, i = first;
+	for (; i + 4 <= end; i += 4) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(regions + i)); // first, last of i and i + 1
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(regions + i + 2));
+		__m256i firsts = _mm256_xor_si256(_mm256_unpacklo_epi64(a, b), bias);
+		count += 4 - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(firsts, key))));
+	}
+	for (; i < end; i++)
+		count += regions[i].first <= x;
+	return count;
+}
+
+TARGET_AVX512 static unsigned int upperBoundRegionsAvx512(const WasteRegion *regions, unsigned int n, unsigned long x) {
+	unsigned int first = 0;
+	narrow(first, n, 16, [&](unsigned int i) { return regions[i].first > x; });
+	const unsigned int end = first + n;
+	const __m512i key = _mm512_set1_epi64(static_cast<long long>(x));
+	unsigned int count = first;
+	for (unsigned int i = first; i < end; i += 4) { // four regions per vector, first in the even lanes
+		__mmask8 lanes = (end - i >= 4) ? 0xff : (1U << (2 * (end - i))) - 1;
+		__m512i v = _mm512_maskz_loadu_epi64(lanes, regions + i);
+		count += __builtin_popcount(_mm512_mask_cmple_epu64_mask(lanes & 0x55, v, key));
+	}
+	return count;
+}
+
+TARGET_AVX2 static const char *parseNumbersAvx2(const char *p, const char *end, unsigned int n, unsigned long *out) {
+	const __m128i zero = _mm_set1_epi8('0'), nine = _mm_set1_epi8(9);
+	const __m128i tens = _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+	const __m128i hundreds = _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1);
+	const __m128i tenThousands = _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1);
+	for (unsigned int i = 0; i < n; i++) {
+		if (end - p < 16) return parseNumbersScalar(p, end, n - i, out + i);
+		__m128i digits = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), zero);
+		unsigned int isDigit = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(digits, nine), digits));
+		unsigned int length = __builtin_ctz(~isDigit); // leading digits, at most 16
+		if (length == 16) { // longer than the kernel handles
+			p = parseNumbersScalar(p, end, 1, out + i);
+			continue;
+		}
+		// right align the digits, then combine pairs, quadruples and octuples by their place values
+		digits = _mm_shuffle_epi8(digits, _mm_load_si128(reinterpret_cast<const __m128i *>(alignRight.masks[length])));
+		__m128i pairs = _mm_maddubs_epi16(digits, tens);
+		__m128i quads = _mm_madd_epi16(pairs, hundreds);
+		__m128i octs = _mm_madd_epi16(_mm_packus_epi32(quads, quads), tenThousands);
+		out[i] = static_cast<unsigned long>(_mm_cvtsi128_si32(octs)) * 100000000UL
+			+ static_cast<unsigned int>(_mm_extract_epi32(octs, 1));
+		p += length + 1; // move past the separator
+	}
+	return p;
+}
+
+TARGET_AVX2 static size_t uniqueRegionsAvx2(Region *regions, size_t n) {
+	if (n < 2) return n;
+	// compacting in place is safe, a position is only overwritten by its own or a later region
+	size_t out = 1, i = 1;
+	for (; i + 2 <= n; i += 2) { // compare regions i, i + 1 to i - 1, i in both lanes
+		__m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(regions + i));
+		__m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(regions + i - 1));
+		unsigned int equal = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(cur, prev)));
+		if ((equal & 0x3) != 0x3) regions[out++] = regions[i];
+		if ((equal & 0xc) != 0xc) regions[out++] = regions[i + 1];
+	}
+	for (; i < n; i++)
+		if (!(regions[i] == regions[i - 1])) regions[out++] = regions[i];
+	return out;
+}
+
+TARGET_AVX512 static size_t uniqueRegionsAvx512(Region *regions, size_t n) {
+	if (n < 2) return n;
+	size_t out = 1, i = 1;
+	for (; i + 4 <= n; i += 4) { // compare regions i..i + 3 to i - 1..i + 2 and compress the others to out
+		__m512i cur = _mm512_loadu_si512(regions + i);
+		__m512i prev = _mm512_loadu_si512(regions + i - 1);
+		unsigned int equal = _mm512_cmpeq_epi64_mask(cur, prev);
+		unsigned int keep = ~(equal & (equal >> 1)) & 0x55; // a region is a duplicate if both its lanes are equal
+		keep |= keep << 1;
+		_mm512_mask_compressstoreu_epi64(regions + out, keep, cur);
+		out += __builtin_popcount(keep) / 2;
+	}
+	for (; i < n; i++)
+		if (!(regions[i] == regions[i - 1])) regions[out++] = regions[i];
+	return out;
+}
+
+#endif // KERNELS_X86
+
+static const Kernels variants[] = {
+	{"scalar", upperBoundBlocksScalar, upperBoundRegionsScalar, parseNumbersScalar, uniqueRegionsScalar},
+#ifdef KERNELS_X86
+	{"avx2", upperBoundBlocksAvx2, upperBoundRegionsAvx2, parseNumbersAvx2, uniqueRegionsAvx2},
+	// parsing gains nothing from wider vectors, a number rarely has more than 16 digits
+	{"avx512", upperBoundBlocksAvx512, upperBoundRegionsAvx512, parseNumbersAvx2, uniqueRegionsAvx512},
+#endif
+};
+
+Kernels kernels = {"scalar", upperBoundBlocksScalar, upperBoundRegionsScalar, parseNumbersScalar, uniqueRegionsScalar};
+
+/* Returns true if the CPU (and the OS, for the vector registers) supports the variant */
+static bool cpuSupports(const std::string &name) {
+	if (name == "scalar") return true;
+#ifdef KERNELS_X86
+	__builtin_cpu_init();
+	if (name == "avx2")
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+	if (name == "avx512")
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("popcnt");
+#endif
+	return false;
+}
+
+std::vector<std::string> supportedKernels() {
+	std::vector<std::string> names;
+	for (auto &variant : variants)
+		if (cpuSupports(variant.name)) names.push_back(variant.name);
+	return names;
+}
+
+bool selectKernels(const std::string &name) {
+	std::string chosen = (name == "auto") ? supportedKernels().back() : name;
+	if (!cpuSupports(chosen)) return false;
+	for (auto &variant : variants)
+		if (chosen == variant.name) {
+			kernels = variant;
+			return true;
+		}
+	return false;
+}
+
+static const bool autoSelected = selectKernels("auto"); // before main, --kernels may change it
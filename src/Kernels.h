@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "AlignmentRecord.h"
+
+/* The hot loops of parsing, block and region search and interval deduplication in a scalar, an AVX2
+and an AVX-512 variant. The binary is built for baseline x86-64, so at startup the best variant the
+CPU supports is selected through CPUID; --kernels forces one for testing and benchmarking.
+All variants return the same results. */
+struct Kernels {
+	const char *name;
+
+	/* Returns the number of values[0..n), sorted ascending, that are not greater than key (std::upper_bound) */
+	unsigned int (*upperBoundBlocks)(const block_local_t *values, unsigned int n, block_local_t key);
+
+	/* Returns the number of regions[0..n), sorted by first, whose first is not greater than x */
+	unsigned int (*upperBoundRegions)(const WasteRegion *regions, unsigned int n, unsigned long x);
+
+	/* Parses n numbers (only digits) starting at p, each followed by one separator, into out and
+	 * returns the position after the last separator. Variants may read ahead up to end, not past it.
+	 * If the numbers run into end, the rest of out is 0 and end is returned. */
+	const char *(*parseNumbers)(const char *p, const char *end, unsigned int n, unsigned long *out);
+
+	/* Removes consecutive duplicates of regions[0..n) like std::unique and returns the new size */
+	size_t (*uniqueRegions)(Region *regions, size_t n);
+};
+
+/* The selected kernels, all calls go through this table */
+extern Kernels kernels;
+
+/* Selects the kernels by name: auto (the best supported), scalar, avx2 or avx512.
+ * Returns false if the name is unknown or the CPU does not support the variant. */
+bool selectKernels(const std::string &name);
+
+/* Returns the names of the variants the CPU supports, scalar first */
+std::vector<std::string> supportedKernels();
@@ -0,0 +1,205 @@
+#include <iostream>
+#include <stdexcept>
+
+#include "LibAtomizer.h"
+#include "Breakpoints.h"
+#include "Classify.h"
+#include "Util.h"
+
+bool runAtomizer(std::deque<AlignmentRecord *> &alignments, const std::map<std::string, unsigned long> &speciesStarts,
+	const AtomizerOptions &options, const AtomizerContext &context,
+	const std::chrono::time_point<std::chrono::high_resolution_clock> start, AtomizerResult &result) {
+	if (context.store && context.store->isEnabled()) // the buckets of each window are filled when it is loaded
+		return atomizeBuckets(alignments, std::vector<std::vector<AlignmentRecord *>>(), speciesStarts, options,
+			context, start, result);
+	if (context.metrics) context.metrics->startPhase("fillBuckets");
+	Numa noNuma(false, false);
+	const Numa &numa = context.numa ? *context.numa : noNuma;
+	numa.pinThreads(options.numThreads); // before the buckets are touched by the threads reading them
+	std::vector<std::vector<AlignmentRecord *>> buckets;
+	numa.fillBuckets(alignments, speciesStarts.find("$")->second, options.bucketSize,
+		options.numThreads, buckets);
+	std::cerr << "INFO: Filled " << buckets.size() << " buckets.";
+	shoutTime(start);
+	if (context.memReport) {
+		context.memReport->setBuckets(buckets);
+		context.memReport->print("fillBuckets");
+	}
+	return atomizeBuckets(alignments, buckets, speciesStarts, options, context, start, result);
+}
+
+/* Moves the waste regions in from to to */
+static void moveRegions(std::vector<WasteRegion> &from, std::vector<WasteRegion> &to) {
+	to.swap(from);
+	from.clear();
+}
+
+/* Moves the waste regions in from to to, converting their positions, which must fit */
+template <typename from_t, typename to_t>
+static void moveRegions(std::vector<BasicWasteRegion<from_t>> &from, std::vector<BasicWasteRegion<to_t>> &to) {
+	to.clear();
+	to.reserve(from.size());
+	for (auto &region : from)
+		to.push_back(BasicWasteRegion<to_t>(region));
+	std::vector<BasicWasteRegion<from_t>>().swap(from);
+}
+
+/* Creates the initial waste regions and runs the IMP iterations on positions of type coord_t,
+leaving the waste regions in result */
+template <typename coord_t>
+static void runIMP(const std::deque<AlignmentRecord *> &alignments, const std::vector<std::vector<AlignmentRecord *>> &buckets,
+	const std::vector<unsigned long> &speciesBoundaries, unsigned long totalLength, double epsilon,
+	const AtomizerOptions &options, const AtomizerContext &context, Checkpoint &checkpoint, Shard &shard,
+	const AlignmentStore &store, Metrics &metrics, MemReport &memReport, const Numa &numa,
+	const std::chrono::time_point<std::chrono::high_resolution_clock> start, AtomizerResult &result, AtomMappings &mappings) {
+	std::vector<BasicBreakpoint<coord_t>> breakPoints;
+	std::vector<BasicWasteRegion<coord_t>> wasteRegions;
+	std::vector<BasicRegion<coord_t>> protoAtoms;
+	if (context.resume && checkpoint.load(totalLength, result.wasteRegions, result.iterations)) {
+		moveRegions(result.wasteRegions, wasteRegions);
+		atomsFromWaste(wasteRegions, protoAtoms);
+		std::cerr << "INFO: Resumed " << wasteRegions.size() << " waste regions from checkpoint of IMP iteration "
+			<< result.iterations << ".";
+	} else if (store.isEnabled()) {
+		store.createWaste(speciesBoundaries, options.minLength, result.wasteRegions);
+		moveRegions(result.wasteRegions, wasteRegions);
+		atomsFromWaste(wasteRegions, protoAtoms);
+		std::cerr << "INFO: Created " << wasteRegions.size() << " initial waste regions from the stored alignments.";
+	} else {
+		numa.reserve(breakPoints, speciesBoundaries.size() + 2 * alignments.size());
+		initBreakpoints(alignments, speciesBoundaries, breakPoints);
+		numa.reserve(wasteRegions, breakPoints.size());
+		createWaste(breakPoints, options.minLength, wasteRegions);
+		numa.reserve(protoAtoms, wasteRegions.size());
+		atomsFromWaste(wasteRegions, protoAtoms);
+		std::cerr << "INFO: Created " << wasteRegions.size() << " initial waste regions from initial breakpoints.";
+	}
+	shoutTime(start);
+	memReport.setRegions(breakPoints, wasteRegions, protoAtoms);
+	memReport.print("breakpoints");
+	metrics.startPhase("IMP");
+	result.stopReason = IMP(protoAtoms, wasteRegions, buckets, options.bucketSize, options.minLength, epsilon, start,
+		options.numThreads, result.iterations, options.maxIterations, options.convergenceFraction,
+		checkpoint, shard, store, metrics, options.reuseMappings ? &mappings : nullptr);
+	shard.finish();
+	memReport.setRegions(breakPoints, wasteRegions, protoAtoms);
+	memReport.setIMP(mappings);
+	memReport.print("IMP");
+	moveRegions(wasteRegions, result.wasteRegions);
+}
+
+bool atomizeBuckets(const std::deque<AlignmentRecord *> &alignments, const std::vector<std::vector<AlignmentRecord *>> &buckets,
+	const std::map<std::string, unsigned long> &speciesStarts, const AtomizerOptions &options, const AtomizerContext &context,
+	const std::chrono::time_point<std::chrono::high_resolution_clock> start, AtomizerResult &result) {
+	// disabled stand-ins for the collaborators not given
+	Checkpoint noCheckpoint("", 0, 0, 0);
+	Shard noShard("", 0, 0);
+	AlignmentStore noStore("", 0, options.bucketSize);
+	Metrics noMetrics("");
+	MemReport noMemReport(false);
+	Numa noNuma(false, false);
+	Checkpoint &checkpoint = context.checkpoint ? *context.checkpoint : noCheckpoint;
+	Shard &shard = context.shard ? *context.shard : noShard;
+	AlignmentStore &store = context.store ? *context.store : noStore;
+	Metrics &metrics = context.metrics ? *context.metrics : noMetrics;
+	MemReport &memReport = context.memReport ? *context.memReport : noMemReport;
+	const Numa &numa = context.numa ? *context.numa : noNuma;
+	const unsigned long totalLength = speciesStarts.find("$")->second;
+	const unsigned int bucketSize = options.bucketSize;
+
+	std::vector<unsigned long> speciesBoundaries; // contains starting positions in concatenated sequence
+	for (auto i : speciesStarts) speciesBoundaries.push_back(i.second);
+	result.speciesStarts = speciesStarts;
+	result.alignmentCount = store.isEnabled() ? store.getRecordCount() : alignments.size();
+	result.wasteRegions.clear();
+
+	const double epsilon = 1 / (static_cast<double>(bucketSize)*(totalLength / bucketSize + 1));
+	shard.setTotalLength(totalLength);
+	if (context.shardWorker) { // worker processes only compute new waste regions for the coordinator
+		metrics.startPhase("shardWorker");
+		shard.runWorker(context.shardIdx, buckets, bucketSize, options.minLength, epsilon, options.numThreads);
+		metrics.endPhase();
+		return false;
+	}
+	shard.startCoordinator();
+	metrics.startPhase("breakpoints");
+	result.iterations = 0;
+	checkpoint.setTotalLength(totalLength);
+	AtomMappings mappings;
+	// positions fit into unsigned int for most inputs, shards and the store exchange unsigned long ones
+	if (options.compactCoordinates && fitsCompact(totalLength) && !shard.isEnabled() && !store.isEnabled())
+		runIMP<unsigned int>(alignments, buckets, speciesBoundaries, totalLength, epsilon, options, context,
+			checkpoint, shard, store, metrics, memReport, numa, start, result, mappings);
+	else
+		runIMP<unsigned long>(alignments, buckets, speciesBoundaries, totalLength, epsilon, options, context,
+			checkpoint, shard, store, metrics, memReport, numa, start, result, mappings);
+	metrics.startPhase("classify");
+	if (options.reuseMappings && !mappings.valid)
+		std::cerr << "INFO: IMP did not converge, classification searches the covering alignments again." << std::endl;
+	size_t voteBytes;
+	classify(result.wasteRegions, buckets, bucketSize, options.minAlnIdentity, options.numThreads,
+		options.reuseMappings ? &mappings : nullptr, store, result.classes, result.classCount, voteBytes);
+	std::cerr << "Put " << result.wasteRegions.size() - 1 << " atoms in " << result.classCount << " classes.";
+	shoutTime(start);
+	memReport.setClassification(result.classes, result.wasteRegions.size() - 1, voteBytes);
+	memReport.print("classify");
+	return true;
+}
+
+void selectRecords(const std::deque<AlignmentRecord *> &alignments, float minAlnIdentity,
+	std::deque<AlignmentRecord *> &selected) {
+	for (auto rec : alignments)
+		if (rec->identity >= minAlnIdentity)
+			selected.push_back(rec);
+}
+
+/* Runs the pipeline on the records in alignments, deletes them and fills the atom coordinates of result */
+static void atomizeRecords(std::deque<AlignmentRecord *> &alignments, const std::map<std::string, unsigned long> &speciesStarts,
+	const AtomizerOptions &options, const std::chrono::time_point<std::chrono::high_resolution_clock> start,
+	AtomizerResult &result) {
+	try {
+		runAtomizer(alignments, speciesStarts, options, AtomizerContext(), start, result);
+	} catch (...) {
+		for (auto aln : alignments)
+			delete aln;
+		throw;
+	}
+	for (auto aln : alignments)
+		delete aln;
+	atomCoordinates(result.wasteRegions, result.speciesStarts, result.sequenceNames, result.atomSequence,
+		result.atomStart, result.atomEnd);
+}
+
+void atomize(const std::vector<PslAlignment> &alignments, const AtomizerOptions &options, AtomizerResult &result) {
+	auto start = std::chrono::high_resolution_clock::now();
+	InputParser parser;
+	parser.setParseOptions(options.maxGapLength, options.minAlnLength, options.minAlnIdentity);
+	std::map<std::string, unsigned long> speciesStarts = { {"$", 0} };
+	std::deque<AlignmentRecord *> records;
+	try {
+		for (auto &aln : alignments)
+			parser.addAlignment(records, speciesStarts, aln);
+	} catch (...) {
+		for (auto aln : records)
+			delete aln;
+		throw;
+	}
+	atomizeRecords(records, speciesStarts, options, start, result);
+}
+
+void atomizePsl(const std::vector<std::string> &pslPaths, const AtomizerOptions &options, AtomizerResult &result) {
+	auto start = std::chrono::high_resolution_clock::now();
+	InputParser parser;
+	parser.setParseOptions(options.maxGapLength, options.minAlnLength, options.minAlnIdentity);
+	parser.setPslPaths(pslPaths);
+	std::map<std::string, unsigned long> speciesStarts = { {"$", 0} };
+	std::deque<AlignmentRecord *> records;
+	try {
+		parser.parsePsl(speciesStarts, records);
+	} catch (...) {
+		for (auto aln : records)
+			delete aln;
+		throw;
+	}
+	atomizeRecords(records, speciesStarts, options, start, result);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <chrono>
+#include "AlignmentRecord.h"
+#include "InputParser.h"
+#include "IMP.h"
+#include "Checkpoint.h"
+#include "Shard.h"
+#include "AlignmentStore.h"
+#include "Metrics.h"
+#include "MemReport.h"
+#include "Numa.h"
+
+/* C++ API of libatomizer: runs the pipeline fillBuckets -> initBreakpoints -> IMP -> classify
+ * on alignments read from psl files or given in memory. The atomizer binary is a wrapper around it.
+ * Errors are thrown as exceptions (std::runtime_error for unreadable files and failed shards or stores),
+ * the library does not exit the process. */
+
+/* Options of a run, the defaults are those of the command line */
+struct AtomizerOptions {
+	unsigned int minLength = 250;
+	float minAlnIdentity = 0.8f;
+	unsigned int maxGapLength = 13;
+	unsigned int minAlnLength = 13;
+	unsigned int bucketSize = 1000;
+	unsigned int numThreads = 1;
+	unsigned int maxIterations = 0; // 0 for no limit
+	float convergenceFraction = 0.0f; // 0 to iterate until no atom changes
+	bool compactCoordinates = true; // unsigned int positions in breakpoints and IMP if the input is short enough
+	bool reuseMappings = false;
+};
+
+/* Optional collaborators of a run, the defaults disable checkpoints, shards, the alignment store, metrics,
+ * memory reports and NUMA placement */
+struct AtomizerContext {
+	Checkpoint *checkpoint = nullptr;
+	Shard *shard = nullptr;
+	AlignmentStore *store = nullptr; // if enabled, the alignments were parsed into it instead of the deque
+	Metrics *metrics = nullptr;
+	MemReport *memReport = nullptr;
+	Numa *numa = nullptr; // pins the threads and places the buckets, the caller interleaves before parsing
+	bool resume = false; // continue from the checkpoint if it matches
+	bool shardWorker = false; // only compute the shard shardIdx for a coordinator
+	unsigned int shardIdx = 0;
+};
+
+/* Result of a run. Atom i lies between wasteRegions[i] and wasteRegions[i + 1],
+ * its class is |classes[i]| and its strand the sign of classes[i]. */
+struct AtomizerResult {
+	std::map<std::string, unsigned long> speciesStarts; // start of each sequence in the concatenation, "$" is the end
+	std::vector<WasteRegion> wasteRegions;
+	std::vector<int> classes;
+	int classCount = 0;
+	IMPStopReason stopReason = IMP_CONVERGED;
+	unsigned int iterations = 0;
+	unsigned long alignmentCount = 0; // records after filtering and splitting, including the reverse ones
+
+	// atoms in sequence coordinates, the rows of the result table, filled by atomize
+	std::vector<std::string> sequenceNames;
+	std::vector<unsigned int> atomSequence; // index into sequenceNames
+	std::vector<unsigned long> atomStart;
+	std::vector<unsigned long> atomEnd;
+};
+
+/* Runs the pipeline on parsed alignments, which are sorted in place. speciesStarts must be
+ * the map the alignments were parsed with. Returns false if the run was a shard worker and has no result.
+ * Progress is reported to stderr with times relative to start. */
+bool runAtomizer(std::deque<AlignmentRecord *> &alignments, const std::map<std::string, unsigned long> &speciesStarts,
+	const AtomizerOptions &options, const AtomizerContext &context,
+	const std::chrono::time_point<std::chrono::high_resolution_clock> start, AtomizerResult &result);
+
+/* Runs the pipeline after fillBuckets on buckets filled with alignments, which are only read,
+so several runs can share them. Returns false if the run was a shard worker and has no result. */
+bool atomizeBuckets(const std::deque<AlignmentRecord *> &alignments, const std::vector<std::vector<AlignmentRecord *>> &buckets,
+	const std::map<std::string, unsigned long> &speciesStarts, const AtomizerOptions &options, const AtomizerContext &context,
+	const std::chrono::time_point<std::chrono::high_resolution_clock> start, AtomizerResult &result);
+
+/* Appends the records of alignments with an identity of at least minAlnIdentity to selected, so that
+alignments parsed at a lower identity can be reused without parsing again. A record and its reverse
+are selected together. */
+void selectRecords(const std::deque<AlignmentRecord *> &alignments, float minAlnIdentity,
+	std::deque<AlignmentRecord *> &selected);
+
+/* Runs atomizer on alignments given in memory and fills all fields of result */
+void atomize(const std::vector<PslAlignment> &alignments, const AtomizerOptions &options, AtomizerResult &result);
+
+/* Runs atomizer on psl files and fills all fields of result */
+void atomizePsl(const std::vector<std::string> &pslPaths, const AtomizerOptions &options, AtomizerResult &result);
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+#include "MemReport.h"
+#include "Metrics.h"
+#include "Scratch.h"
+#include "Util.h"
+
+/* Returns the bytes of the heap block of a vector of capacity elements of elementSize bytes */
+static unsigned long vectorBytes(size_t capacity, size_t elementSize) {
+	return capacity ? mallocBytes(capacity * elementSize) : 0;
+}
+
+/* Returns bytes as a short human readable string */
+static std::string humanBytes(unsigned long bytes) {
+	std::ostringstream out;
+	if (bytes >= (1UL << 30)) out << std::fixed << std::setprecision(2) << bytes / double(1UL << 30) << " GB";
+	else if (bytes >= (1UL << 20)) out << std::fixed << std::setprecision(2) << bytes / double(1UL << 20) << " MB";
+	else out << std::fixed << std::setprecision(1) << bytes / 1024.0 << " KB";
+	return out.str();
+}
+
+void MemReport::set(const std::string &name, unsigned long bytes, const std::string &note) {
+	for (auto &entry : entries)
+		if (entry.name == name) {
+			entry.bytes = bytes;
+			entry.note = note;
+			return;
+		}
+	entries.push_back({name, bytes, note});
+}
+
+void MemReport::setRecords(const std::deque<AlignmentRecord *> &alignments) {
+	if (!enabled) return;
+	unsigned long headers = 0, blocks = 0, paired = 0;
+	for (auto rec : alignments) {
+		unsigned long recordBytes = mallocBytes(sizeof(AlignmentRecord));
+		unsigned long blockBytes = 3 * mallocBytes(rec->blockCount * sizeof(block_local_t));
+		headers += recordBytes;
+		blocks += blockBytes;
+		if (rec->sym) paired += recordBytes + blockBytes;
+	}
+	set("record headers", headers, std::to_string(alignments.size()) + " records of " + std::to_string(sizeof(AlignmentRecord)) + " bytes");
+	set("record block arrays", blocks, std::to_string(sizeof(block_local_t)) + " bytes per value, 3 arrays per record");
+	set("record pointers", (alignments.size() * sizeof(AlignmentRecord *) + 511) / 512 * 512,
+		"reverse (sym) copies hold " + humanBytes(paired / 2) + " of the records");
+}
+
+void MemReport::setBuckets(const std::vector<std::vector<AlignmentRecord *>> &buckets) {
+	if (!enabled) return;
+	unsigned long bytes = vectorBytes(buckets.capacity(), sizeof(buckets[0])), entries = 0, slack = 0;
+	for (auto &bucket : buckets) {
+		bytes += vectorBytes(bucket.capacity(), sizeof(AlignmentRecord *));
+		entries += bucket.size();
+		slack += (bucket.capacity() - bucket.size()) * sizeof(AlignmentRecord *);
+	}
+	set("bucket vectors", bytes, std::to_string(buckets.size()) + " buckets, " + std::to_string(entries)
+		+ " entries, capacity slack " + humanBytes(slack));
+}
+
+template <typename coord_t>
+void MemReport::setRegions(const std::vector<BasicBreakpoint<coord_t>> &breakpoints,
+	const std::vector<BasicWasteRegion<coord_t>> &wasteRegions, const std::vector<BasicRegion<coord_t>> &atoms) {
+	if (!enabled) return;
+	std::string positions = " of " + std::to_string(sizeof(coord_t)) + " byte positions";
+	set("breakpoints", vectorBytes(breakpoints.capacity(), sizeof(breakpoints[0])), std::to_string(breakpoints.size()) + " breakpoints" + positions);
+	set("waste regions", vectorBytes(wasteRegions.capacity(), sizeof(wasteRegions[0])), std::to_string(wasteRegions.size()) + " regions" + positions);
+	set("atoms", vectorBytes(atoms.capacity(), sizeof(atoms[0])), std::to_string(atoms.size()) + " atoms" + positions);
+}
+
+template void MemReport::setRegions(const std::vector<Breakpoint>&, const std::vector<WasteRegion>&, const std::vector<Region>&);
+template void MemReport::setRegions(const std::vector<CompactBreakpoint>&, const std::vector<CompactWasteRegion>&,
+	const std::vector<CompactRegion>&);
+
+void MemReport::setIMP(const AtomMappings &mappings) {
+	if (!enabled) return;
+	if (!mappings.offsets.empty())
+		set("atom mappings", vectorBytes(mappings.offsets.capacity(), sizeof(size_t))
+			+ vectorBytes(mappings.mappings.capacity(), sizeof(AtomMapping)), std::to_string(mappings.mappings.size()) + " mappings");
+	set("IMP scratch arenas", scratchHeldBytes(), "per-thread memory of the per-atom interval vectors and DP maps");
+}
+
+void MemReport::setClassification(const std::vector<int> &classes, size_t nrAtoms, size_t voteBytes) {
+	if (!enabled) return;
+	set("classes", vectorBytes(classes.capacity(), sizeof(int)), std::to_string(classes.size()) + " atoms");
+	// parent, parity and rank of the union-find, the class of each root and the strand votes, freed by classify
+	set("classification graph", vectorBytes(nrAtoms, sizeof(unsigned int)) + 2 * vectorBytes(nrAtoms, 1)
+		+ vectorBytes(nrAtoms, sizeof(int)) + voteBytes, "peak during classify, freed since");
+}
+
+void MemReport::print(const std::string &phase) const {
+	if (!enabled) return;
+	unsigned long total = 0;
+	std::ostringstream out;
+	out << "INFO: Memory after " << phase << ":\n";
+	for (auto &entry : entries) {
+		total += entry.bytes;
+		out << "  " << std::left << std::setw(22) << entry.name << std::right << std::setw(14) << entry.bytes
+			<< " bytes (" << humanBytes(entry.bytes) << ")";
+		if (!entry.note.empty()) out << ", " << entry.note;
+		out << "\n";
+	}
+	out << "  " << std::left << std::setw(22) << "total" << std::right << std::setw(14) << total << " bytes ("
+		<< humanBytes(total) << "), peak RSS " << Metrics::peakRssKb() << " KB\n";
+	std::cerr << out.str() << std::flush;
+}
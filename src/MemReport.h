@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include "AlignmentRecord.h"
+#include "IMP.h"
+
+/* Accounts the bytes held by the main data structures and prints them after each phase
+together with the peak RSS (see --memReport). Sizes are computed from element counts and capacities,
+heap blocks are rounded up like glibc malloc does. If disabled, nothing is computed or printed. */
+class MemReport {
+
+public:
+    /* Constructor */
+    MemReport(bool enabled) : enabled(enabled) {};
+
+    /* Returns true if --memReport was given */
+    bool isEnabled() const { return enabled; };
+
+    /* Accounts the record headers, block arrays and the record pointers of alignments */
+    void setRecords(const std::deque<AlignmentRecord *> &alignments);
+
+    /* Accounts the bucket vectors including their capacity slack */
+    void setBuckets(const std::vector<std::vector<AlignmentRecord *>> &buckets);
+
+    /* Accounts the breakpoints, waste regions and atoms of unsigned long or compact positions */
+    template <typename coord_t>
+    void setRegions(const std::vector<BasicBreakpoint<coord_t>> &breakpoints,
+            const std::vector<BasicWasteRegion<coord_t>> &wasteRegions, const std::vector<BasicRegion<coord_t>> &atoms);
+
+    /* Accounts the atom mappings kept for classification and the scratch arenas of the IMP iterations */
+    void setIMP(const AtomMappings &mappings);
+
+    /* Accounts the classes and the union-find of the classification graph over nrAtoms atoms and the
+     * peak voteBytes of its strand votes, which classify frees when it returns */
+    void setClassification(const std::vector<int> &classes, size_t nrAtoms, size_t voteBytes);
+
+    /* Prints all structures accounted so far and the peak RSS to stderr */
+    void print(const std::string &phase) const;
+
+private:
+    struct Entry {
+        std::string name;
+        unsigned long bytes;
+        std::string note;
+    };
+
+    bool enabled;
+    std::vector<Entry> entries; // in order of first accounting
+
+    /* Sets the bytes of structure name, adding it if it is new */
+    void set(const std::string &name, unsigned long bytes, const std::string &note = "");
+};
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <fstream>
+#include <sys/resource.h>
+
+#include "Metrics.h"
+
+Metrics::Metrics(const std::string &path)
+	: path(path), inPhase(false), phaseCpuStart(0.0), iterationCpuStart(0.0) {}
+
+void Metrics::setParameter(const std::string &name, double value) {
+	if (!isEnabled()) return;
+	parameters.push_back(std::make_pair(name, value));
+}
+
+void Metrics::startPhase(const std::string &name) {
+	if (!isEnabled()) return;
+	endPhase();
+	phases.push_back({name, 0.0, 0.0, 0});
+	inPhase = true;
+	phaseStart = std::chrono::steady_clock::now();
+	phaseCpuStart = cpuMs();
+}
+
+void Metrics::endPhase() {
+	if (!isEnabled() || !inPhase) return;
+	std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - phaseStart;
+	phases.back().wallMs = wall.count();
+	phases.back().cpuMs = cpuMs() - phaseCpuStart;
+	phases.back().peakRssKb = peakRssKb();
+	inPhase = false;
+}
+
+void Metrics::startIteration() {
+	if (!isEnabled()) return;
+	iterationStart = std::chrono::steady_clock::now();
+	iterationCpuStart = cpuMs();
+}
+
+void Metrics::endIteration(unsigned int iteration, const IMPCounters &counters, unsigned long wasteRegions) {
+	if (!isEnabled()) return;
+	std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - iterationStart;
+	iterations.push_back({iteration, wall.count(), cpuMs() - iterationCpuStart, counters, wasteRegions});
+}
+
+void Metrics::write() const {
+	if (!isEnabled()) return;
+	std::ofstream out(path);
+	if (!out.is_open()) {
+		std::cerr << "ERROR: metrics file could not be opened: " << path << std::endl;
+		return;
+	}
+	out << "{\n  \"parameters\": {";
+	for (size_t i = 0; i < parameters.size(); i++)
+		out << (i ? ", " : "") << "\"" << parameters[i].first << "\": " << parameters[i].second;
+	out << "},\n  \"phases\": [";
+	for (size_t i = 0; i < phases.size(); i++)
+		out << (i ? "," : "") << "\n    {\"name\": \"" << phases[i].name << "\", \"wall_ms\": " << phases[i].wallMs
+			<< ", \"cpu_ms\": " << phases[i].cpuMs << ", \"peak_rss_kb\": " << phases[i].peakRssKb << "}";
+	out << "\n  ],\n  \"imp_iterations\": [";
+	for (size_t i = 0; i < iterations.size(); i++) {
+		const Iteration &it = iterations[i];
+		out << (i ? "," : "") << "\n    {\"iteration\": " << it.iteration
+			<< ", \"wall_ms\": " << it.wallMs << ", \"cpu_ms\": " << it.cpuMs
+			<< ", \"atoms\": " << it.counters.atoms
+			<< ", \"alignments_scanned\": " << it.counters.alnsScanned
+			<< ", \"alignments_covering\": " << it.counters.alnsCovering
+			<< ", \"waste_regions_mapped\": " << it.counters.wasteMapped
+			<< ", \"dp_positions\": " << it.counters.dpPositions
+			<< ", \"waste_regions\": " << it.wasteRegions << "}";
+	}
+	out << "\n  ],\n  \"peak_rss_kb\": " << peakRssKb() << "\n}\n";
+}
+
+unsigned long Metrics::peakRssKb() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss; // kilobytes on Linux
+}
+
+double Metrics::cpuMs() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0
+		+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+/* Work counters of one IMP iteration */
+struct IMPCounters {
+	unsigned long atoms = 0; // atoms processed
+	unsigned long alnsScanned = 0; // alignments found in the buckets of the atoms
+	unsigned long alnsCovering = 0; // of those, alignments covering the atom
+	unsigned long wasteMapped = 0; // waste regions mapped back to an atom
+	unsigned long dpPositions = 0; // positions evaluated by the dynamic programming
+};
+
+/* Collects wall and CPU time and the peak RSS reached by the end of the program phases, the times of each
+IMP iteration, and writes them together with the peak RSS of the run as JSON (see --metrics).
+If no path is given, nothing is measured or written. */
+class Metrics {
+
+public:
+    /* Constructor. An empty path disables metrics. */
+    Metrics(const std::string &path);
+
+    /* Returns true if a metrics file was given */
+    bool isEnabled() const { return !path.empty(); };
+
+    /* Records a run parameter, written to the "parameters" object */
+    void setParameter(const std::string &name, double value);
+
+    /* Starts timing a phase, ending the previous one */
+    void startPhase(const std::string &name);
+
+    /* Ends timing the current phase */
+    void endPhase();
+
+    /* Starts timing an IMP iteration */
+    void startIteration();
+
+    /* Ends timing an IMP iteration and records its counters and resulting number of waste regions */
+    void endIteration(unsigned int iteration, const IMPCounters &counters, unsigned long wasteRegions);
+
+    /* Writes all recorded metrics to the file */
+    void write() const;
+
+    /* Returns the peak resident set size of the process in kilobytes */
+    static unsigned long peakRssKb();
+
+private:
+    struct Timing {
+        std::string name;
+        double wallMs;
+        double cpuMs;
+        unsigned long peakRssKb; // peak RSS of the process at the end of the phase
+    };
+    struct Iteration {
+        unsigned int iteration;
+        double wallMs;
+        double cpuMs;
+        IMPCounters counters;
+        unsigned long wasteRegions;
+    };
+
+    std::string path;
+    std::vector<std::pair<std::string, double>> parameters;
+    std::vector<Timing> phases;
+    std::vector<Iteration> iterations;
+    bool inPhase;
+    std::chrono::time_point<std::chrono::steady_clock> phaseStart, iterationStart;
+    double phaseCpuStart, iterationCpuStart;
+
+    /* Returns CPU time (user + system) of the process in milliseconds */
+    static double cpuMs();
+};
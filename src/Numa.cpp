@@ -0,0 +1,136 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <omp.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+#include "Numa.h"
+#include "IMP.h"
+
+/* Returns the numbers of a sysfs list like "0-3,8-11" */
+static std::vector<int> parseList(const std::string &list) {
+	std::vector<int> result;
+	std::istringstream items(list);
+	std::string item;
+	while (std::getline(items, item, ',')) {
+		if (item.empty()) continue;
+		size_t dash = item.find('-');
+		int first = std::stoi(item.substr(0, dash));
+		int last = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+		for (int i = first; i <= last; i++)
+			result.push_back(i);
+	}
+	return result;
+}
+
+/* Returns the first line of a file, empty if it cannot be read */
+static std::string readLine(const std::string &path) {
+	std::ifstream in(path);
+	std::string line;
+	std::getline(in, line);
+	return line;
+}
+
+Numa::Numa(bool enabled, bool hugePages) : enabled(enabled), hugePages(hugePages) {
+	if (!enabled && !hugePages) return;
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	for (int node : parseList(readLine("/sys/devices/system/node/online"))) {
+		std::vector<int> cpus;
+		for (int cpu : parseList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+			if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+		if (cpus.empty()) continue; // memory only node or excluded by the affinity mask
+		nodes.push_back(node);
+		nodeCpus.push_back(cpus);
+	}
+	if (nodes.empty()) { // no sysfs, all allowed CPUs on one node
+		nodes.push_back(0);
+		nodeCpus.emplace_back();
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &allowed)) nodeCpus.back().push_back(cpu);
+	}
+	if (hugePages && readLine("/sys/kernel/mm/transparent_hugepage/enabled").find("[never]") != std::string::npos)
+		std::cerr << "WARNING: Transparent huge pages are disabled on this system, --hugePages has no effect." << std::endl;
+#else // e.g. macOS (MakefileMac), which has no memory policies, affinity masks or transparent huge pages
+	std::cerr << "WARNING: --numa and --hugePages need Linux, they have no effect on this system." << std::endl;
+	this->enabled = this->hugePages = false;
+#endif
+}
+
+std::string Numa::summary() const {
+	std::ostringstream out;
+	size_t cpus = 0;
+	for (auto &node : nodeCpus)
+		cpus += node.size();
+	out << nodes.size() << " NUMA node(s) with " << cpus << " CPUs";
+	if (enabled) out << ", interleaved shared arrays, first touch buckets, pinned threads";
+	if (hugePages) out << ", huge pages for arrays of at least " << (HUGE_PAGE_MIN >> 20) << " MB";
+	return out.str();
+}
+
+void Numa::interleave() const {
+	if (!enabled || nodes.size() < 2) return;
+#ifdef __linux__
+	std::vector<unsigned long> mask(nodes.back() / 64 + 1, 0);
+	for (int node : nodes)
+		mask[node / 64] |= 1UL << (node % 64);
+	if (syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask.data(), mask.size() * 64 + 1) != 0)
+		std::cerr << "WARNING: Memory could not be interleaved over the NUMA nodes." << std::endl;
+#endif
+}
+
+void Numa::local() const {
+	if (!enabled || nodes.size() < 2) return;
+#ifdef __linux__
+	syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+#endif
+}
+
+void Numa::pinThreads(unsigned int numThreads) const {
+	if (!enabled) return;
+#ifdef __linux__
+	#pragma omp parallel num_threads(numThreads)
+	{
+		size_t t = omp_get_thread_num(), n = omp_get_num_threads(), k = nodes.size();
+		size_t node = t * k / n;
+		size_t firstThread = (node * n + k - 1) / k; // first t with t * k / n == node
+		const std::vector<int> &cpus = nodeCpus[node];
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpus[(t - firstThread) % cpus.size()], &set);
+		sched_setaffinity(0, sizeof(set), &set); // 0 is the calling thread
+	}
+#endif
+}
+
+void Numa::adviseHugePages(const void *p, size_t bytes) const {
+	if (!hugePages || bytes < HUGE_PAGE_MIN) return;
+#ifdef __linux__
+	const unsigned long pageSize = sysconf(_SC_PAGESIZE);
+	unsigned long first = (reinterpret_cast<unsigned long>(p) + pageSize - 1) / pageSize * pageSize;
+	unsigned long last = (reinterpret_cast<unsigned long>(p) + bytes) / pageSize * pageSize;
+	if (first < last)
+		madvise(reinterpret_cast<void *>(first), last - first, MADV_HUGEPAGE);
+#endif
+}
+
+void Numa::fillBuckets(std::deque<AlignmentRecord *> &alns, unsigned long totalLength, unsigned int bucketSize,
+	unsigned int numThreads, std::vector<std::vector<AlignmentRecord *>> &buckets) const {
+	reserve(buckets, totalLength / bucketSize + 1);
+	buckets.resize(totalLength / bucketSize + 1);
+	if (!enabled) {
+		::fillBuckets(alns, bucketSize, buckets);
+		return;
+	}
+	local(); // the main thread's share of the buckets goes to its own node as well
+	fillBucketsFirstTouch(alns, bucketSize, numThreads, buckets);
+	interleave();
+}
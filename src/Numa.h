@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include "AlignmentRecord.h"
+
+/* Placement of memory and threads on machines with several NUMA nodes (sockets), see --numa and --hugePages.
+With numa, the pages the main thread allocates are interleaved over the nodes, so the alignment records and
+waste regions, which every IMP thread reads, are spread over all memory controllers. The OpenMP threads are
+pinned, filling the nodes one after the other, and the buckets are allocated by the threads that read them
+in the IMP iterations (first touch). With hugePages, large arrays are backed by transparent huge pages.
+Uses the Linux system calls directly, no libnuma. If disabled, the methods do nothing or the plain thing.
+On other systems both are disabled with a warning. */
+class Numa {
+
+public:
+    /* Constructor, reads the nodes and the CPUs the process may run on from sysfs */
+    Numa(bool enabled, bool hugePages);
+
+    /* Returns true if --numa was given */
+    bool isEnabled() const { return enabled; };
+
+    /* Returns a one line description of the nodes, pinning and huge pages */
+    std::string summary() const;
+
+    /* Interleaves the pages the calling thread allocates from now on over all nodes */
+    void interleave() const;
+
+    /* Allocates the pages the calling thread touches from now on on its own node (the default policy) */
+    void local() const;
+
+    /* Pins the threads of OpenMP parallel regions of numThreads threads, thread t to one CPU of node
+     * t * nodes / numThreads, so consecutive threads, which process consecutive atoms, share a node.
+     * Threads created later inherit the CPU of their creator, so all parallel regions should use numThreads. */
+    void pinThreads(unsigned int numThreads) const;
+
+    /* Advises transparent huge pages for [p, p + bytes) if --hugePages was given and the range is large */
+    void adviseHugePages(const void *p, size_t bytes) const;
+
+    /* Reserves n elements in v with huge pages advised before the memory is touched, if --hugePages was given */
+    template <typename T>
+    void reserve(std::vector<T> &v, size_t n) const {
+        if (!hugePages || v.capacity() >= n) return;
+        v.reserve(n);
+        adviseHugePages(v.data(), n * sizeof(T));
+    };
+
+    /* Creates the buckets of a concatenated sequence of totalLength and fills them like fillBuckets.
+     * If enabled, each bucket is allocated by the pinned thread that processes its atoms in the IMP iterations
+     * (see fillBucketsFirstTouch). */
+    void fillBuckets(std::deque<AlignmentRecord *> &alns, unsigned long totalLength, unsigned int bucketSize,
+            unsigned int numThreads, std::vector<std::vector<AlignmentRecord *>> &buckets) const;
+
+private:
+    bool enabled;
+    bool hugePages;
+    std::vector<int> nodes; // nodes the process may run on
+    std::vector<std::vector<int>> nodeCpus; // allowed CPUs of each of nodes
+
+    static const size_t HUGE_PAGE_MIN = 32UL << 20; // smaller arrays are not worth a huge page
+};
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ResultCache.h"
+#include "Segmentation.h"
+#include "Util.h"
+
+ResultCache::ResultCache(const std::string &dir, unsigned long fingerprint) : dir(dir) {
+	if (dir.empty()) return;
+	if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+		std::cerr << "ERROR: Cache directory could not be created: " << dir << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	uint32_t version = SEGMENTATION_VERSION;
+	unsigned long program = programFingerprint();
+	unsigned long h = fnv1a(&version, sizeof(version), fingerprint);
+	char key[17];
+	snprintf(key, sizeof(key), "%016lx", fnv1a(&program, sizeof(program), h));
+	entry = dir + "/" + key + ".result";
+}
+
+unsigned long ResultCache::programFingerprint() {
+	unsigned long h = fnv1a(nullptr, 0);
+	FILE *exe = fopen("/proc/self/exe", "rb");
+	if (exe == nullptr) { // no procfs (macOS), the build time of this file stands in for the program
+		static const char built[] = __DATE__ " " __TIME__;
+		return fnv1a(built, sizeof(built), h);
+	}
+	std::vector<char> buffer(1 << 20);
+	size_t n;
+	while ((n = fread(buffer.data(), 1, buffer.size(), exe)) > 0)
+		h = fnv1a(buffer.data(), n, h);
+	fclose(exe);
+	return h;
+}
+
+bool ResultCache::fetch(FILE *out) const {
+	if (!isEnabled()) return false;
+	FILE *in = fopen(entry.c_str(), "rb"); // stays readable even if a concurrent run renames over the entry
+	if (in == nullptr) return false;
+	std::vector<char> buffer(1 << 20);
+	size_t n;
+	bool ok = true;
+	while (ok && (n = fread(buffer.data(), 1, buffer.size(), in)) > 0)
+		ok = fwrite(buffer.data(), 1, n, out) == n;
+	ok = ok && !ferror(in) && fflush(out) == 0;
+	fclose(in);
+	if (!ok) { // part of the result may have been written already
+		std::cerr << "ERROR: Writing the cached result failed: " << entry << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return true;
+}
+
+FILE *ResultCache::create() {
+	if (!isEnabled()) return nullptr;
+	std::string pattern = entry + ".XXXXXX";
+	std::vector<char> name(pattern.c_str(), pattern.c_str() + pattern.size() + 1);
+	int fd = mkstemp(name.data()); // unique even between hosts sharing dir
+	if (fd < 0) return nullptr;
+	tmpPath = name.data();
+	FILE *tmp = fdopen(fd, "wb");
+	if (tmp == nullptr) {
+		close(fd);
+		std::remove(tmpPath.c_str());
+	}
+	return tmp;
+}
+
+bool ResultCache::commit(FILE *tmp) {
+	bool ok = fflush(tmp) == 0 && fsync(fileno(tmp)) == 0; // the data is on disk before the entry appears
+	ok = fclose(tmp) == 0 && ok;
+	if (ok) chmod(tmpPath.c_str(), 0644); // mkstemp creates the file readable by the owner only
+	ok = ok && std::rename(tmpPath.c_str(), entry.c_str()) == 0;
+	if (!ok) std::remove(tmpPath.c_str());
+	return ok;
+}
+
+void ResultCache::discard(FILE *tmp) {
+	fclose(tmp);
+	std::remove(tmpPath.c_str());
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <cstdio>
+
+/* Content-addressed cache of written results (--cacheDir), so reruns with identical input files and
+parameters skip the computation. An entry is the output file as written (TSV or segmentation), named
+after the hash of the input file contents, all parameters that influence the output and the output format
+(see InputParser::resultFingerprint), the segmentation format version and the contents of the running
+executable, so a rebuilt atomizer never takes the entries of another build. The directory may be shared by concurrent runs, also on a shared
+filesystem: entries are written to unique temporary files, synced and renamed into place, so readers see
+either no entry or a complete one, and runs racing for the same entry write identical bytes. */
+class ResultCache {
+
+public:
+    /* Constructor. An empty dir disables the cache, otherwise dir is created if missing. */
+    ResultCache(const std::string &dir, unsigned long fingerprint);
+
+    /* Returns true if a cache directory was given */
+    bool isEnabled() const { return !dir.empty(); };
+
+    /* Copies the entry of this run to out. Returns false if there is none, exits if copying fails. */
+    bool fetch(FILE *out) const;
+
+    /* Opens a new temporary file in dir for the result of this run, nullptr if it cannot be created */
+    FILE *create();
+
+    /* Completes the file returned by create: flushes, syncs and closes it and renames it to the entry.
+     * Returns false on I/O errors, the temporary file is removed in either case. */
+    bool commit(FILE *tmp);
+
+    /* Closes and removes the file returned by create without storing it */
+    void discard(FILE *tmp);
+
+private:
+    std::string dir;
+    std::string entry; // path of the entry of this run
+    std::string tmpPath; // path of the file returned by create
+
+    /* Returns the hash of the running executable */
+    static unsigned long programFingerprint();
+};
@@ -0,0 +1,97 @@
+#include <iostream>
+#include <atomic>
+#include <new>
+#include <cstdint>
+
+#include "Scratch.h"
+
+bool ScratchArena::enabled = true;
+
+// statistics of all arenas, updated on reset
+static std::atomic<unsigned long> totalAllocations(0);
+static std::atomic<unsigned long> totalBytes(0);
+static std::atomic<unsigned long> totalHeapAllocations(0);
+static std::atomic<unsigned long> totalResets(0);
+static std::atomic<unsigned long> peakUsed(0);
+static std::atomic<unsigned long> heldBytes(0); // chunks of all arenas, kept up to date
+
+ScratchArena::ScratchArena()
+	: next(0), cur(nullptr), end(nullptr), allocations(0), bytes(0), heapAllocations(0), used(0) {}
+
+ScratchArena::~ScratchArena() {
+	for (auto &chunk : chunks) {
+		heldBytes -= chunk.size;
+		::operator delete(chunk.data);
+	}
+}
+
+void *ScratchArena::allocate(size_t size, size_t align) {
+	allocations++;
+	bytes += size;
+	if (!enabled) {
+		heapAllocations++;
+		return ::operator new(size);
+	}
+	uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+	while (cur == nullptr || p + size > reinterpret_cast<uintptr_t>(end)) {
+		if (next == chunks.size()) { // no spare chunk left, get a new one at least twice as big as the last
+			size_t chunkSize = chunks.empty() ? FIRST_CHUNK_SIZE : 2 * chunks.back().size;
+			while (chunkSize < size + align) chunkSize *= 2;
+			chunks.push_back({static_cast<char *>(::operator new(chunkSize)), chunkSize});
+			heldBytes += chunkSize;
+			heapAllocations++;
+		}
+		used += cur == nullptr ? 0 : end - cur; // rest of the current chunk is lost until reset
+		cur = chunks[next].data;
+		end = cur + chunks[next].size;
+		next++;
+		p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+	}
+	used += p + size - reinterpret_cast<uintptr_t>(cur);
+	cur = reinterpret_cast<char *>(p + size);
+	return reinterpret_cast<void *>(p);
+}
+
+void ScratchArena::deallocate(void *p, size_t size) {
+	if (!enabled)
+		::operator delete(p);
+}
+
+void ScratchArena::reset() {
+	next = 0;
+	cur = end = nullptr;
+	totalAllocations += allocations;
+	totalBytes += bytes;
+	totalHeapAllocations += heapAllocations;
+	totalResets++;
+	unsigned long peak = peakUsed.load();
+	while (used > peak && !peakUsed.compare_exchange_weak(peak, used))
+		;
+	allocations = bytes = heapAllocations = used = 0;
+}
+
+ScratchArena &ScratchArena::local() {
+	static thread_local ScratchArena arena;
+	return arena;
+}
+
+void resetScratchStats() {
+	totalAllocations = 0;
+	totalBytes = 0;
+	totalHeapAllocations = 0;
+	totalResets = 0;
+	peakUsed = 0;
+}
+
+void printScratchStats(const std::string &phase) {
+	std::cerr << "INFO: Scratch memory in " << phase << " (arenas " << (ScratchArena::enabled ? "on" : "off") << "): "
+		<< totalAllocations << " allocations of " << totalBytes / 1024 << " KB total for "
+		<< totalResets << " atoms, " << totalHeapAllocations << " of them from the global allocator";
+	if (ScratchArena::enabled)
+		std::cerr << ", peak arena use per atom " << peakUsed / 1024 << " KB";
+	std::cerr << "." << std::endl;
+}
+
+unsigned long scratchHeldBytes() {
+	return heldBytes;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <functional>
+
+/* Per-thread monotonic memory for the temporary containers of the IMP inner loop.
+Allocations are bumped from a list of chunks owned by the calling thread, deallocation is a no-op,
+and the whole arena is reset after each atom (see ScratchScope). Chunks are kept across resets,
+so after the first few atoms a thread does not touch the global allocator anymore. */
+class ScratchArena {
+
+public:
+    ScratchArena();
+    ~ScratchArena();
+
+    /* Returns memory for size bytes aligned to align */
+    void *allocate(size_t size, size_t align);
+
+    /* Only releases memory if arenas are disabled, otherwise memory is reclaimed by reset */
+    void deallocate(void *p, size_t size);
+
+    /* Makes all memory of the arena available again. All memory handed out before becomes invalid. */
+    void reset();
+
+    /* Returns the arena of the calling thread */
+    static ScratchArena &local();
+
+    /* If disabled, all allocations are passed to the global allocator (for comparison) */
+    static bool enabled;
+
+private:
+    struct Chunk {
+        char *data;
+        size_t size;
+    };
+    std::vector<Chunk> chunks;
+    size_t next; // index of the chunk to use when the current one is full
+    char *cur; // next free byte in the current chunk
+    char *end; // end of the current chunk
+    // statistics since the last reset, added to the global statistics by reset
+    unsigned long allocations;
+    unsigned long bytes;
+    unsigned long heapAllocations;
+    unsigned long used;
+
+    static const size_t FIRST_CHUNK_SIZE = 64 * 1024;
+};
+
+/* Resets the arena of the calling thread when it goes out of scope.
+Must be declared before the scratch containers it covers, so it is destroyed after them. */
+class ScratchScope {
+public:
+    ScratchScope() {};
+    ~ScratchScope() { ScratchArena::local().reset(); };
+};
+
+/* Stateless allocator using the arena of the calling thread */
+template <class T>
+struct ScratchAllocator {
+    typedef T value_type;
+
+    ScratchAllocator() noexcept {};
+    template <class U> ScratchAllocator(const ScratchAllocator<U> &) noexcept {};
+
+    T *allocate(size_t n)
+        { return static_cast<T *>(ScratchArena::local().allocate(n * sizeof(T), alignof(T))); };
+    void deallocate(T *p, size_t n) noexcept
+        { ScratchArena::local().deallocate(p, n * sizeof(T)); };
+};
+
+template <class T, class U>
+bool operator == (const ScratchAllocator<T> &, const ScratchAllocator<U> &) { return true; }
+template <class T, class U>
+bool operator != (const ScratchAllocator<T> &, const ScratchAllocator<U> &) { return false; }
+
+template <class T>
+using scratch_vector = std::vector<T, ScratchAllocator<T>>;
+template <class K, class V>
+using scratch_map = std::map<K, V, std::less<K>, ScratchAllocator<std::pair<const K, V>>>;
+template <class K>
+using scratch_set = std::set<K, std::less<K>, ScratchAllocator<K>>;
+
+/* Sets the statistics of all arenas to zero */
+void resetScratchStats();
+
+/* Prints the statistics of all arenas since the last resetScratchStats to stderr */
+void printScratchStats(const std::string &phase);
+
+/* Returns the bytes of the chunks all arenas currently hold */
+unsigned long scratchHeldBytes();
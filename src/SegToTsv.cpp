@@ -0,0 +1,40 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "Segmentation.h"
+
+/* Converts a binary segmentation (atomizer --outputFormat binary|compressed) back to the TSV result */
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: segToTsv <segmentation file>\n"
+                  << "Prints the segmentation as the tab separated table atomizer writes by default." << std::endl;
+        return argc == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    try {
+        SegmentationReader seg(argv[1]);
+        std::vector<std::string> names;
+        for (size_t i = 0; i < seg.sequenceCount(); i++)
+            names.push_back(seg.sequenceName(i));
+        std::string buf;
+        for (size_t i = 0; i < seg.commentCount(); i++)
+            buf += "#" + seg.comment(i) + "\n";
+        buf += "#name\tatom_nr\tclass\tstrand\tstart\tend\n";
+        for (size_t i = 0; i < seg.atomCount(); i++) {
+            const SegmentationAtom &atom = seg.atom(i);
+            buf += names[atom.sequence];
+            buf += "\t" + std::to_string(i + 1) + "\t" + std::to_string(std::abs(atom.classNr)) + "\t"
+                + (atom.classNr > 0 ? "+" : "-") + "\t" + std::to_string(atom.start) + "\t" + std::to_string(atom.end) + "\n";
+            if (buf.size() >= (1 << 20)) {
+                fwrite(buf.data(), 1, buf.size(), stdout);
+                buf.clear();
+            }
+        }
+        fwrite(buf.data(), 1, buf.size(), stdout);
+    } catch (const std::exception &e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+/* Binary segmentation format, written by atomizer --outputFormat binary|compressed.
+ * This header has no dependencies on the rest of atomizer, so other tools can include it to read results.
+ *
+ * Layout (native byte order, every section starts 8 byte aligned):
+ *   SegmentationHeader
+ *   SegmentationString[sequenceCount]   sequence names
+ *   SegmentationString[commentCount]    comment lines (without leading #)
+ *   char[stringBytes]                   blob the strings point into, padded to 8 bytes
+ *   atoms                               atomCount SegmentationAtom records, or if SEGMENTATION_COMPRESSED
+ *                                       is set, atomBytes bytes of varint deltas (see segmentationPutAtom)
+ * Atom i has atom_nr i + 1. The uncompressed atom records can be used in place from a mapped file. */
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char SEGMENTATION_MAGIC[8] = {'G', 'S', 'P', 'S', 'E', 'G', '\0', '\0'};
+static const uint32_t SEGMENTATION_VERSION = 1;
+static const uint32_t SEGMENTATION_COMPRESSED = 1; // flag: atoms are stored as varint deltas
+
+struct SegmentationHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t sequenceCount;
+	uint64_t commentCount;
+	uint64_t atomCount;
+	uint64_t stringBytes; // size of the string blob including padding
+	uint64_t atomBytes; // size of the atom section
+};
+
+/* A string in the blob */
+struct SegmentationString {
+	uint64_t offset;
+	uint64_t length;
+};
+
+/* One line of the TSV result. The sign of classNr is the strand. */
+struct SegmentationAtom {
+	uint64_t start;
+	uint64_t end;
+	uint32_t sequence; // index into the sequence names
+	int32_t classNr;
+};
+
+/* Appends x to buf as LEB128 varint */
+inline void segmentationPutVarint(std::string &buf, uint64_t x) {
+	while (x >= 0x80) {
+		buf.push_back(static_cast<char>((x & 0x7f) | 0x80));
+		x >>= 7;
+	}
+	buf.push_back(static_cast<char>(x));
+}
+
+/* Reads a LEB128 varint from [pos, end), returns false if the data ends before the varint does */
+inline bool segmentationGetVarint(const unsigned char *&pos, const unsigned char *end, uint64_t &x) {
+	x = 0;
+	for (unsigned int shift = 0; pos < end && shift < 64; shift += 7) {
+		unsigned char byte = *pos++;
+		x |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+inline uint64_t segmentationZigzag(int64_t x) { return (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63); }
+inline int64_t segmentationUnzigzag(uint64_t x) { return static_cast<int64_t>(x >> 1) ^ -static_cast<int64_t>(x & 1); }
+
+/* Appends atom in compressed form, prev is the previous atom (all zero for the first).
+Atoms are in coordinate order, so the sequence index only grows and starts within a sequence mostly do. */
+inline void segmentationPutAtom(std::string &buf, const SegmentationAtom &atom, const SegmentationAtom &prev) {
+	segmentationPutVarint(buf, atom.sequence - prev.sequence);
+	uint64_t base = (atom.sequence == prev.sequence) ? prev.start : 0;
+	segmentationPutVarint(buf, segmentationZigzag(static_cast<int64_t>(atom.start - base)));
+	segmentationPutVarint(buf, segmentationZigzag(static_cast<int64_t>(atom.end - atom.start)));
+	segmentationPutVarint(buf, segmentationZigzag(atom.classNr));
+}
+
+/* Reads a segmentation file. Uncompressed files are mapped, compressed ones are decoded into memory.
+Throws std::runtime_error if the file cannot be read or is not a valid segmentation. */
+class SegmentationReader {
+
+public:
+	explicit SegmentationReader(const std::string &path) : data(nullptr), size(0) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("Cannot open segmentation file: " + path);
+		struct stat st;
+		if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SegmentationHeader)) {
+			close(fd);
+			throw std::runtime_error("Not a segmentation file: " + path);
+		}
+		size = st.st_size;
+		void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mapped == MAP_FAILED) throw std::runtime_error("Cannot map segmentation file: " + path);
+		data = static_cast<const unsigned char *>(mapped);
+		try {
+			parse(path);
+		} catch (...) {
+			munmap(const_cast<unsigned char *>(data), size);
+			throw;
+		}
+	}
+
+	~SegmentationReader() { munmap(const_cast<unsigned char *>(data), size); }
+
+	SegmentationReader(const SegmentationReader &) = delete;
+	SegmentationReader &operator=(const SegmentationReader &) = delete;
+
+	size_t sequenceCount() const { return header.sequenceCount; }
+	std::string sequenceName(size_t i) const { return getString(sequences[i]); }
+	size_t commentCount() const { return header.commentCount; }
+	std::string comment(size_t i) const { return getString(comments[i]); }
+	size_t atomCount() const { return header.atomCount; }
+	const SegmentationAtom &atom(size_t i) const { return atoms[i]; }
+	const SegmentationAtom *begin() const { return atoms; }
+	const SegmentationAtom *end() const { return atoms + header.atomCount; }
+
+private:
+	const unsigned char *data;
+	size_t size;
+	SegmentationHeader header;
+	const SegmentationString *sequences;
+	const SegmentationString *comments;
+	const char *strings;
+	const SegmentationAtom *atoms;
+	std::vector<SegmentationAtom> decoded; // atoms of a compressed file
+
+	std::string getString(const SegmentationString &s) const { return std::string(strings + s.offset, s.length); }
+
+	void parse(const std::string &path) {
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, SEGMENTATION_MAGIC, sizeof(SEGMENTATION_MAGIC)) != 0
+			|| header.version != SEGMENTATION_VERSION)
+			throw std::runtime_error("Not a segmentation file of version " + std::to_string(SEGMENTATION_VERSION) + ": " + path);
+		size_t pos = sizeof(header);
+		size_t tableBytes = (header.sequenceCount + header.commentCount) * sizeof(SegmentationString);
+		if (header.sequenceCount > size || header.commentCount > size || header.stringBytes > size || header.atomBytes > size
+			|| pos + tableBytes + header.stringBytes + header.atomBytes != size)
+			throw std::runtime_error("Truncated segmentation file: " + path);
+		sequences = reinterpret_cast<const SegmentationString *>(data + pos);
+		comments = sequences + header.sequenceCount;
+		pos += tableBytes;
+		strings = reinterpret_cast<const char *>(data + pos);
+		for (size_t i = 0; i < header.sequenceCount + header.commentCount; i++)
+			if (sequences[i].offset > header.stringBytes || sequences[i].length > header.stringBytes - sequences[i].offset)
+				throw std::runtime_error("Corrupt string table in segmentation file: " + path);
+		pos += header.stringBytes;
+		if (!(header.flags & SEGMENTATION_COMPRESSED)) {
+			if (header.atomBytes != header.atomCount * sizeof(SegmentationAtom))
+				throw std::runtime_error("Corrupt atom section in segmentation file: " + path);
+			atoms = reinterpret_cast<const SegmentationAtom *>(data + pos);
+			return;
+		}
+		const unsigned char *in = data + pos, *end = data + size;
+		SegmentationAtom prev = {0, 0, 0, 0};
+		decoded.reserve(header.atomCount);
+		for (size_t i = 0; i < header.atomCount; i++) {
+			uint64_t sequenceDelta, start, length, classNr;
+			if (!segmentationGetVarint(in, end, sequenceDelta) || !segmentationGetVarint(in, end, start)
+				|| !segmentationGetVarint(in, end, length) || !segmentationGetVarint(in, end, classNr))
+				throw std::runtime_error("Truncated atom section in segmentation file: " + path);
+			SegmentationAtom a;
+			a.sequence = prev.sequence + sequenceDelta;
+			a.start = ((a.sequence == prev.sequence) ? prev.start : 0) + segmentationUnzigzag(start);
+			a.end = a.start + segmentationUnzigzag(length);
+			a.classNr = segmentationUnzigzag(classNr);
+			if (a.sequence >= header.sequenceCount)
+				throw std::runtime_error("Corrupt atom section in segmentation file: " + path);
+			decoded.push_back(a);
+			prev = a;
+		}
+		atoms = decoded.data();
+	}
+};
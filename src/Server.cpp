@@ -0,0 +1,210 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "Server.h"
+#include "IMP.h"
+#include "Util.h"
+
+Server::Server(const std::string &socketPath, unsigned int workers,
+	const std::deque<AlignmentRecord *> &alignments,
+	const std::vector<std::vector<AlignmentRecord *>> &buckets,
+	const std::map<std::string, unsigned long> &speciesStarts,
+	const AtomizerOptions &defaults)
+	: socketPath(socketPath), workers(workers), alignments(alignments), buckets(buckets),
+	speciesStarts(speciesStarts), defaults(defaults), listenFd(-1), stopping(false) {
+	// the threads are split between the concurrent requests
+	this->defaults.numThreads = std::max(1u, defaults.numThreads / std::max(1u, workers));
+	std::vector<std::pair<unsigned long, std::string>> byPosition;
+	for (auto &specStart : speciesStarts)
+		if (specStart.first != "$") byPosition.push_back(std::make_pair(specStart.second, specStart.first));
+	std::sort(byPosition.begin(), byPosition.end());
+	for (auto &specStart : byPosition) {
+		sequenceStarts.push_back(specStart.first);
+		sequenceNames.push_back(specStart.second);
+	}
+}
+
+void Server::run() {
+	struct sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(addr.sun_path)) {
+		std::cerr << "ERROR: Socket path is too long: " << socketPath << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::strcpy(addr.sun_path, socketPath.c_str());
+	struct stat st;
+	if (stat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(socketPath.c_str()); // left over from a previous server
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0 || bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0
+		|| listen(listenFd, 64) != 0) {
+		std::cerr << "ERROR: Cannot listen on socket " << socketPath << ": " << std::strerror(errno) << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	signal(SIGPIPE, SIG_IGN); // clients that disconnect early must not kill the server
+	std::cerr << "INFO: Serving " << alignments.size() << " alignments on " << socketPath
+		<< " with " << workers << " workers of " << defaults.numThreads << " threads." << std::endl;
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < workers; i++)
+		threads.push_back(std::thread(&Server::work, this));
+	while (true) {
+		int fd = accept(listenFd, nullptr, nullptr);
+		std::unique_lock<std::mutex> lock(mutex);
+		if (stopping) {
+			if (fd >= 0) close(fd);
+			break;
+		}
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			std::cerr << "ERROR: Accepting a connection failed: " << std::strerror(errno) << std::endl;
+			stopping = true;
+			break;
+		}
+		pending.push_back(fd);
+		wakeup.notify_one();
+	}
+	wakeup.notify_all();
+	for (auto &thread : threads)
+		thread.join();
+	close(listenFd);
+	unlink(socketPath.c_str());
+	std::cerr << "INFO: Server stopped." << std::endl;
+}
+
+void Server::stop() {
+	std::lock_guard<std::mutex> lock(mutex);
+	stopping = true;
+	shutdown(listenFd, SHUT_RDWR); // wakes up accept
+	wakeup.notify_all();
+}
+
+void Server::work() {
+	while (true) {
+		int fd;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeup.wait(lock, [this]() { return stopping || !pending.empty(); });
+			if (pending.empty()) return; // stopping and nothing left to answer
+			fd = pending.front();
+			pending.pop_front();
+		}
+		answer(fd);
+	}
+}
+
+std::string Server::parseRequest(const std::string &request, AtomizerOptions &options,
+	std::set<std::string> &sequences) const {
+	std::istringstream fields(request);
+	std::string field;
+	while (fields >> field) {
+		size_t eq = field.find('=');
+		if (eq == std::string::npos) return "expected key=value instead of " + field;
+		std::string key = field.substr(0, eq), value = field.substr(eq + 1);
+		std::transform(key.begin(), key.end(), key.begin(), tolower);
+		try {
+			if (key == "minlength") options.minLength = stoui(value);
+			else if (key == "minident") options.minAlnIdentity = std::stoul(value) / 100.0f;
+			else if (key == "maxiterations") options.maxIterations = stoui(value);
+			else if (key == "convergencefraction") options.convergenceFraction = std::stof(value);
+			else if (key == "sequences") {
+				std::istringstream names(value);
+				std::string name;
+				while (std::getline(names, name, ','))
+					if (!name.empty()) sequences.insert(name);
+			}
+			else return "unknown key " + key;
+		} catch (const std::exception &) {
+			return "the value of " + key + " could not be parsed";
+		}
+	}
+	if (options.minAlnIdentity < defaults.minAlnIdentity)
+		return "minIdent is below the " + std::to_string(static_cast<unsigned int>(defaults.minAlnIdentity * 100 + 0.5f))
+			+ " the alignments were loaded with";
+	for (auto &name : sequences)
+		if (name == "$" || speciesStarts.find(name) == speciesStarts.end()) return "unknown sequence " + name;
+	return "";
+}
+
+void Server::selectRecords(const AtomizerOptions &options, const std::set<std::string> &sequences,
+	std::deque<AlignmentRecord *> &records) const {
+	std::vector<bool> selected(sequenceNames.size(), true);
+	if (!sequences.empty())
+		for (size_t i = 0; i < sequenceNames.size(); i++)
+			selected[i] = sequences.count(sequenceNames[i]) > 0;
+	// a record and its reverse pass or fail together, so the sym pointers stay valid
+	for (auto rec : alignments)
+		if (rec->identity >= options.minAlnIdentity && selected[binSearch(rec->tStart, sequenceStarts)]
+			&& selected[binSearch(rec->qStart, sequenceStarts)])
+			records.push_back(rec);
+}
+
+void Server::answer(int fd) {
+	std::string request;
+	char buf[4096];
+	while (request.find('\n') == std::string::npos && request.size() <= MAX_REQUEST) {
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		request.append(buf, n);
+	}
+	request = request.substr(0, request.find('\n'));
+	if (!request.empty() && request.back() == '\r') request.pop_back();
+	FILE *out = fdopen(fd, "w");
+	if (out == nullptr) {
+		close(fd);
+		return;
+	}
+	if (request == "shutdown") {
+		fputs("#shutting down\n", out);
+		fclose(out);
+		stop();
+		return;
+	}
+
+	AtomizerOptions options = defaults;
+	std::set<std::string> sequences;
+	std::string error = (request.size() > MAX_REQUEST) ? "request too long" : parseRequest(request, options, sequences);
+	if (error.empty()) {
+		try {
+			auto start = std::chrono::high_resolution_clock::now();
+			std::cerr << "INFO: Answering request \"" << request << "\"." << std::endl;
+			AtomizerResult result;
+			if (options.minAlnIdentity == defaults.minAlnIdentity && sequences.empty()) {
+				atomizeBuckets(alignments, buckets, speciesStarts, options, AtomizerContext(), start, result);
+			} else { // buckets of the selected records only, the records themselves are shared
+				std::deque<AlignmentRecord *> records;
+				selectRecords(options, sequences, records);
+				std::vector<std::vector<AlignmentRecord *>> requestBuckets(buckets.size());
+				fillBuckets(records, options.bucketSize, requestBuckets);
+				atomizeBuckets(records, requestBuckets, speciesStarts, options, AtomizerContext(), start, result);
+			}
+			std::vector<std::string> comments = { std::string("stop: ") + stopReasonName(result.stopReason)
+				+ " after " + std::to_string(result.iterations) + " IMP iterations" };
+			if (!printResult(result.wasteRegions, result.classes, speciesStarts, comments, out, options.numThreads,
+				sequences.empty() ? nullptr : &sequences))
+				std::cerr << "WARNING: The answer to request \"" << request << "\" could not be sent." << std::endl;
+			std::cerr << "INFO: Answered request \"" << request << "\".";
+			shoutTime(start);
+		} catch (const std::exception &e) {
+			error = e.what();
+		}
+	}
+	if (!error.empty()) {
+		std::cerr << "WARNING: Request \"" << request << "\" failed: " << error << std::endl;
+		fprintf(out, "#error: %s\n", error.c_str());
+	}
+	fclose(out);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "AlignmentRecord.h"
+#include "LibAtomizer.h"
+
+/* Answers atomizer requests on a unix socket from alignments and buckets that are loaded once
+and shared read-only by all requests (atomizer --serve).
+A client connects, sends one request line and reads the result until the server closes the connection.
+The request line holds space separated key=value pairs, all optional:
+  minLength=<num>            minimum atom length (default: --minLength of the server)
+  minIdent=<percent>         minimum alignment identity, not below the --minIdent the server loaded
+                             the alignments with (default: that one)
+  sequences=<name,name,...>  only use the alignments between these sequences and only answer their atoms
+  maxIterations=<num>, convergenceFraction=<frac>  IMP stopping criteria (default: those of the server)
+The answer is the TSV table atomizer writes. Sequences without alignments in a request still take part in
+the segmentation, so atom and class numbers refer to all loaded sequences. Errors are answered with a
+single line "#error: <message>". The request "shutdown" stops the server after the pending requests. */
+class Server {
+
+public:
+    /* Constructor. defaults holds the parameters the alignments were loaded with and the request defaults,
+     * its numThreads are divided between the workers that answer requests concurrently. */
+    Server(const std::string &socketPath, unsigned int workers,
+            const std::deque<AlignmentRecord *> &alignments,
+            const std::vector<std::vector<AlignmentRecord *>> &buckets,
+            const std::map<std::string, unsigned long> &speciesStarts,
+            const AtomizerOptions &defaults);
+
+    /* Answers requests until a shutdown request. Exits if the socket cannot be opened. */
+    void run();
+
+private:
+    std::string socketPath;
+    unsigned int workers;
+    const std::deque<AlignmentRecord *> &alignments;
+    const std::vector<std::vector<AlignmentRecord *>> &buckets;
+    const std::map<std::string, unsigned long> &speciesStarts;
+    AtomizerOptions defaults;
+    std::vector<unsigned long> sequenceStarts; // sorted starts of the sequences, to find the sequence of a record
+    std::vector<std::string> sequenceNames; // name of the sequence starting at sequenceStarts[i]
+
+    int listenFd;
+    std::mutex mutex; // guards pending and stopping
+    std::condition_variable wakeup;
+    std::deque<int> pending; // accepted connections waiting for a worker
+    bool stopping;
+
+    // requests longer than this are refused
+    static const size_t MAX_REQUEST = 1 << 20;
+
+    /* Worker thread: answers pending connections until the server stops */
+    void work();
+
+    /* Reads the request of connection fd, computes and sends the answer and closes fd */
+    void answer(int fd);
+
+    /* Parses a request line into options and sequences, returns an error message or "" */
+    std::string parseRequest(const std::string &request, AtomizerOptions &options,
+            std::set<std::string> &sequences) const;
+
+    /* Copies the records passing options.minAlnIdentity between sequences (all if empty) to records */
+    void selectRecords(const AtomizerOptions &options, const std::set<std::string> &sequences,
+            std::deque<AlignmentRecord *> &records) const;
+
+    /* Stops accepting connections */
+    void stop();
+};
@@ -0,0 +1,269 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <dirent.h>
+
+#include "Shard.h"
+#include "Checkpoint.h"
+#include "Breakpoints.h"
+#include "IMP.h"
+#include "Util.h"
+
+/* Returns true if a file exists at path */
+static bool fileExists(const std::string &path) {
+	struct stat st;
+	return stat(path.c_str(), &st) == 0;
+}
+
+Shard::Shard(const std::string &dir, unsigned int numShards, unsigned long fingerprint, unsigned int timeoutSeconds)
+	: dir(dir), numShards(numShards), fingerprint(fingerprint), totalLength(0), timeoutSeconds(timeoutSeconds),
+	  round(0), runId(0), started(false), workerPids(numShards, 0), stopping(false) {
+	if (dir.empty()) return;
+	if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+		throw std::runtime_error("shard directory could not be created: " + dir);
+}
+
+Shard::~Shard() {
+	if (heartbeatThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(heartbeatMutex);
+			stopping = true;
+		}
+		heartbeatStop.notify_all();
+		heartbeatThread.join();
+	}
+	terminateWorkers();
+}
+
+void Shard::terminateWorkers() {
+	for (pid_t &pid : workerPids) {
+		if (pid == 0) continue;
+		kill(pid, SIGTERM);
+		waitpid(pid, nullptr, 0);
+		pid = 0;
+	}
+}
+
+unsigned long Shard::runFingerprint() const {
+	return fnv1a(&runId, sizeof(runId), fingerprint);
+}
+
+bool Shard::readRunId(unsigned long &id) const {
+	std::ifstream in(runPath());
+	return static_cast<bool>(in >> id);
+}
+
+void Shard::startHeartbeat(const std::string &name) {
+	heartbeatThread = std::thread([this, name]() {
+		std::string path = alivePath(name);
+		std::string pid = std::to_string(getpid());
+		std::unique_lock<std::mutex> lock(heartbeatMutex);
+		for (unsigned long beat = 0; !stopping; beat++) {
+			replaceFile(path, pid + " " + std::to_string(beat) + "\n");
+			heartbeatStop.wait_for(lock, std::chrono::milliseconds(HEARTBEAT_MILLISECONDS), [this] { return stopping; });
+		}
+	});
+}
+
+bool Shard::isAlive(const std::string &name, Heartbeat &beat) const {
+	auto now = std::chrono::steady_clock::now();
+	std::ifstream in(alivePath(name));
+	std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (!content.empty() && content != beat.content) { // compared by content, the clocks of hosts may differ
+		if (beat.checked) beat.beating = true; // a file found by the first check may be left from a previous run
+		beat.content = content;
+		beat.changed = now;
+	}
+	beat.checked = true;
+	return timeoutSeconds == 0 || now - beat.changed < std::chrono::seconds(timeoutSeconds);
+}
+
+void Shard::startCoordinator() {
+	if (!isEnabled() || started) return;
+	started = true;
+	DIR *d = opendir(dir.c_str());
+	if (d != nullptr) {
+		while (struct dirent *entry = readdir(d)) {
+			std::string name = entry->d_name;
+			if (name.compare(0, 6, "state.") == 0 || name.compare(0, 6, "shard.") == 0 || name == "done")
+				std::remove((dir + "/" + name).c_str());
+		}
+		closedir(d);
+	}
+	std::random_device random;
+	runId = (static_cast<unsigned long>(random()) << 32) ^ random() ^ static_cast<unsigned long>(getpid())
+		^ std::chrono::system_clock::now().time_since_epoch().count();
+	if (!replaceFile(runPath(), std::to_string(runId) + "\n"))
+		throw std::runtime_error("shard run id could not be written to " + runPath());
+	// workers get the timeout from now on to show up, e.g. while they parse
+	workerBeats.assign(numShards, Heartbeat{"", std::chrono::steady_clock::now()});
+	startHeartbeat("coordinator");
+}
+
+void Shard::spawnWorker(unsigned int k, const std::vector<std::string> &args) {
+	std::vector<char *> argv;
+	for (auto &arg : args)
+		argv.push_back(const_cast<char *>(arg.c_str()));
+	argv.push_back(nullptr);
+	pid_t pid = fork();
+	if (pid < 0)
+		throw std::runtime_error("shard worker " + std::to_string(k) + " could not be started: " + strerror(errno));
+	if (pid == 0) {
+		execvp(argv[0], argv.data());
+		std::cerr << "ERROR: shard worker " << k << " could not be started: " << strerror(errno) << std::endl;
+		_exit(127);
+	}
+	workerPids[k] = pid;
+}
+
+void Shard::checkWorker(unsigned int k) {
+	int status;
+	if (workerPids[k] != 0 && waitpid(workerPids[k], &status, WNOHANG) == workerPids[k]) {
+		workerPids[k] = 0;
+		terminateWorkers();
+		throw std::runtime_error("shard worker " + std::to_string(k) + " exited before IMP was done ("
+			+ (WIFSIGNALED(status) ? "signal " + std::to_string(WTERMSIG(status))
+				: "status " + std::to_string(WEXITSTATUS(status))) + ").");
+	}
+	if (!isAlive(std::to_string(k), workerBeats[k])) {
+		terminateWorkers();
+		throw std::runtime_error("shard worker " + std::to_string(k) + " has not been heard of for "
+			+ std::to_string(timeoutSeconds) + " seconds, see " + alivePath(std::to_string(k)));
+	}
+}
+
+void Shard::startWorker(unsigned int shardIdx) {
+	if (!isEnabled() || started) return;
+	started = true;
+	startHeartbeat(std::to_string(shardIdx));
+}
+
+void Shard::newWasteRegions(const std::vector<WasteRegion> &wasteRegions, std::vector<Region> &newRegions) {
+	startCoordinator();
+	if (!writeRegionFile(statePath(round), runFingerprint(), totalLength, round, wasteRegions))
+		throw std::runtime_error("shard state could not be written to " + statePath(round));
+	// collect the shard files in any order, as workers finish
+	std::vector<bool> collected(numShards, false);
+	unsigned int remaining = numShards;
+	while (remaining) {
+		bool found = false;
+		for (unsigned int k = 0; k < numShards; k++) {
+			if (collected[k]) continue;
+			std::vector<WasteRegion> shardRegions;
+			unsigned int shardRound;
+			auto status = readRegionFile(shardPath(round, k), runFingerprint(), totalLength, shardRound, shardRegions);
+			if (status == REGIONS_MISSING) continue;
+			if (status == REGIONS_MISMATCH) { // left by a worker of another run
+				std::remove(shardPath(round, k).c_str());
+				continue;
+			}
+			if (status != REGIONS_OK || shardRound != round)
+				throw std::runtime_error("bad shard file " + shardPath(round, k));
+			newRegions.insert(newRegions.end(), shardRegions.begin(), shardRegions.end());
+			std::remove(shardPath(round, k).c_str());
+			collected[k] = true;
+			remaining--;
+			found = true;
+		}
+		if (!found) {
+			for (unsigned int k = 0; k < numShards; k++)
+				if (!collected[k]) checkWorker(k);
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MILLISECONDS));
+		}
+	}
+	std::remove(statePath(round).c_str());
+	round++;
+}
+
+void Shard::finish() {
+	if (!isEnabled()) return;
+	startCoordinator();
+	std::vector<WasteRegion> empty;
+	writeRegionFile(donePath(), runFingerprint(), totalLength, round, empty);
+	for (unsigned int k = 0; k < numShards; k++) {
+		if (workerPids[k] == 0) continue;
+		int status;
+		waitpid(workerPids[k], &status, 0);
+		workerPids[k] = 0;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+			std::cerr << "WARNING: shard worker " << k << " did not exit cleanly." << std::endl;
+	}
+}
+
+void Shard::runWorker(unsigned int shardIdx,
+	const std::vector<std::vector<AlignmentRecord *>> &buckets,
+	unsigned int bucketSize, unsigned int minLength, double epsilon,
+	unsigned int numThreads) {
+	startWorker(shardIdx);
+	Heartbeat coordinator{"", std::chrono::steady_clock::now()};
+	bool inRun = false; // a run id was read
+	bool staleDone = fileExists(donePath()); // a done file older than this worker belongs to a previous run
+	for (unsigned int r = 0; ; r++) {
+		std::vector<WasteRegion> wasteRegions;
+		unsigned int stateRound;
+		RegionFileStatus status;
+		// wait for the coordinator to publish the state of this round, following new runs
+		while (true) {
+			bool alive = isAlive("coordinator", coordinator);
+			unsigned long latest;
+			if (readRunId(latest) && (!inRun || latest != runId)) {
+				if (inRun) {
+					std::cerr << "INFO: Shard " << shardIdx << " joins a new run in " << dir << "." << std::endl;
+					staleDone = false;
+				}
+				runId = latest;
+				inRun = true;
+				r = 0;
+			}
+			// states are only taken from a running coordinator, not from the files of a crashed run
+			status = (inRun && coordinator.beating)
+				? readRegionFile(statePath(r), runFingerprint(), totalLength, stateRound, wasteRegions)
+				: REGIONS_MISSING;
+			if (status == REGIONS_MISMATCH && readRunId(latest) && latest != runId)
+				continue; // the state of a run published after the run id was read
+			if (status != REGIONS_MISSING) break;
+			if (inRun && !staleDone) {
+				std::vector<WasteRegion> empty;
+				unsigned int doneRound;
+				if (readRegionFile(donePath(), runFingerprint(), totalLength, doneRound, empty) == REGIONS_OK) {
+					std::cerr << "INFO: Shard " << shardIdx << " done after " << r << " rounds." << std::endl;
+					return;
+				}
+			}
+			if (!alive)
+				throw std::runtime_error("the shard coordinator has not been heard of for "
+					+ std::to_string(timeoutSeconds) + " seconds, see " + alivePath("coordinator"));
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MILLISECONDS));
+		}
+		if (status == REGIONS_MISMATCH)
+			throw std::runtime_error("shard state " + statePath(r)
+				+ " was created from different input files or parameters.");
+		if (status != REGIONS_OK || stateRound != r)
+			throw std::runtime_error("bad shard state file " + statePath(r));
+
+		std::vector<Region> protoAtoms;
+		atomsFromWaste(wasteRegions, protoAtoms);
+		size_t begin = protoAtoms.size() * shardIdx / numShards;
+		size_t end = protoAtoms.size() * (shardIdx + 1) / numShards;
+		std::vector<Region> newRegions;
+		IMPCounters counters;
+		newWasteRegionsForAtoms(protoAtoms, begin, end, wasteRegions, buckets,
+			bucketSize, minLength, epsilon, numThreads, newRegions, counters, nullptr);
+
+		std::vector<WasteRegion> result(newRegions.begin(), newRegions.end());
+		std::sort(result.begin(), result.end()); // file format expects sorted regions
+		if (!writeRegionFile(shardPath(r, shardIdx), runFingerprint(), totalLength, r, result))
+			throw std::runtime_error("shard result could not be written to " + shardPath(r, shardIdx));
+		std::cerr << "INFO: Shard " << shardIdx << " computed " << result.size()
+			<< " new waste regions for atoms " << begin << " to " << end << " in round " << r << "." << std::endl;
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <sys/types.h>
+#include "AlignmentRecord.h"
+
+/* Distributes the IMP iterations over several processes that communicate through files in a
+shared directory (local or on a shared filesystem).
+The coordinator writes the waste regions of each round to <dir>/state.<round>. Every worker reads
+them, computes the new waste regions of its range of atoms and writes them to <dir>/shard.<round>.<k>.
+The coordinator merges all shard files and starts the next round, or writes <dir>/done at the end.
+Workers parse the same psl input as the coordinator, so every file carries the input fingerprint.
+On start the coordinator removes the files of previous runs and publishes a new run id in <dir>/run, which
+is mixed into the fingerprint of all later files, so files of other runs are never taken for this one.
+Workers follow the latest run id, and a done file that was there before they started is not theirs.
+Every process rewrites <dir>/alive.<k> (alive.coordinator) every second. A process gives up with a std::runtime_error
+if the other side's file has not changed for the timeout, and the coordinator also notices at once when a
+worker it started itself (spawnWorker) exits. */
+class Shard {
+
+public:
+    /* Constructor. numShards == 0 or an empty dir disables sharding.
+     * timeoutSeconds == 0 waits for the other processes forever. */
+    Shard(const std::string &dir, unsigned int numShards, unsigned long fingerprint,
+            unsigned int timeoutSeconds = DEFAULT_TIMEOUT_SECONDS);
+
+    /* Destructor, stops the heartbeat and terminates workers started by spawnWorker that still run */
+    ~Shard();
+
+    Shard(const Shard &) = delete;
+    Shard &operator=(const Shard &) = delete;
+
+    /* Returns true if IMP runs sharded */
+    bool isEnabled() const { return numShards > 0 && !dir.empty(); };
+
+    /* Sets the total length of the concatenated sequence, stored for validation by the workers */
+    void setTotalLength(unsigned long length) { totalLength = length; };
+
+    /* Coordinator: removes files of previous runs from dir, publishes a new run id and starts the heartbeat.
+     * Only the first call does something, call it before starting workers. */
+    void startCoordinator();
+
+    /* Coordinator: starts worker k on this host with the command line args (args[0] is the program) */
+    void spawnWorker(unsigned int k, const std::vector<std::string> &args);
+
+    /* Worker: starts the heartbeat of worker shardIdx, call it early so the coordinator sees the worker
+     * while it parses. Only the first call does something. */
+    void startWorker(unsigned int shardIdx);
+
+    /* Coordinator: hands wasteRegions to the workers and collects their new waste regions in newRegions */
+    void newWasteRegions(const std::vector<WasteRegion> &wasteRegions, std::vector<Region> &newRegions);
+
+    /* Coordinator: tells the workers that IMP is done and waits for the workers started by spawnWorker */
+    void finish();
+
+    /* Worker: processes the rounds for atom range shardIdx until the coordinator is done */
+    void runWorker(unsigned int shardIdx,
+            const std::vector<std::vector<AlignmentRecord *>> &buckets,
+            unsigned int bucketSize, unsigned int minLength, double epsilon,
+            unsigned int numThreads);
+
+    static const unsigned int DEFAULT_TIMEOUT_SECONDS = 600;
+
+private:
+    /* What a process last saw of another process's heartbeat file */
+    struct Heartbeat {
+        std::string content;
+        std::chrono::steady_clock::time_point changed;
+        bool checked = false;
+        bool beating = false; // changed since the first check, so the process is running now
+    };
+
+    std::string dir;
+    unsigned int numShards;
+    unsigned long fingerprint;
+    unsigned long totalLength;
+    unsigned int timeoutSeconds;
+    unsigned int round; // current round of the coordinator
+    unsigned long runId; // id of the run the files belong to
+    bool started; // startCoordinator or startWorker was called
+    std::vector<pid_t> workerPids; // workers started by spawnWorker, 0 if not started or done
+    std::vector<Heartbeat> workerBeats; // coordinator: heartbeats of the workers
+
+    std::thread heartbeatThread;
+    std::mutex heartbeatMutex;
+    std::condition_variable heartbeatStop;
+    bool stopping;
+
+    // how long to sleep between checks for new files
+    static const unsigned int POLL_MILLISECONDS = 20;
+    // how often the heartbeat files are rewritten
+    static const unsigned int HEARTBEAT_MILLISECONDS = 1000;
+
+    /* Fingerprint of the files of the current run */
+    unsigned long runFingerprint() const;
+
+    /* Reads the published run id into id, returns false if there is none */
+    bool readRunId(unsigned long &id) const;
+
+    /* Rewrites alive.<name> every HEARTBEAT_MILLISECONDS until the destructor */
+    void startHeartbeat(const std::string &name);
+
+    /* Updates beat from alive.<name>, returns false if it has not changed for the timeout */
+    bool isAlive(const std::string &name, Heartbeat &beat) const;
+
+    /* Coordinator: terminates the workers started by spawnWorker that still run */
+    void terminateWorkers();
+
+    /* Coordinator: throws std::runtime_error if worker k exited or its heartbeat stopped */
+    void checkWorker(unsigned int k);
+
+    std::string statePath(unsigned int r) const { return dir + "/state." + std::to_string(r); };
+    std::string shardPath(unsigned int r, unsigned int k) const
+            { return dir + "/shard." + std::to_string(r) + "." + std::to_string(k); };
+    std::string donePath() const { return dir + "/done"; };
+    std::string runPath() const { return dir + "/run"; };
+    std::string alivePath(const std::string &name) const { return dir + "/alive." + name; };
+};
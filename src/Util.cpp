@@ -1,46 +1,201 @@
-#include <iostream>
-#include <algorithm>
-#include <stdexcept>
-
-#include "Util.h"
-
-unsigned int binSearch(unsigned long x, const std::vector<unsigned long>& xList) {
-        unsigned int result = std::distance(xList.begin(), std::upper_bound(xList.begin(), xList.end(), x));
-        if (result == 0) return result;
-        else return result - 1;
-}
-
-void printResult(const std::vector<WasteRegion> &regions, const std::vector<int> &classes,
-	const std::map<std::string, unsigned long> &speciesStarts) {
-	// flipped is speciesStarts sorted by position
-	std::map<unsigned long, std::string> flipped;
-	for (auto specStart : speciesStarts)
-		flipped[specStart.second] = specStart.first;
-	std::vector<std::string> names;
-	std::vector<unsigned long> starts;
-	for (auto specStart : flipped) {
-		starts.push_back(specStart.first);
-		names.push_back(specStart.second);
-	}
-
-	std::cout << "#name\tatom_nr\tclass\tstrand\tstart\tend" << "\n"; // header line
-	for (size_t i = 0; i + 1 < regions.size(); i++) {
-		auto j = binSearch(regions[i].last, starts);
-		auto move = starts[j];
-		auto start = (regions[i].last > move) ? regions[i].last - move : 0;
-		auto end = regions[i + 1].first - move;
-		if (end > starts[j + 1]) end = starts[j + 1];
-		auto classNr = abs(classes[i]);
-		auto strand = (classes[i] > 0) ? '+' : '-';
-		std::cout << names[j] << "\t" << i+1 << "\t" << classNr << "\t" << strand << "\t"
-			<< start << "\t" << end << "\n";
-	}
-}
-
-void shoutTime(const std::chrono::time_point<std::chrono::high_resolution_clock> start) {
-	auto end = std::chrono::high_resolution_clock::now();
-	auto diff = end - start;
-	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(diff).count();
-	std::cerr << " Time passed since start: " << ms << " milliseconds." << std::endl;
-}
-
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+
+#include "Util.h"
+#include "Segmentation.h"
+
+unsigned int binSearch(unsigned long x, const std::vector<unsigned long>& xList) {
+        unsigned int result = std::distance(xList.begin(), std::upper_bound(xList.begin(), xList.end(), x));
+        if (result == 0) return result;
+        else return result - 1;
+}
+
+/* Appends the decimal representation of x to buf */
+static inline void appendUInt(std::string &buf, unsigned long x) {
+	char digits[20];
+	int n = 0;
+	do {
+		digits[n++] = '0' + x % 10;
+		x /= 10;
+	} while (x);
+	while (n) buf.push_back(digits[--n]);
+}
+
+/* Sequence starts sorted by position with their names, of sequences with the same start the last name wins */
+static void sortSequences(const std::map<std::string, unsigned long> &speciesStarts,
+	std::vector<unsigned long> &starts, std::vector<const std::string *> &names) {
+	std::vector<std::pair<unsigned long, const std::string *>> byPosition;
+	for (auto &specStart : speciesStarts)
+		byPosition.push_back(std::make_pair(specStart.second, &specStart.first));
+	std::stable_sort(byPosition.begin(), byPosition.end(),
+		[](const std::pair<unsigned long, const std::string *> &x, const std::pair<unsigned long, const std::string *> &y) {
+			return x.first < y.first; });
+	for (auto &specStart : byPosition) {
+		if (!starts.empty() && starts.back() == specStart.first) names.back() = specStart.second;
+		else {
+			starts.push_back(specStart.first);
+			names.push_back(specStart.second);
+		}
+	}
+}
+
+/* Finds sequence j and the local start and end of atom i. Atoms are in coordinate order,
+so j is found by sweeping forward over the sequence starts from the sequence of the previous atom. */
+static inline void locateAtom(const std::vector<WasteRegion> &regions, const std::vector<unsigned long> &starts,
+	size_t i, unsigned int &j, unsigned long &start, unsigned long &end) {
+	while (j + 1 < starts.size() && starts[j + 1] <= regions[i].last) j++;
+	auto move = starts[j];
+	start = (regions[i].last > move) ? regions[i].last - move : 0;
+	end = regions[i + 1].first - move;
+	if (end > starts[j + 1]) end = starts[j + 1];
+}
+
+/* Formats the result lines of atoms [begin, end) into buf, skipping the sequences j with !keep[j] if keep is not empty */
+static void formatAtoms(const std::vector<WasteRegion> &regions, const std::vector<int> &classes,
+	const std::vector<unsigned long> &starts, const std::vector<const std::string *> &names,
+	const std::vector<bool> &keep, size_t begin, size_t end, std::string &buf) {
+	unsigned int j = binSearch(regions[begin].last, starts);
+	for (size_t i = begin; i < end; i++) {
+		unsigned long start, atomEnd;
+		locateAtom(regions, starts, i, j, start, atomEnd);
+		if (!keep.empty() && !keep[j]) continue;
+		buf.append(*names[j]);
+		buf.push_back('\t');
+		appendUInt(buf, i + 1);
+		buf.push_back('\t');
+		appendUInt(buf, abs(classes[i]));
+		buf.push_back('\t');
+		buf.push_back((classes[i] > 0) ? '+' : '-');
+		buf.push_back('\t');
+		appendUInt(buf, start);
+		buf.push_back('\t');
+		appendUInt(buf, atomEnd);
+		buf.push_back('\n');
+	}
+}
+
+bool printResult(const std::vector<WasteRegion> &regions, const std::vector<int> &classes,
+	const std::map<std::string, unsigned long> &speciesStarts, const std::vector<std::string> &comments,
+	FILE *out, unsigned int numThreads, const std::set<std::string> *sequences) {
+	std::vector<unsigned long> starts;
+	std::vector<const std::string *> names;
+	sortSequences(speciesStarts, starts, names);
+	std::vector<bool> keep;
+	if (sequences)
+		for (auto name : names)
+			keep.push_back(sequences->count(*name) > 0);
+
+	std::string header;
+	for (auto &comment : comments)
+		header += "#" + comment + "\n";
+	header += "#name\tatom_nr\tclass\tstrand\tstart\tend\n";
+	fwrite(header.data(), 1, header.size(), out);
+	// format chunks of atoms in parallel, then write them in order
+	const size_t CHUNK_ATOMS = 1 << 16;
+	const size_t nrAtoms = regions.empty() ? 0 : regions.size() - 1;
+	if (numThreads < 1) numThreads = 1;
+	std::vector<std::string> bufs(numThreads);
+	for (size_t roundStart = 0; roundStart < nrAtoms; roundStart += CHUNK_ATOMS * numThreads) {
+		#pragma omp parallel for num_threads(numThreads) schedule(static, 1)
+		for (unsigned int t = 0; t < numThreads; t++) {
+			size_t begin = std::min(nrAtoms, roundStart + t * CHUNK_ATOMS);
+			size_t end = std::min(nrAtoms, begin + CHUNK_ATOMS);
+			bufs[t].clear();
+			if (begin < end) formatAtoms(regions, classes, starts, names, keep, begin, end, bufs[t]);
+		}
+		for (auto &buf : bufs)
+			if (fwrite(buf.data(), 1, buf.size(), out) != buf.size()) return false;
+	}
+	return fflush(out) == 0;
+}
+
+void atomCoordinates(const std::vector<WasteRegion> &regions, const std::map<std::string, unsigned long> &speciesStarts,
+	std::vector<std::string> &names, std::vector<unsigned int> &sequence,
+	std::vector<unsigned long> &start, std::vector<unsigned long> &end) {
+	std::vector<unsigned long> starts;
+	std::vector<const std::string *> namePtrs;
+	sortSequences(speciesStarts, starts, namePtrs);
+	names.clear();
+	for (auto name : namePtrs)
+		names.push_back(*name);
+	const size_t nrAtoms = regions.empty() ? 0 : regions.size() - 1;
+	sequence.resize(nrAtoms);
+	start.resize(nrAtoms);
+	end.resize(nrAtoms);
+	unsigned int j = nrAtoms ? binSearch(regions[0].last, starts) : 0;
+	for (size_t i = 0; i < nrAtoms; i++) {
+		locateAtom(regions, starts, i, j, start[i], end[i]);
+		sequence[i] = j;
+	}
+}
+
+bool writeBinaryResult(const std::vector<WasteRegion> &regions, const std::vector<int> &classes,
+	const std::map<std::string, unsigned long> &speciesStarts, const std::vector<std::string> &comments,
+	FILE *out, bool compress) {
+	std::vector<unsigned long> starts;
+	std::vector<const std::string *> names;
+	sortSequences(speciesStarts, starts, names);
+	const size_t nrAtoms = regions.empty() ? 0 : regions.size() - 1;
+
+	// string tables, the names of all sequences are stored although the last one ("$") has no atoms
+	std::vector<SegmentationString> table;
+	std::string strings;
+	for (auto name : names) {
+		table.push_back({strings.size(), name->size()});
+		strings += *name;
+	}
+	for (auto &comment : comments) {
+		table.push_back({strings.size(), comment.size()});
+		strings += comment;
+	}
+	strings.resize((strings.size() + 7) / 8 * 8, '\0');
+
+	std::vector<SegmentationAtom> atoms;
+	std::string packed;
+	SegmentationAtom prev = {0, 0, 0, 0};
+	if (!compress) atoms.reserve(nrAtoms);
+	unsigned int j = nrAtoms ? binSearch(regions[0].last, starts) : 0;
+	for (size_t i = 0; i < nrAtoms; i++) {
+		unsigned long start, end;
+		locateAtom(regions, starts, i, j, start, end);
+		SegmentationAtom atom = {start, end, j, classes[i]};
+		if (compress) segmentationPutAtom(packed, atom, prev);
+		else atoms.push_back(atom);
+		prev = atom;
+	}
+
+	SegmentationHeader header;
+	std::memcpy(header.magic, SEGMENTATION_MAGIC, sizeof(header.magic));
+	header.version = SEGMENTATION_VERSION;
+	header.flags = compress ? SEGMENTATION_COMPRESSED : 0;
+	header.sequenceCount = names.size();
+	header.commentCount = comments.size();
+	header.atomCount = nrAtoms;
+	header.stringBytes = strings.size();
+	header.atomBytes = compress ? packed.size() : atoms.size() * sizeof(SegmentationAtom);
+	fwrite(&header, sizeof(header), 1, out);
+	fwrite(table.data(), sizeof(SegmentationString), table.size(), out);
+	fwrite(strings.data(), 1, strings.size(), out);
+	if (compress) fwrite(packed.data(), 1, packed.size(), out);
+	else fwrite(atoms.data(), sizeof(SegmentationAtom), atoms.size(), out);
+	return fflush(out) == 0 && !ferror(out);
+}
+
+void shoutTime(const std::chrono::time_point<std::chrono::high_resolution_clock> start) {
+	auto end = std::chrono::high_resolution_clock::now();
+	auto diff = end - start;
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(diff).count();
+	std::cerr << " Time passed since start: " << ms << " milliseconds." << std::endl;
+}
+
+
+unsigned long fnv1a(const void *data, size_t len, unsigned long h) {
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	for (size_t i = 0; i < len; i++) {
+		h ^= bytes[i];
+		h *= 1099511628211UL;
+	}
+	return h;
+}
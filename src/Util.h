@@ -1,36 +1,62 @@
-#pragma once
-
-#include <vector>
-#include <map>
-#include <chrono>
-#include <string>
-#include "AlignmentRecord.h"
-
-/* Returns index of the last element in xList that is <= x.
-If all elements in xList are > x, result is 0. Expects xList to be sorted ascending. */
-unsigned int binSearch(unsigned long x, const std::vector<unsigned long>& xList);
-
-/* Prints result */
-void printResult(const std::vector<WasteRegion>&,
-	const std::vector<int>&, 
-	const std::map<std::string, unsigned long>&);
-
-/* Prints the time elapsed since beginning */
-void shoutTime(const std::chrono::time_point<std::chrono::high_resolution_clock>);
-
-/* Converts string to unsigned int, throwing an exception if the number doesn't fit. */
-inline unsigned int stoui(const std::string& s)
-{
-        unsigned long lresult = stoul(s, 0, 10);
-        unsigned int result = lresult;
-        if (result != lresult) throw std::range_error("Cannot fit this number in an unsigned int: " + s + " (" + __FILE__ + ":" + std::to_string(__LINE__) + ")");
-        return result;
-}
-/* Converts string to unsigned short, throwing an exception if the number doesn't fit. */
-inline unsigned short stouh(const std::string& s)
-{
-        unsigned long lresult = stoul(s, 0, 10);
-        unsigned short result = lresult;
-        if (result != lresult) throw std::range_error("Cannot fit this number in an unsigned short: " + s + " (" + __FILE__ + ":" + std::to_string(__LINE__) + ")");
-        return result;
-}
+#pragma once
+
+#include <vector>
+#include <map>
+#include <set>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include "AlignmentRecord.h"
+
+/* Returns index of the last element in xList that is <= x.
+If all elements in xList are > x, result is 0. Expects xList to be sorted ascending. */
+unsigned int binSearch(unsigned long x, const std::vector<unsigned long>& xList);
+
+/* Writes the result to out, preceded by the comment lines in comments (without leading #).
+The lines are formatted with numThreads threads. If sequences is given, only the atoms of these
+sequences are written, keeping their atom and class numbers. Returns false if writing failed. */
+bool printResult(const std::vector<WasteRegion>&,
+	const std::vector<int>&, 
+	const std::map<std::string, unsigned long>&,
+	const std::vector<std::string>&,
+	FILE *out, unsigned int numThreads, const std::set<std::string> *sequences = nullptr);
+
+/* Computes the rows of the result table: the sequence names sorted by position and for each atom
+the index of its sequence and its start and end in sequence coordinates */
+void atomCoordinates(const std::vector<WasteRegion>&, const std::map<std::string, unsigned long>&,
+	std::vector<std::string> &names, std::vector<unsigned int> &sequence,
+	std::vector<unsigned long> &start, std::vector<unsigned long> &end);
+
+/* Writes the result to out in the binary segmentation format of Segmentation.h,
+with the atoms stored as varint deltas if compress is set. Returns false if writing failed. */
+bool writeBinaryResult(const std::vector<WasteRegion>&,
+	const std::vector<int>&,
+	const std::map<std::string, unsigned long>&,
+	const std::vector<std::string>&,
+	FILE *out, bool compress);
+
+/* Prints the time elapsed since beginning */
+void shoutTime(const std::chrono::time_point<std::chrono::high_resolution_clock>);
+
+/* Returns a 64 bit FNV-1a hash of len bytes, continuing from hash h. */
+unsigned long fnv1a(const void *data, size_t len, unsigned long h = 14695981039346656037UL);
+
+/* Returns the bytes glibc malloc uses for a request of n bytes */
+inline unsigned long mallocBytes(unsigned long n) { return n <= 24 ? 32 : (n + 8 + 15) / 16 * 16; }
+
+/* Converts string to unsigned int, throwing an exception if the number doesn't fit. */
+inline unsigned int stoui(const std::string& s)
+{
+        unsigned long lresult = stoul(s, 0, 10);
+        unsigned int result = lresult;
+        if (result != lresult) throw std::range_error("Cannot fit this number in an unsigned int: " + s + " (" + __FILE__ + ":" + std::to_string(__LINE__) + ")");
+        return result;
+}
+/* Converts string to unsigned short, throwing an exception if the number doesn't fit. */
+inline unsigned short stouh(const std::string& s)
+{
+        unsigned long lresult = stoul(s, 0, 10);
+        unsigned short result = lresult;
+        if (result != lresult) throw std::range_error("Cannot fit this number in an unsigned short: " + s + " (" + __FILE__ + ":" + std::to_string(__LINE__) + ")");
+        return result;
+}
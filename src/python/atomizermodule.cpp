@@ -0,0 +1,430 @@
+/* CPython extension "atomizer", built with 'make python' from the atomizer sources.
+ *
+ *   for aln in atomizer.read_psl("in.psl"):      # streams Alignment objects
+ *       numpy.asarray(aln.block_sizes)            # block arrays support the buffer protocol
+ *   result = atomizer.atomize(alignments_or_paths, min_length=250, min_ident=80, num_threads=4)
+ *
+ * atomize runs the full pipeline of libatomizer without the GIL and returns a dict of arrays.
+ * Malformed psl lines and alignments raise ValueError, other errors of the library RuntimeError. */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../InputParser.h"
+#include "../LibAtomizer.h"
+
+/* Sets the Python exception for a C++ exception of the library, which must not cross into Python:
+ * ValueError for malformed input, MemoryError and RuntimeError for everything else. Returns NULL. */
+static PyObject *setError(std::exception_ptr error) {
+	try {
+		std::rethrow_exception(error);
+	} catch (const std::invalid_argument &e) {
+		PyErr_SetString(PyExc_ValueError, e.what());
+	} catch (const std::bad_alloc &) {
+		PyErr_NoMemory();
+	} catch (const std::exception &e) {
+		PyErr_SetString(PyExc_RuntimeError, e.what());
+	} catch (...) {
+		PyErr_SetString(PyExc_RuntimeError, "unknown error in atomizer");
+	}
+	return NULL;
+}
+
+/* Blocks: a read-only one dimensional array of numbers exported through the buffer protocol */
+
+typedef struct {
+	PyObject_HEAD
+	std::vector<unsigned char> *data;
+	Py_ssize_t length;
+	Py_ssize_t itemsize;
+	const char *format; // struct module format of one item
+} BlocksObject;
+
+static PyTypeObject BlocksType = {PyVarObject_HEAD_INIT(NULL, 0)};
+
+template<typename T>
+static PyObject *makeBlocks(const std::vector<T> &values, const char *format) {
+	BlocksObject *self = PyObject_New(BlocksObject, &BlocksType);
+	if (self == NULL) return NULL;
+	const unsigned char *bytes = reinterpret_cast<const unsigned char *>(values.data());
+	self->data = new (std::nothrow) std::vector<unsigned char>(bytes, bytes + values.size() * sizeof(T));
+	if (self->data == NULL) {
+		Py_DECREF(self);
+		return PyErr_NoMemory();
+	}
+	self->length = values.size();
+	self->itemsize = sizeof(T);
+	self->format = format;
+	return reinterpret_cast<PyObject *>(self);
+}
+
+static void Blocks_dealloc(BlocksObject *self) {
+	delete self->data;
+	PyObject_Free(self);
+}
+
+static int Blocks_getbuffer(BlocksObject *self, Py_buffer *view, int flags) {
+	if (flags & PyBUF_WRITABLE) {
+		PyErr_SetString(PyExc_BufferError, "Blocks are read-only");
+		return -1;
+	}
+	view->obj = reinterpret_cast<PyObject *>(self);
+	Py_INCREF(self);
+	view->buf = self->data->data();
+	view->len = self->length * self->itemsize;
+	view->readonly = 1;
+	view->itemsize = self->itemsize;
+	view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>(self->format) : NULL;
+	view->ndim = 1;
+	view->shape = (flags & PyBUF_ND) ? &self->length : NULL;
+	view->strides = (flags & PyBUF_STRIDES) ? &self->itemsize : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	return 0;
+}
+
+static Py_ssize_t Blocks_length(BlocksObject *self) {
+	return self->length;
+}
+
+static PyObject *Blocks_item(BlocksObject *self, Py_ssize_t i) {
+	if (i < 0 || i >= self->length) {
+		PyErr_SetString(PyExc_IndexError, "Blocks index out of range");
+		return NULL;
+	}
+	const unsigned char *item = self->data->data() + i * self->itemsize;
+	switch (self->format[0]) {
+	case 'I': return PyLong_FromUnsignedLong(*reinterpret_cast<const unsigned int *>(item));
+	case 'i': return PyLong_FromLong(*reinterpret_cast<const int *>(item));
+	default: return PyLong_FromUnsignedLong(*reinterpret_cast<const unsigned long *>(item));
+	}
+}
+
+static PyBufferProcs Blocks_as_buffer = {(getbufferproc)Blocks_getbuffer, NULL};
+static PySequenceMethods Blocks_as_sequence = {(lenfunc)Blocks_length, 0, 0, (ssizeargfunc)Blocks_item};
+
+/* Alignment: the fields of one psl line atomizer uses */
+
+typedef struct {
+	PyObject_HEAD
+	PslAlignment *aln;
+} AlignmentObject;
+
+static PyTypeObject AlignmentType = {PyVarObject_HEAD_INIT(NULL, 0)};
+
+static PyObject *wrapAlignment(PslAlignment *aln) {
+	AlignmentObject *self = PyObject_New(AlignmentObject, &AlignmentType);
+	if (self == NULL) {
+		delete aln;
+		return NULL;
+	}
+	self->aln = aln;
+	return reinterpret_cast<PyObject *>(self);
+}
+
+static void Alignment_dealloc(AlignmentObject *self) {
+	delete self->aln;
+	PyObject_Free(self);
+}
+
+/* Reads a sequence of non-negative integers (e.g. a list or Blocks) into values */
+template<typename T>
+static bool readNumbers(PyObject *obj, std::vector<T> &values) {
+	PyObject *seq = PySequence_Fast(obj, "block arrays must be sequences of integers");
+	if (seq == NULL) return false;
+	Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+	values.resize(n);
+	for (Py_ssize_t i = 0; i < n; i++) {
+		unsigned long v = PyLong_AsUnsignedLong(PySequence_Fast_GET_ITEM(seq, i));
+		if (!PyErr_Occurred() && v > std::numeric_limits<T>::max())
+			PyErr_SetString(PyExc_OverflowError, "block array value too large");
+		if (PyErr_Occurred()) {
+			Py_DECREF(seq);
+			return false;
+		}
+		values[i] = static_cast<T>(v);
+	}
+	Py_DECREF(seq);
+	return true;
+}
+
+static PyObject *Alignment_new(PyTypeObject *, PyObject *args, PyObject *kwds) {
+	static const char *kwlist[] = {"matches", "mismatches", "rep_matches", "strand",
+		"q_name", "q_size", "q_start", "q_end", "t_name", "t_size", "t_start", "t_end",
+		"block_sizes", "q_starts", "t_starts", NULL};
+	unsigned int matches, mismatches, repMatches;
+	const char *strand, *qName, *tName;
+	unsigned long qSize, qStart, qEnd, tSize, tStart, tEnd;
+	PyObject *blockSizes, *qStarts, *tStarts;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "IIIsskkkskkkOOO", const_cast<char **>(kwlist),
+		&matches, &mismatches, &repMatches, &strand, &qName, &qSize, &qStart, &qEnd,
+		&tName, &tSize, &tStart, &tEnd, &blockSizes, &qStarts, &tStarts))
+		return NULL;
+	if ((strand[0] != '+' && strand[0] != '-') || strand[1] != '\0') {
+		PyErr_SetString(PyExc_ValueError, "strand must be '+' or '-'");
+		return NULL;
+	}
+	PslAlignment *aln = new PslAlignment();
+	aln->matches = matches;
+	aln->mismatches = mismatches;
+	aln->repMatches = repMatches;
+	aln->strand = strand[0];
+	aln->qName = qName;
+	aln->qSize = qSize;
+	aln->qStart = qStart;
+	aln->qEnd = qEnd;
+	aln->tName = tName;
+	aln->tSize = tSize;
+	aln->tStart = tStart;
+	aln->tEnd = tEnd;
+	if (!readNumbers(blockSizes, aln->blockSizes) || !readNumbers(qStarts, aln->qStarts)
+		|| !readNumbers(tStarts, aln->tStarts)) {
+		delete aln;
+		return NULL;
+	}
+	if (aln->qStarts.size() != aln->blockSizes.size() || aln->tStarts.size() != aln->blockSizes.size()) {
+		delete aln;
+		PyErr_SetString(PyExc_ValueError, "block_sizes, q_starts and t_starts must have the same length");
+		return NULL;
+	}
+	return wrapAlignment(aln);
+}
+
+#define ALIGNMENT_UINT_GETTER(name, field) \
+	static PyObject *Alignment_get_##name(AlignmentObject *self, void *) { \
+		return PyLong_FromUnsignedLong(self->aln->field); }
+ALIGNMENT_UINT_GETTER(matches, matches)
+ALIGNMENT_UINT_GETTER(mismatches, mismatches)
+ALIGNMENT_UINT_GETTER(rep_matches, repMatches)
+ALIGNMENT_UINT_GETTER(q_size, qSize)
+ALIGNMENT_UINT_GETTER(q_start, qStart)
+ALIGNMENT_UINT_GETTER(q_end, qEnd)
+ALIGNMENT_UINT_GETTER(t_size, tSize)
+ALIGNMENT_UINT_GETTER(t_start, tStart)
+ALIGNMENT_UINT_GETTER(t_end, tEnd)
+ALIGNMENT_UINT_GETTER(block_count, blockSizes.size())
+
+static PyObject *Alignment_get_strand(AlignmentObject *self, void *) {
+	return PyUnicode_FromStringAndSize(&self->aln->strand, 1);
+}
+static PyObject *Alignment_get_q_name(AlignmentObject *self, void *) {
+	return PyUnicode_FromStringAndSize(self->aln->qName.data(), self->aln->qName.size());
+}
+static PyObject *Alignment_get_t_name(AlignmentObject *self, void *) {
+	return PyUnicode_FromStringAndSize(self->aln->tName.data(), self->aln->tName.size());
+}
+static PyObject *Alignment_get_block_sizes(AlignmentObject *self, void *) {
+	return makeBlocks(self->aln->blockSizes, "I");
+}
+static PyObject *Alignment_get_q_starts(AlignmentObject *self, void *) {
+	return makeBlocks(self->aln->qStarts, "L");
+}
+static PyObject *Alignment_get_t_starts(AlignmentObject *self, void *) {
+	return makeBlocks(self->aln->tStarts, "L");
+}
+
+#define ALIGNMENT_GETSET(name) {#name, (getter)Alignment_get_##name, NULL, NULL, NULL}
+static PyGetSetDef Alignment_getset[] = {
+	ALIGNMENT_GETSET(matches), ALIGNMENT_GETSET(mismatches), ALIGNMENT_GETSET(rep_matches),
+	ALIGNMENT_GETSET(strand),
+	ALIGNMENT_GETSET(q_name), ALIGNMENT_GETSET(q_size), ALIGNMENT_GETSET(q_start), ALIGNMENT_GETSET(q_end),
+	ALIGNMENT_GETSET(t_name), ALIGNMENT_GETSET(t_size), ALIGNMENT_GETSET(t_start), ALIGNMENT_GETSET(t_end),
+	ALIGNMENT_GETSET(block_count), ALIGNMENT_GETSET(block_sizes),
+	ALIGNMENT_GETSET(q_starts), ALIGNMENT_GETSET(t_starts),
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+/* PslReader: iterator over the alignments of a psl file, read with InputParser */
+
+typedef struct {
+	PyObject_HEAD
+	InputParser *parser;
+	std::ifstream *file;
+} PslReaderObject;
+
+static PyTypeObject PslReaderType = {PyVarObject_HEAD_INIT(NULL, 0)};
+
+static void PslReader_dealloc(PslReaderObject *self) {
+	delete self->parser;
+	delete self->file;
+	PyObject_Free(self);
+}
+
+static PyObject *PslReader_next(PslReaderObject *self) {
+	PslAlignment *aln = new PslAlignment();
+	try {
+		if (!self->parser->readPslAlignment(*self->file, *aln)) {
+			delete aln;
+			return NULL; // StopIteration
+		}
+	} catch (...) {
+		delete aln;
+		return setError(std::current_exception());
+	}
+	return wrapAlignment(aln);
+}
+
+static PyObject *pyReadPsl(PyObject *, PyObject *args) {
+	const char *path;
+	if (!PyArg_ParseTuple(args, "s", &path)) return NULL;
+	std::ifstream *file = new std::ifstream(path);
+	if (!file->is_open()) {
+		delete file;
+		return PyErr_Format(PyExc_FileNotFoundError, "psl file could not be opened: %s", path);
+	}
+	PslReaderObject *self = PyObject_New(PslReaderObject, &PslReaderType);
+	if (self == NULL) {
+		delete file;
+		return NULL;
+	}
+	self->file = file;
+	self->parser = new InputParser();
+	return reinterpret_cast<PyObject *>(self);
+}
+
+/* atomize */
+
+static PyObject *pyAtomize(PyObject *, PyObject *args, PyObject *kwds) {
+	static const char *kwlist[] = {"alignments", "min_length", "min_ident", "max_gap", "min_aln_length",
+		"bucket_size", "num_threads", "max_iterations", "convergence_fraction", "reuse_mappings", NULL};
+	PyObject *input;
+	AtomizerOptions options;
+	float minIdent = options.minAlnIdentity * 100;
+	int reuseMappings = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|IfIIIIIfp", const_cast<char **>(kwlist), &input,
+		&options.minLength, &minIdent, &options.maxGapLength, &options.minAlnLength, &options.bucketSize,
+		&options.numThreads, &options.maxIterations, &options.convergenceFraction, &reuseMappings))
+		return NULL;
+	if (options.bucketSize == 0 || options.numThreads == 0) {
+		PyErr_SetString(PyExc_ValueError, "bucket_size and num_threads must be positive");
+		return NULL;
+	}
+	options.minAlnIdentity = minIdent / 100.0f;
+	options.reuseMappings = reuseMappings;
+
+	// input is a psl path, a list of psl paths or an iterable of Alignment objects
+	std::vector<std::string> paths;
+	std::vector<PslAlignment> alignments;
+	if (PyUnicode_Check(input)) {
+		paths.push_back(PyUnicode_AsUTF8(input));
+	} else {
+		PyObject *iter = PyObject_GetIter(input);
+		if (iter == NULL) return NULL;
+		PyObject *item;
+		while ((item = PyIter_Next(iter)) != NULL) {
+			if (PyUnicode_Check(item) && alignments.empty()) {
+				paths.push_back(PyUnicode_AsUTF8(item));
+			} else if (PyObject_TypeCheck(item, &AlignmentType) && paths.empty()) {
+				alignments.push_back(*reinterpret_cast<AlignmentObject *>(item)->aln);
+			} else {
+				Py_DECREF(item);
+				Py_DECREF(iter);
+				PyErr_SetString(PyExc_TypeError, "alignments must be psl paths or Alignment objects, not both");
+				return NULL;
+			}
+			Py_DECREF(item);
+		}
+		Py_DECREF(iter);
+		if (PyErr_Occurred()) return NULL;
+	}
+	for (auto &path : paths) // before starting, and as FileNotFoundError rather than the RuntimeError of the parser
+		if (!std::ifstream(path).is_open())
+			return PyErr_Format(PyExc_FileNotFoundError, "psl file could not be opened: %s", path.c_str());
+	if (paths.empty() && alignments.empty()) {
+		PyErr_SetString(PyExc_ValueError, "no alignments given");
+		return NULL;
+	}
+
+	AtomizerResult result;
+	std::exception_ptr error; // translated once the GIL is held again
+	Py_BEGIN_ALLOW_THREADS
+	try {
+		if (paths.empty()) atomize(alignments, options, result);
+		else atomizePsl(paths, options, result);
+	} catch (...) {
+		error = std::current_exception();
+	}
+	Py_END_ALLOW_THREADS
+	if (error) return setError(error);
+
+	PyObject *names = PyList_New(result.sequenceNames.size());
+	if (names == NULL) return NULL;
+	for (size_t i = 0; i < result.sequenceNames.size(); i++)
+		PyList_SET_ITEM(names, i, PyUnicode_FromStringAndSize(result.sequenceNames[i].data(), result.sequenceNames[i].size()));
+	return Py_BuildValue("{s:N,s:N,s:N,s:N,s:N,s:i,s:s,s:I,s:k}",
+		"sequence_names", names,
+		"sequence", makeBlocks(result.atomSequence, "I"),
+		"start", makeBlocks(result.atomStart, "L"),
+		"end", makeBlocks(result.atomEnd, "L"),
+		"class", makeBlocks(result.classes, "i"),
+		"class_count", result.classCount,
+		"stop_reason", stopReasonName(result.stopReason),
+		"iterations", result.iterations,
+		"alignment_count", result.alignmentCount);
+}
+
+static PyMethodDef atomizerMethods[] = {
+	{"read_psl", pyReadPsl, METH_VARARGS,
+		"read_psl(path)\n--\n\nIterates over the alignments of a psl file as Alignment objects."},
+	{"atomize", (PyCFunction)(void (*)(void))pyAtomize, METH_VARARGS | METH_KEYWORDS,
+		"atomize(alignments, min_length=250, min_ident=80, max_gap=13, min_aln_length=13, bucket_size=1000,\n"
+		"        num_threads=1, max_iterations=0, convergence_fraction=0, reuse_mappings=False)\n--\n\n"
+		"Runs atomizer on a psl path, a list of psl paths or an iterable of Alignment objects.\n"
+		"Returns a dict with sequence_names and, per atom, the arrays sequence (index into sequence_names),\n"
+		"start, end and class (negative for the - strand), and class_count, stop_reason, iterations and\n"
+		"alignment_count."},
+	{NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef atomizerModule = {
+	PyModuleDef_HEAD_INIT, "atomizer",
+	"Fast psl parsing and atomization with the atomizer C++ code.", -1, atomizerMethods
+};
+
+PyMODINIT_FUNC PyInit_atomizer(void) {
+	BlocksType.tp_name = "atomizer.Blocks";
+	BlocksType.tp_basicsize = sizeof(BlocksObject);
+	BlocksType.tp_flags = Py_TPFLAGS_DEFAULT;
+	BlocksType.tp_doc = "Read-only array of numbers, usable with memoryview and numpy.asarray";
+	BlocksType.tp_dealloc = (destructor)Blocks_dealloc;
+	BlocksType.tp_as_buffer = &Blocks_as_buffer;
+	BlocksType.tp_as_sequence = &Blocks_as_sequence;
+
+	AlignmentType.tp_name = "atomizer.Alignment";
+	AlignmentType.tp_basicsize = sizeof(AlignmentObject);
+	AlignmentType.tp_flags = Py_TPFLAGS_DEFAULT;
+	AlignmentType.tp_doc = "Alignment(matches, mismatches, rep_matches, strand, q_name, q_size, q_start, q_end,\n"
+		"          t_name, t_size, t_start, t_end, block_sizes, q_starts, t_starts)\n"
+		"The fields of a psl line atomizer uses, positions as in the psl format.";
+	AlignmentType.tp_new = Alignment_new;
+	AlignmentType.tp_dealloc = (destructor)Alignment_dealloc;
+	AlignmentType.tp_getset = Alignment_getset;
+
+	PslReaderType.tp_name = "atomizer.PslReader";
+	PslReaderType.tp_basicsize = sizeof(PslReaderObject);
+	PslReaderType.tp_flags = Py_TPFLAGS_DEFAULT;
+	PslReaderType.tp_doc = "Iterator over the alignments of a psl file, see read_psl";
+	PslReaderType.tp_dealloc = (destructor)PslReader_dealloc;
+	PslReaderType.tp_iter = PyObject_SelfIter;
+	PslReaderType.tp_iternext = (iternextfunc)PslReader_next;
+
+	if (PyType_Ready(&BlocksType) < 0 || PyType_Ready(&AlignmentType) < 0 || PyType_Ready(&PslReaderType) < 0)
+		return NULL;
+	PyObject *m = PyModule_Create(&atomizerModule);
+	if (m == NULL) return NULL;
+	Py_INCREF(&AlignmentType);
+	if (PyModule_AddObject(m, "Alignment", reinterpret_cast<PyObject *>(&AlignmentType)) < 0) {
+		Py_DECREF(&AlignmentType);
+		Py_DECREF(m);
+		return NULL;
+	}
+	return m;
+}
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "AlignmentRecord.h"
+#include "InputParser.h"
+#include "IMP.h"
+#include "Classify.h"
+
+/* Checks that the atom graph of classify does not depend on the chunks of atoms it is built in
+(run by tests/test_classify_chunks.sh). Atoms of 100 positions are laid out so that atoms I and J lie in
+different chunks. One alignment covers I entirely and 90% of J on the + strand, two cover J entirely and
+90% of I on the - strand, so the + vote is only found from I and the - votes only from J. Summed over the
+pair the strands are opposite and nothing conflicts, as if both atoms were in the same chunk.
+Further alignments connect triples of atoms in three chunks, some of them contradicting their strands, and the
+classes and conflicts must not change when the votes are bounded to a few pairs, which takes many passes. */
+
+static const unsigned long ATOM_LENGTH = 100;
+static const unsigned long ATOMS = 3 * (1 << 16); // several chunks of connectAtomRange
+static const unsigned long I = 5, J = (1 << 16) + 5;
+static const unsigned long TRIPLES = 200;
+
+/* Alignment of a single block, the positions are on the + strand of sequence s */
+static PslAlignment makeAlignment(char strand, unsigned long tStart, unsigned long qStart, unsigned int length) {
+	PslAlignment aln;
+	aln.matches = length;
+	aln.strand = strand;
+	aln.qName = aln.tName = "s";
+	aln.qSize = aln.tSize = (ATOMS + 1) * ATOM_LENGTH;
+	aln.qStart = qStart;
+	aln.qEnd = qStart + length;
+	aln.tStart = tStart;
+	aln.tEnd = tStart + length;
+	aln.blockSizes = { length };
+	aln.qStarts = { (strand == '+') ? qStart : aln.qSize - aln.qEnd };
+	aln.tStarts = { tStart };
+	return aln;
+}
+
+/* Numbers the components in order of their first atom like classify, negative on the opposite strand */
+static std::vector<int> classesOf(ParityUnionFind &components) {
+	std::vector<int> classes(ATOMS), rootClass(ATOMS, 0);
+	int classNr = 0;
+	for (unsigned long a = 0; a < ATOMS; a++) {
+		bool parity;
+		unsigned int root = components.find(a, parity);
+		if (!rootClass[root]) rootClass[root] = parity ? -(++classNr) : ++classNr;
+		classes[a] = parity ? -rootClass[root] : rootClass[root];
+	}
+	return classes;
+}
+
+int main() {
+	InputParser parser;
+	std::map<std::string, unsigned long> speciesStart = { {"$", 0} };
+	std::deque<AlignmentRecord *> records;
+	const unsigned long i = I * ATOM_LENGTH, j = J * ATOM_LENGTH;
+	parser.addAlignment(records, speciesStart, makeAlignment('+', i, j + 10, ATOM_LENGTH + 1));
+	for (int k = 0; k < 2; k++)
+		parser.addAlignment(records, speciesStart, makeAlignment('-', j, i + 10, ATOM_LENGTH + 1));
+	for (unsigned long k = 0; k < TRIPLES; k++) { // atoms a, b and c in the first, third and second chunk
+		const unsigned long a = (1000 + 3 * k) * ATOM_LENGTH, b = (2 * (1 << 16) + 1000 + 7 * k) * ATOM_LENGTH,
+			c = ((1 << 16) + 3000 + k) * ATOM_LENGTH;
+		parser.addAlignment(records, speciesStart, makeAlignment((k % 2) ? '+' : '-', a, b + 10, ATOM_LENGTH + 1));
+		parser.addAlignment(records, speciesStart, makeAlignment((k % 3) ? '+' : '-', c, b + 10, ATOM_LENGTH + 1));
+		parser.addAlignment(records, speciesStart, makeAlignment((k % 5) ? '+' : '-', a, c + 10, ATOM_LENGTH + 1));
+	}
+	const unsigned long offset = speciesStart["s"];
+
+	std::vector<WasteRegion> regions;
+	for (unsigned long a = 0; a <= ATOMS; a++)
+		regions.push_back(WasteRegion(offset + a * ATOM_LENGTH));
+	const unsigned int bucketSize = 1000;
+	std::vector<std::vector<AlignmentRecord *>> buckets(regions.back().last / bucketSize + 1);
+	fillBuckets(records, bucketSize, buckets);
+
+	unsigned long expectedConflicts = 0; // one per triple with an odd number of - strands
+	for (unsigned long k = 0; k < TRIPLES; k++)
+		expectedConflicts += ((k % 2 == 0) + (k % 3 == 0) + (k % 5 == 0)) % 2;
+	int failed = 0;
+	for (unsigned int numThreads : {1, 4}) {
+		ParityUnionFind components(ATOMS), bounded(ATOMS);
+		constructAtomGraph(regions, buckets, bucketSize, 0.8f, numThreads, nullptr, components);
+		constructAtomGraph(regions, buckets, bucketSize, 0.8f, numThreads, nullptr, bounded, 16);
+		if (classesOf(components) != classesOf(bounded) || components.getConflicts() != bounded.getConflicts()) {
+			std::cerr << "ERROR: With " << numThreads << " threads the classes or the " << components.getConflicts()
+				<< " conflicts change when at most 16 atom pairs are kept (" << bounded.getConflicts()
+				<< " conflicts)." << std::endl;
+			failed = 1;
+		}
+		bool parityI, parityJ;
+		bool connected = components.find(I, parityI) == components.find(J, parityJ);
+		if (!connected || parityI == parityJ || components.getConflicts() != expectedConflicts) {
+			std::cerr << "ERROR: With " << numThreads << " threads atoms " << I << " and " << J << " are "
+				<< (!connected ? "not connected" : (parityI == parityJ) ? "on the same strand" : "on opposite strands")
+				<< " with " << components.getConflicts() << " conflicts, expected opposite strands with " << expectedConflicts << " conflicts of the triples."
+				<< std::endl;
+			failed = 1;
+		}
+	}
+	for (auto rec : records)
+		delete rec;
+	return failed;
+}
@@ -0,0 +1,26 @@
+# Helpers of the end-to-end tests, sourced by every tests/test_*.sh. Run the tests with make test.
+set -u
+SRC=$(cd "$(dirname "$0")/.." && pwd)
+ATOMIZER=$SRC/atomizer
+GENPSL=$SRC/genPsl
+PLANNER=$SRC/GetMaxBlockSizeAndLocalStart
+TEST=$(basename "$0" .sh)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+fail() {
+	echo "FAIL $TEST: $*"
+	exit 1
+}
+
+pass() {
+	echo "PASS $TEST"
+	exit 0
+}
+
+# writes a small synthetic input to $1, further arguments are passed to genPsl
+genInput() {
+	local out=$1
+	shift
+	"$GENPSL" -o "$out" --genomes 3 --genomeLength 200000 "$@" 2>/dev/null || fail "genPsl failed"
+}
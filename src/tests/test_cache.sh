@@ -0,0 +1,21 @@
+#!/bin/bash
+# A cached result equals the computed one, and parameters that change the result get their own entries.
+. "$(dirname "$0")/common.sh"
+
+genInput "$TMP/in.psl"
+for format in tsv compressed; do
+	"$ATOMIZER" "$TMP/in.psl" --outputFormat $format -o "$TMP/plain.$format" 2>/dev/null || fail "plain run failed"
+	"$ATOMIZER" "$TMP/in.psl" --outputFormat $format --cacheDir "$TMP/cache" -o "$TMP/miss.$format" 2>/dev/null \
+		|| fail "run storing the $format result failed"
+	"$ATOMIZER" "$TMP/in.psl" --outputFormat $format --cacheDir "$TMP/cache" -o "$TMP/hit.$format" 2>"$TMP/hit.err" \
+		|| fail "run taking the $format result from the cache failed"
+	grep -q "taken from the cache" "$TMP/hit.err" || fail "$format result not taken from the cache"
+	cmp -s "$TMP/plain.$format" "$TMP/miss.$format" || fail "$format result of the storing run differs"
+	cmp -s "$TMP/plain.$format" "$TMP/hit.$format" || fail "cached $format result differs"
+done
+
+"$ATOMIZER" "$TMP/in.psl" --bucketSize 500 --cacheDir "$TMP/cache" -o "$TMP/bucket.tsv" 2>"$TMP/bucket.err" \
+	|| fail "run with another bucketSize failed"
+grep -q "taken from the cache" "$TMP/bucket.err" && fail "result of another bucketSize taken from the cache"
+[ "$(ls "$TMP/cache" | wc -l)" -eq 3 ] || fail "expected 3 cache entries"
+pass
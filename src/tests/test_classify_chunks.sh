@@ -0,0 +1,21 @@
+#!/bin/bash
+# Classification does not depend on the chunks of atoms the atom graph is built in, the threads, the batches
+# of the out-of-core mode or whether the mappings of IMP are reused, also with atoms in several chunks.
+. "$(dirname "$0")/common.sh"
+
+"$SRC/tests/classifyChunks" || fail "votes of an atom pair in two chunks were not summed"
+
+# about 160000 atoms, more than two chunks of 65536
+"$GENPSL" -o "$TMP/in.psl" --genomes 3 --genomeLength 3000000 --unitLength 150 --blockLength 60 \
+	--duplications 20 --rearrangements 20 --seed 7 2>/dev/null || fail "genPsl failed"
+"$ATOMIZER" "$TMP/in.psl" --minLength 10 > "$TMP/plain.tsv" 2>"$TMP/plain.err" || fail "plain run failed"
+atoms=$(sed -n 's/^Put \([0-9]*\) atoms.*/\1/p' "$TMP/plain.err")
+[ "${atoms:-0}" -gt 131072 ] || fail "only ${atoms:-0} atoms, the input does not span several chunks"
+
+"$ATOMIZER" "$TMP/in.psl" --minLength 10 --numThreads 4 --reuseMappings > "$TMP/reuse.tsv" 2>/dev/null \
+	|| fail "run with --reuseMappings failed"
+cmp -s "$TMP/plain.tsv" "$TMP/reuse.tsv" || fail "result with 4 threads and --reuseMappings differs"
+"$ATOMIZER" "$TMP/in.psl" --minLength 10 --maxMemory 1M --storeDir "$TMP" > "$TMP/store.tsv" 2>/dev/null \
+	|| fail "run with --maxMemory failed"
+cmp -s "$TMP/plain.tsv" "$TMP/store.tsv" || fail "result with --maxMemory differs"
+pass
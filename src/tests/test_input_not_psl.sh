@@ -0,0 +1,19 @@
+#!/bin/bash
+# With --inputNotPsl the psl files are read from list files and give the result of passing them directly.
+. "$(dirname "$0")/common.sh"
+
+genInput "$TMP/a.psl" --seed 1
+head -n 200 "$TMP/a.psl" > "$TMP/b.psl"
+tail -n +201 "$TMP/a.psl" > "$TMP/c.psl"
+"$ATOMIZER" "$TMP/b.psl" "$TMP/c.psl" > "$TMP/direct.tsv" 2>/dev/null || fail "run on the psl files failed"
+
+printf '%s\n' "$TMP/b.psl" "$TMP/c.psl" > "$TMP/list.txt"
+"$ATOMIZER" "$TMP/list.txt" --inputNotPsl > "$TMP/list.tsv" 2>/dev/null || fail "run with a list file failed"
+cmp -s "$TMP/direct.tsv" "$TMP/list.tsv" || fail "result with a list file differs"
+
+echo "$TMP/b.psl" > "$TMP/list1.txt"
+echo "$TMP/c.psl" > "$TMP/list2.txt"
+"$ATOMIZER" "$TMP/list1.txt" "$TMP/list2.txt" --inputNotPsl > "$TMP/lists.tsv" 2>/dev/null \
+	|| fail "run with two list files failed"
+cmp -s "$TMP/direct.tsv" "$TMP/lists.tsv" || fail "result with two list files differs"
+pass
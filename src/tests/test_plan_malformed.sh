@@ -0,0 +1,26 @@
+#!/bin/bash
+# The memory planner reports malformed psl lines like the parser instead of reading past them.
+. "$(dirname "$0")/common.sh"
+
+genInput "$TMP/a.psl" --seed 1
+"$PLANNER" "$TMP/a.psl" > /dev/null 2>&1 || fail "planning a well formed file failed"
+
+grep -v '^#' "$TMP/a.psl" | head -n 5 > "$TMP/head.psl"
+line=$(grep -v '^#' "$TMP/a.psl" | head -n 1)
+edited() { # column (1-based) and awk expression of $c giving the new value
+	awk -F'\t' -v OFS='\t' -v c="$1" "{ \$c = $2; print }" <<< "$line"
+}
+check() {
+	{ cat "$TMP/head.psl"; printf '%s\n' "$2"; } > "$TMP/malformed.psl"
+	"$PLANNER" "$TMP/malformed.psl" > /dev/null 2> "$TMP/err" && fail "no error for $1"
+	grep -q "malformed psl line 6 of $TMP/malformed.psl" "$TMP/err" || fail "unexpected error for $1: $(cat "$TMP/err")"
+}
+check "a letter in a number" "$(edited 1 '$c "x"')"
+check "too few fields" "$(cut -f 1-5 <<< "$line")"
+check "too few blocks" "$(edited 18 '$c + 1')"
+check "too many blocks" "$(edited 18 '$c - 1')"
+check "a huge block count" "$(edited 18 '4000000000')"
+check "a missing block list" "$(cut -f 1-20 <<< "$line")"
+check "an unknown strand" "$(edited 9 '"?"')"
+check "a line longer than the parser reads" "$(cut -f 1-18 <<< "$line")	$(printf '1,%.0s' $(seq 20000))"
+pass
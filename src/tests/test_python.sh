@@ -0,0 +1,66 @@
+#!/bin/bash
+# The python module raises ValueError for malformed psl lines and alignments instead of crashing.
+. "$(dirname "$0")/common.sh"
+
+if ! command -v python3-config > /dev/null; then
+	echo "SKIP $TEST: python3-config not found"
+	exit 0
+fi
+make -s -C "$SRC" python > /dev/null 2>&1 || fail "make python failed"
+genInput "$TMP/a.psl" --seed 1
+
+PYTHONPATH=$SRC/python python3 - "$TMP" 2> "$TMP/python.err" <<'EOF' || fail "$(tail -n 1 "$TMP/python.err")"
+import sys
+import atomizer
+
+tmp = sys.argv[1]
+lines = [l for l in open(tmp + "/a.psl") if not l.startswith("#")]
+alignments = list(atomizer.read_psl(tmp + "/a.psl"))
+assert len(alignments) == len(lines), "read_psl did not read every line"
+result = atomizer.atomize(alignments)
+assert result["class_count"] > 0, "no classes"
+assert bytes(memoryview(result["class"])) == bytes(memoryview(atomizer.atomize(tmp + "/a.psl")["class"])), \
+	"Alignment objects and the psl file give different results"
+
+def expectValueError(name, run):
+	try:
+		run()
+	except ValueError:
+		return
+	sys.exit("ERROR: no ValueError for " + name)
+
+def edited(column, value):
+	fields = lines[0].rstrip("\n").split("\t")
+	fields[column] = value(fields[column])
+	return "\t".join(fields)
+
+fields = lines[0].rstrip("\n").split("\t")
+malformed = {
+	"a letter in a number": edited(0, lambda f: f + "x"),
+	"too few fields": "\t".join(fields[:5]),
+	"too few blocks": edited(17, lambda f: str(int(f) + 1)),
+	"too many blocks": edited(17, lambda f: str(int(f) - 1)),
+	"a missing block list": "\t".join(fields[:20]),
+	"an unknown strand": edited(8, lambda f: "?"),
+	"a line longer than the parser reads": "\t".join(fields[:18]) + "\t" + "1," * 20000,
+}
+for name, line in malformed.items():
+	path = tmp + "/malformed.psl"
+	with open(path, "w") as psl:
+		psl.write("".join(lines[:5]) + line + "\n")
+	expectValueError(name + " in read_psl", lambda: list(atomizer.read_psl(path)))
+	expectValueError(name + " in atomize", lambda: atomizer.atomize(path))
+
+# well formed lines with positions that do not fit the sequences
+with open(tmp + "/size.psl", "w") as psl:
+	psl.write(lines[0] + edited(10, lambda f: str(int(f) + 1)) + "\n")
+expectValueError("a sequence with two sizes", lambda: atomizer.atomize(tmp + "/size.psl"))
+a = alignments[0]
+def alignment(qSize, qStarts):
+	return atomizer.Alignment(a.matches, a.mismatches, a.rep_matches, a.strand, a.q_name, qSize, a.q_start,
+		a.q_end, a.t_name, a.t_size, a.t_start, a.t_end, a.block_sizes, qStarts, a.t_starts)
+expectValueError("an end beyond the sequence", lambda: atomizer.atomize([alignment(a.q_end - 1, a.q_starts)]))
+expectValueError("a block beyond the sequence",
+	lambda: atomizer.atomize([alignment(a.q_size, [a.q_size] + list(a.q_starts)[1:])]))
+EOF
+pass
@@ -0,0 +1,28 @@
+#!/bin/bash
+# Sharded IMP gives the result of a plain run, and the coordinator and workers stop instead of hanging
+# when the other side is gone or files of a previous run are left in the directory.
+. "$(dirname "$0")/common.sh"
+
+genInput "$TMP/in.psl"
+"$ATOMIZER" "$TMP/in.psl" > "$TMP/plain.tsv" 2>/dev/null || fail "plain run failed"
+SHARDS="$TMP/in.psl --shards 2 --shardDir $TMP/shards --shardTimeout 5"
+
+"$ATOMIZER" $SHARDS --spawnShards > "$TMP/spawn.tsv" 2>/dev/null || fail "run with --spawnShards failed"
+cmp -s "$TMP/plain.tsv" "$TMP/spawn.tsv" || fail "--spawnShards result differs"
+
+# the done file of the run above must not end workers started before the next coordinator
+"$ATOMIZER" $SHARDS --shardWorker 0 2>/dev/null &
+"$ATOMIZER" $SHARDS --shardWorker 1 2>/dev/null &
+sleep 1
+"$ATOMIZER" $SHARDS > "$TMP/manual.tsv" 2>/dev/null || fail "coordinator with workers started first failed"
+wait
+cmp -s "$TMP/plain.tsv" "$TMP/manual.tsv" || fail "result with workers started first differs"
+
+# without workers the coordinator gives up after the timeout
+"$ATOMIZER" $SHARDS --shardTimeout 2 > /dev/null 2>"$TMP/timeout.err" && fail "coordinator without workers succeeded"
+grep -q "has not been heard of" "$TMP/timeout.err" || fail "no timeout error without workers"
+
+# a worker without coordinator gives up after the timeout
+"$ATOMIZER" $SHARDS --shardTimeout 2 --shardWorker 0 2>"$TMP/worker.err" && fail "worker without coordinator succeeded"
+grep -q "coordinator has not been heard of" "$TMP/worker.err" || fail "no timeout error without coordinator"
+pass
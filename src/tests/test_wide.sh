@@ -0,0 +1,14 @@
+#!/bin/bash
+# Inputs beyond 4 Gbp: alignments between two padding sequences of 2.5 Gbp put the other sequences at positions
+# above 2^32, which must give the result of the same input with short padding sequences.
+. "$(dirname "$0")/common.sh"
+
+genInput "$TMP/in.psl"
+for size in 3000 2500000000; do
+	printf '1000\t0\t0\t0\t0\t0\t0\t0\t+\tpadA\t%s\t0\t1000\tpadB\t%s\t0\t1000\t1\t1000,\t0,\t0,\n' $size $size \
+		| cat - "$TMP/in.psl" > "$TMP/in.$size.psl"
+	"$ATOMIZER" "$TMP/in.$size.psl" > "$TMP/out.$size.tsv" 2>/dev/null || fail "run with padding of $size failed"
+done
+sed 's/\t2500000000$/\t3000/' "$TMP/out.2500000000.tsv" | cmp -s "$TMP/out.3000.tsv" - \
+	|| fail "result beyond 2^32 differs"
+pass